@@ -0,0 +1,610 @@
+/*************************************************************************************************
+ *
+ * Modeling and animation (TNM079)
+ * Speed and quality benchmark for the quadric decimation. Each mesh is decimated in
+ * stages to a fraction of its faces with every collapse order. Every stage reports
+ * collapses per second, heap operations, the peak resident memory of the process and
+ * the Hausdorff and RMS distance between the decimated and the input surface. The
+ * out-of-core vertex clustering of StreamingDecimation is run to the same fractions, on
+ * grids sized to reach them, for comparison.
+ *
+ * Run without arguments to decimate every mesh in the data repository, or pass a list
+ * of obj files. --json <file> also writes the results as JSON, to track regressions.
+ *
+ *************************************************************************************************/
+#include <Decimation/QuadricDecimationMesh.h>
+#include <Decimation/StreamingDecimation.h>
+#include <Util/ObjIO.h>
+#include <Util/Parallel.h>
+#include <Util/Stopwatch.h>
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "psapi.lib")
+#endif
+#else
+#include <sys/resource.h>
+#endif
+
+#ifndef TNM079_DATA_DIR
+#define TNM079_DATA_DIR "../tnm079-data/objects"
+#endif
+
+namespace {
+
+//! Each stage decimates to this fraction of the input faces
+const float Targets[] = {0.5f, 0.25f, 0.1f, 0.02f};
+
+//! Peak resident memory of the process in bytes, 0 where unknown
+size_t PeakMemory() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return counters.PeakWorkingSetSize;
+    }
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return static_cast<size_t>(usage.ru_maxrss);
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+//! Squared distance from p to the triangle abc (Ericson, Real-Time Collision Detection)
+float DistanceSquared(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b,
+                      const glm::vec3& c) {
+    const glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+    const float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+    if (d1 <= 0.f && d2 <= 0.f) return glm::dot(ap, ap);
+
+    const glm::vec3 bp = p - b;
+    const float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+    if (d3 >= 0.f && d4 <= d3) return glm::dot(bp, bp);
+
+    const float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.f && d1 >= 0.f && d3 <= 0.f) {
+        const glm::vec3 q = a + ab * (d1 / (d1 - d3));
+        return glm::dot(p - q, p - q);
+    }
+
+    const glm::vec3 cp = p - c;
+    const float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+    if (d6 >= 0.f && d5 <= d6) return glm::dot(cp, cp);
+
+    const float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.f && d2 >= 0.f && d6 <= 0.f) {
+        const glm::vec3 q = a + ac * (d2 / (d2 - d6));
+        return glm::dot(p - q, p - q);
+    }
+
+    const float va = d3 * d6 - d5 * d4;
+    if (va <= 0.f && (d4 - d3) >= 0.f && (d5 - d6) >= 0.f) {
+        const glm::vec3 q = b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+        return glm::dot(p - q, p - q);
+    }
+
+    const float denom = va + vb + vc;
+    if (!(denom > 0.f)) {
+        // Degenerate triangle, its edges were handled above
+        return std::numeric_limits<float>::max();
+    }
+    const glm::vec3 q = a + ab * (vb / denom) + ac * (vc / denom);
+    return glm::dot(p - q, p - q);
+}
+
+/*! \brief Triangles binned in a uniform grid, for the distance from a point to a surface
+ *
+ * The cells around the query are searched ring by ring until the closest triangle
+ * found is nearer than any cell not searched yet.
+ */
+class TriangleGrid {
+public:
+    TriangleGrid(const std::vector<glm::vec3>& verts, const std::vector<glm::uvec3>& tris)
+        : mVerts(verts), mTris(tris) {
+        mMin = glm::vec3(std::numeric_limits<float>::max());
+        glm::vec3 max(-std::numeric_limits<float>::max());
+        double area = 0;
+        for (const glm::uvec3& tri : tris) {
+            for (int i = 0; i < 3; i++) {
+                mMin = glm::min(mMin, verts[tri[i]]);
+                max = glm::max(max, verts[tri[i]]);
+            }
+            const glm::vec3 normal =
+                glm::cross(verts[tri[1]] - verts[tri[0]], verts[tri[2]] - verts[tri[0]]);
+            area += 0.5 * glm::length(normal);
+        }
+        const glm::vec3 extent = glm::max(max - mMin, glm::vec3(1e-6f));
+
+        // The cells are about twice the size of a triangle, but there are at most eight
+        // cells per triangle for surfaces that fill little of their bounding box
+        const size_t numTris = std::max<size_t>(tris.size(), 1);
+        const float volume = extent[0] * extent[1] * extent[2];
+        mCellSize = std::max(static_cast<float>(std::sqrt(4 * area / numTris)),
+                             std::cbrt(volume / (8.f * numTris)));
+        mCellSize = std::max(mCellSize, std::max(std::max(extent[0], extent[1]), extent[2]) / 1024);
+        for (int i = 0; i < 3; i++) {
+            mRes[i] = std::max(1, static_cast<int>(std::ceil(extent[i] / mCellSize)));
+        }
+
+        // Bin every triangle into the cells its bounding box overlaps
+        std::vector<size_t> counts(numCells() + 1, 0);
+        auto forCells = [&](const glm::uvec3& tri, auto function) {
+            const glm::vec3 lo = glm::min(glm::min(verts[tri[0]], verts[tri[1]]), verts[tri[2]]);
+            const glm::vec3 hi = glm::max(glm::max(verts[tri[0]], verts[tri[1]]), verts[tri[2]]);
+            const glm::ivec3 c0 = cellOf(lo), c1 = cellOf(hi);
+            for (int z = c0[2]; z <= c1[2]; z++)
+                for (int y = c0[1]; y <= c1[1]; y++)
+                    for (int x = c0[0]; x <= c1[0]; x++) function(index(x, y, z));
+        };
+        for (const glm::uvec3& tri : tris) {
+            forCells(tri, [&](size_t cell) { counts[cell + 1]++; });
+        }
+        for (size_t i = 1; i < counts.size(); i++) {
+            counts[i] += counts[i - 1];
+        }
+        mCellStart = counts;
+        mCellTris.resize(counts.back());
+        for (size_t t = 0; t < tris.size(); t++) {
+            forCells(tris[t], [&](size_t cell) { mCellTris[counts[cell]++] = t; });
+        }
+    }
+
+    //! Distance from p to the closest triangle
+    float Distance(const glm::vec3& p) const {
+        const glm::ivec3 center = cellOf(p);
+        const int maxRing = std::max(std::max(mRes[0], mRes[1]), mRes[2]);
+        float best = std::numeric_limits<float>::max();
+        for (int ring = 0; ring <= maxRing; ring++) {
+            for (int z = center[2] - ring; z <= center[2] + ring; z++) {
+                for (int y = center[1] - ring; y <= center[1] + ring; y++) {
+                    for (int x = center[0] - ring; x <= center[0] + ring; x++) {
+                        // Only the shell of the ring, the inside was searched before
+                        if (std::abs(x - center[0]) != ring && std::abs(y - center[1]) != ring &&
+                            std::abs(z - center[2]) != ring) {
+                            continue;
+                        }
+                        if (x < 0 || y < 0 || z < 0 || x >= mRes[0] || y >= mRes[1] ||
+                            z >= mRes[2]) {
+                            continue;
+                        }
+                        const size_t cell = index(x, y, z);
+                        for (size_t i = mCellStart[cell]; i < mCellStart[cell + 1]; i++) {
+                            const glm::uvec3& tri = mTris[mCellTris[i]];
+                            best = std::min(best, DistanceSquared(p, mVerts[tri[0]],
+                                                                  mVerts[tri[1]], mVerts[tri[2]]));
+                        }
+                    }
+                }
+            }
+            // The cells not searched yet lie outside the box of the ring. A point outside
+            // the grid is still at least ring cells away from them.
+            float inside = std::numeric_limits<float>::max();
+            for (int i = 0; i < 3; i++) {
+                const float lo = mMin[i] + (center[i] - ring) * mCellSize;
+                const float hi = mMin[i] + (center[i] + ring + 1) * mCellSize;
+                inside = std::min(inside, std::min(p[i] - lo, hi - p[i]));
+            }
+            const float reach = std::max(inside, ring * mCellSize);
+            if (best <= reach * reach) {
+                break;
+            }
+        }
+        return std::sqrt(best);
+    }
+
+protected:
+    size_t numCells() const { return size_t(mRes[0]) * mRes[1] * mRes[2]; }
+    size_t index(int x, int y, int z) const { return (size_t(z) * mRes[1] + y) * mRes[0] + x; }
+    glm::ivec3 cellOf(const glm::vec3& p) const {
+        glm::ivec3 cell;
+        for (int i = 0; i < 3; i++) {
+            const float c = std::floor((p[i] - mMin[i]) / mCellSize);
+            cell[i] = static_cast<int>(std::min(std::max(c, 0.f), float(mRes[i] - 1)));
+        }
+        return cell;
+    }
+
+    const std::vector<glm::vec3>& mVerts;
+    const std::vector<glm::uvec3>& mTris;
+    glm::vec3 mMin;
+    float mCellSize;
+    int mRes[3];
+    std::vector<size_t> mCellStart;
+    std::vector<size_t> mCellTris;
+};
+
+/*! \brief One sided distances from the samples of a surface to another surface
+ *
+ * The samples are the vertices and four points on every face, the centroid and the
+ * points halfway between it and each corner, like the Metro tool.
+ */
+struct Distances {
+    double max = 0;
+    double sumSquared = 0;
+    size_t count = 0;
+};
+
+Distances SampleDistances(const std::vector<glm::vec3>& verts,
+                          const std::vector<glm::uvec3>& tris, const TriangleGrid& other) {
+    const size_t samplesPerFace = 4;
+    std::vector<float> distances(verts.size() + samplesPerFace * tris.size());
+    ParallelFor(verts.size(), [&](size_t i) { distances[i] = other.Distance(verts[i]); });
+    ParallelFor(tris.size(), [&](size_t i) {
+        const glm::vec3& a = verts[tris[i][0]];
+        const glm::vec3& b = verts[tris[i][1]];
+        const glm::vec3& c = verts[tris[i][2]];
+        const glm::vec3 centroid = (a + b + c) / 3.f;
+        float* out = &distances[verts.size() + samplesPerFace * i];
+        out[0] = other.Distance(centroid);
+        out[1] = other.Distance((centroid + a) * 0.5f);
+        out[2] = other.Distance((centroid + b) * 0.5f);
+        out[3] = other.Distance((centroid + c) * 0.5f);
+    });
+
+    Distances result;
+    for (float d : distances) {
+        result.max = std::max<double>(result.max, d);
+        result.sumSquared += double(d) * d;
+    }
+    result.count = distances.size();
+    return result;
+}
+
+//! Discards what is written to std::cout and std::cerr while it exists
+class Silence {
+public:
+    Silence() : mOut(std::cout.rdbuf(NULL)), mErr(std::cerr.rdbuf(NULL)) {}
+    ~Silence() {
+        std::cout.rdbuf(mOut);
+        std::cerr.rdbuf(mErr);
+    }
+
+protected:
+    std::streambuf* mOut;
+    std::streambuf* mErr;
+};
+
+//! Gives the benchmark the remaining faces of the decimated mesh
+class BenchmarkMesh : public QuadricDecimationMesh {
+public:
+    using HalfEdgeMesh::GetNumFaces;
+
+    //! The faces that are not collapsed, indexing the vertex positions
+    void GetSurface(std::vector<glm::vec3>& verts, std::vector<glm::uvec3>& tris) {
+        verts = mVerts.pos;
+        tris.clear();
+        for (size_t i = 0; i < mFaces.size(); i++) {
+            if (isFaceCollapsed(i)) {
+                continue;
+            }
+            const size_t e0 = mFaces.edge[i];
+            const size_t e1 = mEdges[e0].next;
+            const size_t e2 = mEdges[e1].next;
+            tris.push_back(glm::uvec3(mEdges[e0].vert, mEdges[e1].vert, mEdges[e2].vert));
+        }
+    }
+
+    size_t GetNumRemainingFaces() const { return mFaces.size() - mNumCollapsedFaces; }
+};
+
+struct Stage {
+    size_t targetFaces;
+    size_t faces;
+    size_t collapses;
+    double seconds;
+    IndexedHeap<Mesh::Index>::Counts heap;
+    double hausdorff;
+    double rms;
+    //! Of the process, or of the clustering containers for the streaming run
+    size_t peakMemory;
+};
+
+struct Run {
+    std::string order;
+    double initializeSeconds;
+    std::vector<Stage> stages;
+};
+
+struct Result {
+    std::string file;
+    size_t verts;
+    size_t faces;
+    double diagonal;
+    std::vector<Run> runs;
+};
+
+//! Decimates the mesh read by io in stages, false if it is not a valid half edge mesh
+bool Decimate(const ObjIO& io, DecimationMesh::CollapseOrder order, Run& run,
+              const TriangleGrid& inputGrid) {
+    // Building and decimating report their progress on std::cout and std::cerr
+    Silence silence;
+    BenchmarkMesh mesh;
+    if (!mesh.Build(io.GetVerts(), io.GetTris())) {
+        return false;
+    }
+    mesh.SetCollapseOrder(order);
+
+    Stopwatch watch;
+    watch.start();
+    mesh.Initialize();
+    run.initializeSeconds = watch.stop();
+
+    const size_t numFaces = mesh.GetNumFaces();
+    std::vector<glm::vec3> verts;
+    std::vector<glm::uvec3> tris;
+    for (float fraction : Targets) {
+        Stage stage;
+        stage.targetFaces = std::max<size_t>(static_cast<size_t>(numFaces * fraction), 2);
+        const size_t collapses = mesh.GetNumAppliedCollapses();
+        const IndexedHeap<Mesh::Index>::Counts heap = mesh.GetHeapCounts();
+
+        watch.start();
+        mesh.decimate(stage.targetFaces);
+        stage.seconds = watch.stop();
+
+        stage.faces = mesh.GetNumRemainingFaces();
+        stage.collapses = mesh.GetNumAppliedCollapses() - collapses;
+        stage.heap.push = mesh.GetHeapCounts().push - heap.push;
+        stage.heap.pop = mesh.GetHeapCounts().pop - heap.pop;
+        stage.heap.update = mesh.GetHeapCounts().update - heap.update;
+        stage.heap.remove = mesh.GetHeapCounts().remove - heap.remove;
+        stage.peakMemory = PeakMemory();
+
+        // Symmetric: the decimated surface may miss parts of the input, or stick out of it
+        mesh.GetSurface(verts, tris);
+        const TriangleGrid grid(verts, tris);
+        const Distances there = SampleDistances(verts, tris, inputGrid);
+        const Distances back = SampleDistances(io.GetVerts(), io.GetTris(), grid);
+        stage.hausdorff = std::max(there.max, back.max);
+        stage.rms = std::sqrt((there.sumSquared + back.sumSquared) /
+                              std::max<size_t>(there.count + back.count, 1));
+        run.stages.push_back(stage);
+    }
+    return true;
+}
+
+/*! Simplifies the file read by io with StreamingDecimation to each target, false if
+ * it fails. Clustering has no collapses or heap, and nothing to initialize.
+ */
+bool DecimateStreaming(const std::string& file, const ObjIO& io, Run& run,
+                       const TriangleGrid& inputGrid) {
+    const std::vector<glm::vec3>& inputVerts = io.GetVerts();
+    const std::vector<glm::uvec3>& inputTris = io.GetTris();
+    glm::vec3 lo(std::numeric_limits<float>::max()), hi(-std::numeric_limits<float>::max());
+    for (const glm::vec3& v : inputVerts) {
+        lo = glm::min(lo, v);
+        hi = glm::max(hi, v);
+    }
+    const glm::vec3 extent = hi - lo;
+    const double longest = std::max(std::max(extent[0], extent[1]), extent[2]);
+    double area = 0;
+    for (const glm::uvec3& tri : inputTris) {
+        const glm::vec3 normal = glm::cross(inputVerts[tri[1]] - inputVerts[tri[0]],
+                                            inputVerts[tri[2]] - inputVerts[tri[0]]);
+        area += 0.5 * glm::length(normal);
+    }
+
+    const std::filesystem::path output =
+        std::filesystem::temp_directory_path() / "DecimationBenchmark.obj";
+    run.initializeSeconds = 0;
+    bool ok = true;
+    for (float fraction : Targets) {
+        Stage stage;
+        stage.targetFaces = std::max<size_t>(static_cast<size_t>(inputTris.size() * fraction), 2);
+        stage.collapses = 0;
+        stage.heap = IndexedHeap<Mesh::Index>::Counts();
+
+        // A surface of area A cuts about 1.5 A / h^2 cells of size h, in arbitrary
+        // orientation, and every output vertex has about two triangles
+        const double cellSize = std::sqrt(3.0 * area / stage.targetFaces);
+        const size_t resolution =
+            cellSize > 0 ? std::max<size_t>(static_cast<size_t>(longest / cellSize), 1) : 1;
+
+        StreamingDecimation streaming;
+        streaming.SetGridResolution(resolution);
+        ObjIO result;
+        {
+            Silence silence;
+            Stopwatch watch;
+            watch.start();
+            ok = streaming.Decimate(file, output.string());
+            stage.seconds = watch.stop();
+            ok = ok && result.Read(output.string()) && !result.GetTris().empty();
+        }
+        if (!ok) {
+            break;
+        }
+        stage.faces = streaming.GetNumOutputFaces();
+        stage.peakMemory = streaming.GetPeakMemory();
+
+        const TriangleGrid grid(result.GetVerts(), result.GetTris());
+        const Distances there = SampleDistances(result.GetVerts(), result.GetTris(), inputGrid);
+        const Distances back = SampleDistances(inputVerts, inputTris, grid);
+        stage.hausdorff = std::max(there.max, back.max);
+        stage.rms = std::sqrt((there.sumSquared + back.sumSquared) /
+                              std::max<size_t>(there.count + back.count, 1));
+        run.stages.push_back(stage);
+    }
+    std::error_code error;
+    std::filesystem::remove(output, error);
+    return ok;
+}
+
+void Report(const Result& result) {
+    std::cout << result.file << ": " << result.verts << " vertices, " << result.faces
+              << " triangles" << std::endl;
+    for (const Run& run : result.runs) {
+        std::cout << "  " << run.order << ", initialize " << std::fixed << std::setprecision(2)
+                  << run.initializeSeconds * 1000.0 << " ms" << std::endl;
+        for (const Stage& stage : run.stages) {
+            const double rate = stage.seconds > 0 ? stage.collapses / stage.seconds : 0;
+            std::cout << "    " << std::setw(8) << stage.faces << " faces " << std::setw(9)
+                      << std::setprecision(2) << stage.seconds * 1000.0 << " ms " << std::setw(11) << std::setprecision(0)
+                      << rate << " collapses/s " << std::setw(9)
+                      << stage.heap.pop + stage.heap.update + stage.heap.remove + stage.heap.push
+                      << " heap ops  hausdorff " << std::scientific << std::setprecision(3)
+                      << stage.hausdorff / result.diagonal << "  rms "
+                      << stage.rms / result.diagonal << std::fixed << "  peak "
+                      << (stage.peakMemory >> 20) << " MB" << std::endl;
+        }
+    }
+}
+
+std::string Quote(const std::string& s) {
+    std::ostringstream os;
+    os << '"';
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            os << '\\' << c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            os << "\\u" << std::hex << std::setw(4) << std::setfill('0') << int(c) << std::dec
+               << std::setfill(' ');
+        } else {
+            os << c;
+        }
+    }
+    os << '"';
+    return os.str();
+}
+
+//! Distances are also given relative to the bounding box diagonal of the input
+void WriteJson(std::ostream& os, const std::vector<Result>& results) {
+    os << std::setprecision(9);
+    os << "{\n  \"benchmark\": \"decimation\",\n  \"threads\": "
+       << std::max(1u, std::thread::hardware_concurrency()) << ",\n  \"meshes\": [";
+    for (size_t m = 0; m < results.size(); m++) {
+        const Result& result = results[m];
+        os << (m ? "," : "") << "\n    {\n      \"file\": " << Quote(result.file)
+           << ",\n      \"vertices\": " << result.verts << ",\n      \"faces\": " << result.faces
+           << ",\n      \"diagonal\": " << result.diagonal << ",\n      \"runs\": [";
+        for (size_t r = 0; r < result.runs.size(); r++) {
+            const Run& run = result.runs[r];
+            os << (r ? "," : "") << "\n        {\n          \"order\": " << Quote(run.order)
+               << ",\n          \"initialize_seconds\": " << run.initializeSeconds
+               << ",\n          \"stages\": [";
+            for (size_t s = 0; s < run.stages.size(); s++) {
+                const Stage& stage = run.stages[s];
+                const double rate = stage.seconds > 0 ? stage.collapses / stage.seconds : 0;
+                os << (s ? "," : "") << "\n            {\"target_faces\": " << stage.targetFaces
+                   << ", \"faces\": " << stage.faces << ", \"collapses\": " << stage.collapses
+                   << ", \"seconds\": " << stage.seconds << ", \"collapses_per_second\": " << rate
+                   << ", \"heap\": {\"push\": " << stage.heap.push
+                   << ", \"pop\": " << stage.heap.pop << ", \"update\": " << stage.heap.update
+                   << ", \"remove\": " << stage.heap.remove << "}, \"hausdorff\": "
+                   << stage.hausdorff << ", \"rms\": " << stage.rms
+                   << ", \"hausdorff_relative\": " << stage.hausdorff / result.diagonal
+                   << ", \"rms_relative\": " << stage.rms / result.diagonal
+                   << ", \"peak_memory_bytes\": " << stage.peakMemory << "}";
+            }
+            os << "\n          ]\n        }";
+        }
+        os << "\n      ]\n    }";
+    }
+    os << "\n  ]\n}\n";
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    std::vector<std::string> files;
+    std::string jsonFile;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--json" && i + 1 < argc) {
+            jsonFile = argv[++i];
+        } else {
+            files.push_back(arg);
+        }
+    }
+    if (files.empty()) {
+        std::error_code error;
+        for (const auto& entry : std::filesystem::directory_iterator(TNM079_DATA_DIR, error)) {
+            if (entry.path().extension() == ".obj") {
+                files.push_back(entry.path().string());
+            }
+        }
+        std::sort(files.begin(), files.end());
+        if (files.empty()) {
+            std::cerr << "Error: no obj files in '" << TNM079_DATA_DIR << "'" << std::endl;
+            return 1;
+        }
+    }
+
+    const std::pair<DecimationMesh::CollapseOrder, const char*> orders[] = {
+        {DecimationMesh::GreedyOrder, "greedy"},
+        {DecimationMesh::MultipleChoiceOrder, "multiple choice"},
+        {DecimationMesh::IndependentSetOrder, "independent set"}};
+
+    std::vector<Result> results;
+    for (const std::string& file : files) {
+        ObjIO io;
+        if (!io.Read(file) || io.GetTris().empty()) {
+            std::cerr << "Error: could not read '" << file << "', skipped" << std::endl;
+            continue;
+        }
+
+        Result result;
+        result.file = file;
+        result.verts = io.GetVerts().size();
+        result.faces = io.GetTris().size();
+        glm::vec3 lo(std::numeric_limits<float>::max()), hi(-std::numeric_limits<float>::max());
+        for (const glm::vec3& v : io.GetVerts()) {
+            lo = glm::min(lo, v);
+            hi = glm::max(hi, v);
+        }
+        result.diagonal = std::max(glm::length(hi - lo), std::numeric_limits<float>::min());
+
+        const TriangleGrid inputGrid(io.GetVerts(), io.GetTris());
+        for (const auto& order : orders) {
+            Run run;
+            run.order = order.second;
+            if (!Decimate(io, order.first, run, inputGrid)) {
+                std::cerr << "Error: could not build a half edge mesh of '" << file
+                          << "', skipped" << std::endl;
+                break;
+            }
+            result.runs.push_back(run);
+        }
+        if (result.runs.empty()) {
+            continue;
+        }
+        Run streaming;
+        streaming.order = "streaming clustering";
+        if (DecimateStreaming(file, io, streaming, inputGrid)) {
+            result.runs.push_back(streaming);
+        } else {
+            std::cerr << "Error: could not cluster '" << file << "'" << std::endl;
+        }
+        Report(result);
+        results.push_back(result);
+    }
+
+    if (!jsonFile.empty()) {
+        std::ofstream os(jsonFile.c_str());
+        if (!os) {
+            std::cerr << "Error: could not write '" << jsonFile << "'" << std::endl;
+            return 1;
+        }
+        WriteJson(os, results);
+    }
+    return 0;
+}
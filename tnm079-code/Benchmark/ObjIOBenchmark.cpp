@@ -0,0 +1,138 @@
+/*************************************************************************************************
+ *
+ * Modeling and animation (TNM079)
+ * Throughput benchmark for the OBJ loader. Run without arguments to load the
+ * bunny and cow models from the data repository, or pass a list of obj files.
+ * A small inline file with the less common syntax is parsed first as a check.
+ *
+ *************************************************************************************************/
+#include <Geometry/HalfEdgeMesh.h>
+#include <Geometry/SimpleMesh.h>
+#include <Util/ObjIO.h>
+#include <Util/Stopwatch.h>
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef TNM079_DATA_DIR
+#define TNM079_DATA_DIR "../tnm079-data/objects"
+#endif
+
+namespace {
+
+const int NumRuns = 5;
+
+//! Returns the fastest of NumRuns runs of func, in seconds
+template <typename Func>
+double Fastest(Func func) {
+    double best = std::numeric_limits<double>::max();
+    for (int i = 0; i < NumRuns; i++) {
+        Stopwatch watch;
+        watch.start();
+        if (!func()) {
+            return -1;
+        }
+        best = std::min(best, watch.stop());
+    }
+    return best;
+}
+
+void Report(const std::string& what, double seconds, size_t bytes) {
+    std::cout << "  " << std::left << std::setw(28) << what << std::right;
+    if (seconds < 0) {
+        std::cout << "failed" << std::endl;
+        return;
+    }
+    std::cout << std::fixed << std::setprecision(2) << std::setw(9) << seconds * 1000.0 << " ms "
+              << std::setw(9) << bytes / (seconds * 1024.0 * 1024.0) << " MB/s" << std::endl;
+}
+
+/*! Comment lines, trailing comments, v/vt/vn tokens, negative indices and a quad,
+ * which give four vertices and four triangles
+ */
+const char* const SyntaxInput = "# vertices\n"
+                                "v 0 0 0\n"
+                                "v 1 0 0 # trailing comment\n"
+                                "v 1 1 0\n"
+                                "v 0 1 0\n"
+                                "vt 0 0\n"
+                                "f 1/1 2/1 3/1 # quad half\n"
+                                "f -4//1 -2//1 -1//1#no space\n"
+                                "f 1 2 3 4 # quad\n";
+
+//! Parses SyntaxInput, false if it does not give the expected mesh
+bool CheckSyntax() {
+    ObjIO io;
+    std::istringstream is(SyntaxInput);
+    if (!io.Read(is) || io.GetVerts().size() != 4 || io.GetTris().size() != 4 ||
+        io.GetTris()[1] != glm::uvec3(0, 2, 3)) {
+        std::cerr << "Error: the inline obj syntax check failed" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; i++) {
+        files.push_back(argv[i]);
+    }
+    if (files.empty()) {
+        files.push_back(std::string(TNM079_DATA_DIR) + "/bunny_medium.obj");
+        files.push_back(std::string(TNM079_DATA_DIR) + "/cow.obj");
+    }
+
+    if (!CheckSyntax()) {
+        return 1;
+    }
+
+    const size_t numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    for (const std::string& file : files) {
+        std::ifstream in(file, std::ios::binary | std::ios::ate);
+        if (!in) {
+            std::cerr << "Error: could not open '" << file << "'" << std::endl;
+            return 1;
+        }
+        const size_t bytes = static_cast<size_t>(in.tellg());
+
+        ObjIO io;
+        io.Read(file);
+        std::cout << file << ": " << bytes << " bytes, " << io.GetVerts().size() << " vertices, "
+                  << io.GetTris().size() << " triangles" << std::endl;
+
+        Report("parse istream", Fastest([&]() {
+                   std::ifstream is(file);
+                   return io.Read(is);
+               }),
+               bytes);
+
+        io.SetNumThreads(1);
+        Report("parse mmap, 1 thread", Fastest([&]() { return io.Read(file); }), bytes);
+
+        io.SetNumThreads(numThreads);
+        Report("parse mmap, " + std::to_string(numThreads) + " threads",
+               Fastest([&]() { return io.Read(file); }), bytes);
+
+        Report("load SimpleMesh", Fastest([&]() {
+                   SimpleMesh mesh;
+                   return io.Load(&mesh, file);
+               }),
+               bytes);
+
+        Report("load HalfEdgeMesh", Fastest([&]() {
+                   HalfEdgeMesh mesh;
+                   return io.Load(&mesh, file);
+               }),
+               bytes);
+    }
+    return 0;
+}
@@ -0,0 +1,303 @@
+/*************************************************************************************************
+ *
+ * Modeling and animation (TNM079)
+ * Speed and consistency benchmark for the Loop subdivision. Each mesh is subdivided
+ * uniformly with Subdivide(), and refined again through a stencil table built by
+ * BuildStencilTable() and applied by ApplyStencilTable(). Both must give the same
+ * vertices, also for a deformed control mesh. The limit surface of LimitPosition(),
+ * LimitNormal() and EvaluateLimit() must not change under Subdivide(), and must agree
+ * between the vertices and the face corners. Deviations of positions are relative to the
+ * bounding box diagonal of the input, those of the unit normals are absolute.
+ *
+ * Run without arguments to subdivide every mesh in the data repository, or pass a list
+ * of obj files. --levels <n> sets the number of uniform steps, 3 by default. The exit
+ * status is 1 if a check fails.
+ *
+ *************************************************************************************************/
+#include <Subdivision/LoopSubdivisionMesh.h>
+#include <Util/ObjIO.h>
+#include <Util/Stopwatch.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#ifndef TNM079_DATA_DIR
+#define TNM079_DATA_DIR "../tnm079-data/objects"
+#endif
+
+namespace {
+
+//! The largest deviation, relative to the diagonal, that passes a check
+const double Tolerance = 1e-5;
+//! The largest deviation of a unit normal that passes a check
+const double NormalTolerance = 1e-3;
+
+//! Discards what is written to std::cout and std::cerr while it exists
+class Silence {
+public:
+    Silence() : mOut(std::cout.rdbuf(NULL)), mErr(std::cerr.rdbuf(NULL)) {}
+    ~Silence() {
+        std::cout.rdbuf(mOut);
+        std::cerr.rdbuf(mErr);
+    }
+
+protected:
+    std::streambuf* mOut;
+    std::streambuf* mErr;
+};
+
+//! Gives the benchmark the vertex positions of the subdivided mesh
+class BenchmarkMesh : public LoopSubdivisionMesh {
+public:
+    using HalfEdgeMesh::FaceVertices;
+    using HalfEdgeMesh::GetNumFaces;
+    using HalfEdgeMesh::GetNumVerts;
+
+    const std::vector<glm::vec3>& GetPositions() const { return mVerts.pos; }
+
+    //! The faces in the fan of a vertex, fewer than its faces where fans meet at it
+    size_t GetNumFanFaces(size_t vertexIndex) const {
+        size_t count = 0;
+        for (Index edge : OutgoingEdges(vertexIndex)) {
+            if (mEdges[edge].face < EdgeState::Uninitialized) {
+                count++;
+            }
+        }
+        return count;
+    }
+
+    void SetPositions(const std::vector<glm::vec3>& positions) {
+        mVerts.pos = positions;
+        Update();
+    }
+};
+
+//! The largest distance between corresponding positions, infinite if the counts differ
+double MaxDeviation(const std::vector<glm::vec3>& a, const std::vector<glm::vec3>& b) {
+    if (a.size() != b.size()) {
+        return std::numeric_limits<double>::infinity();
+    }
+    double deviation = 0;
+    for (size_t i = 0; i < a.size(); i++) {
+        deviation = std::max<double>(deviation, glm::length(a[i] - b[i]));
+    }
+    return deviation;
+}
+
+struct Result {
+    std::string file;
+    size_t verts;
+    size_t faces;
+    double diagonal;
+    size_t refinedVerts;
+    size_t refinedFaces;
+    double subdivideSeconds;
+    double buildSeconds;
+    double applySeconds;
+    size_t weights;
+    //! Between the stencil table and Subdivide(), of the input and of a deformed input
+    double deviation;
+    double deformedDeviation;
+    //! Time of EvaluateLimit() at the center of every control face
+    double limitSeconds;
+    //! Of the control vertices, from their limit positions after levels steps
+    double convergence;
+    //! Of the limit positions and normals of the control vertices under Subdivide()
+    double limitDeviation;
+    double limitNormalDeviation;
+    //! Between EvaluateLimit() at the face corners and the limit of the corner vertices
+    double cornerDeviation;
+    double cornerNormalDeviation;
+    //! Corners at which several fans meet, their limit is not defined
+    size_t nonManifoldCorners;
+};
+
+//! Subdivides the mesh read by io both ways, false if it is not a valid half edge mesh
+bool Subdivide(const ObjIO& io, size_t levels, Result& result) {
+    // Building and subdividing report their progress on std::cout and std::cerr
+    Silence silence;
+    BenchmarkMesh uniform, deformedUniform, table;
+    if (!uniform.Build(io.GetVerts(), io.GetTris()) ||
+        !deformedUniform.Build(io.GetVerts(), io.GetTris()) ||
+        !table.Build(io.GetVerts(), io.GetTris())) {
+        return false;
+    }
+
+    // Building drops the vertices no triangle uses, so the control vertices are those of
+    // the mesh
+    const std::vector<glm::vec3> control = table.GetPositions();
+    glm::vec3 lo(std::numeric_limits<float>::max()), hi(-std::numeric_limits<float>::max());
+    for (const glm::vec3& v : control) {
+        lo = glm::min(lo, v);
+        hi = glm::max(hi, v);
+    }
+    result.diagonal = std::max(glm::length(hi - lo), std::numeric_limits<float>::min());
+
+    // A smooth deformation that is not affine, so that it is not reproduced by chance
+    std::vector<glm::vec3> deformed(control);
+    const float amplitude = static_cast<float>(0.05 * result.diagonal);
+    for (glm::vec3& v : deformed) {
+        const glm::vec3 p = (v - lo) / static_cast<float>(result.diagonal);
+        v += amplitude *
+             glm::vec3(std::sin(6.f * p[1]), std::sin(6.f * p[2]), std::sin(6.f * p[0]));
+    }
+    deformedUniform.SetPositions(deformed);
+
+    // The limit of the control mesh, also at the corners of every face
+    std::vector<glm::vec3> limits(control.size()), normals(control.size());
+    for (size_t i = 0; i < control.size(); i++) {
+        limits[i] = uniform.LimitPosition(i);
+        normals[i] = uniform.LimitNormal(i);
+    }
+    std::vector<size_t> numFaces(control.size(), 0);
+    for (size_t i = 0; i < uniform.GetNumFaces(); i++) {
+        for (Mesh::Index vert : uniform.FaceVertices(i)) {
+            numFaces[vert]++;
+        }
+    }
+    result.cornerDeviation = result.cornerNormalDeviation = 0;
+    result.nonManifoldCorners = 0;
+    const float corners[3][2] = {{0.f, 0.f}, {1.f, 0.f}, {0.f, 1.f}};
+    glm::vec3 position, normal;
+    for (size_t i = 0; i < uniform.GetNumFaces(); i++) {
+        const std::array<Mesh::Index, 3> verts = uniform.FaceVertices(i);
+        for (size_t c = 0; c < 3; c++) {
+            if (uniform.GetNumFanFaces(verts[c]) != numFaces[verts[c]]) {
+                result.nonManifoldCorners++;
+                continue;
+            }
+            uniform.EvaluateLimit(i, corners[c][0], corners[c][1], position, normal);
+            result.cornerDeviation =
+                std::max<double>(result.cornerDeviation, glm::length(position - limits[verts[c]]));
+            result.cornerNormalDeviation = std::max<double>(
+                result.cornerNormalDeviation, glm::length(normal - normals[verts[c]]));
+        }
+    }
+
+    Stopwatch watch;
+    watch.start();
+    for (size_t i = 0; i < uniform.GetNumFaces(); i++) {
+        uniform.EvaluateLimit(i, 1.f / 3, 1.f / 3, position, normal);
+    }
+    result.limitSeconds = watch.stop();
+
+    watch.start();
+    for (size_t level = 0; level < levels; level++) {
+        uniform.Subdivide();
+    }
+    result.subdivideSeconds = watch.stop();
+    for (size_t level = 0; level < levels; level++) {
+        deformedUniform.Subdivide();
+    }
+    result.refinedVerts = uniform.GetNumVerts();
+    result.refinedFaces = uniform.GetNumFaces();
+
+    // Subdivide() keeps the indices of the control vertices
+    result.convergence = result.limitDeviation = result.limitNormalDeviation = 0;
+    for (size_t i = 0; i < control.size(); i++) {
+        result.convergence = std::max<double>(result.convergence,
+                                              glm::length(uniform.GetPositions()[i] - limits[i]));
+        result.limitDeviation = std::max<double>(result.limitDeviation,
+                                                 glm::length(uniform.LimitPosition(i) - limits[i]));
+        result.limitNormalDeviation = std::max<double>(
+            result.limitNormalDeviation, glm::length(uniform.LimitNormal(i) - normals[i]));
+    }
+
+    watch.start();
+    const StencilTable stencils = table.BuildStencilTable(levels);
+    result.buildSeconds = watch.stop();
+    result.weights = stencils.GetNumWeights();
+    result.deviation = MaxDeviation(table.GetPositions(), uniform.GetPositions());
+
+    watch.start();
+    const bool applied = table.ApplyStencilTable(stencils, deformed);
+    result.applySeconds = watch.stop();
+    result.deformedDeviation = std::numeric_limits<double>::infinity();
+    if (applied) {
+        result.deformedDeviation =
+            MaxDeviation(table.GetPositions(), deformedUniform.GetPositions());
+    }
+    return true;
+}
+
+//! Reports the result, false if a check failed
+bool Report(const Result& result, size_t levels) {
+    const bool passed = result.deviation / result.diagonal <= Tolerance &&
+                        result.deformedDeviation / result.diagonal <= Tolerance &&
+                        result.limitDeviation / result.diagonal <= Tolerance &&
+                        result.limitNormalDeviation <= NormalTolerance &&
+                        result.cornerDeviation / result.diagonal <= Tolerance &&
+                        result.cornerNormalDeviation <= NormalTolerance;
+    std::cout << result.file << ": " << result.verts << " vertices, " << result.faces
+              << " triangles, " << levels << " levels to " << result.refinedVerts << " vertices, "
+              << result.refinedFaces << " triangles" << std::endl;
+    std::cout << "  Subdivide " << std::fixed << std::setprecision(2)
+              << result.subdivideSeconds * 1000.0 << " ms, stencil table "
+              << result.buildSeconds * 1000.0 << " ms with " << result.weights << " weights, apply "
+              << result.applySeconds * 1000.0 << " ms, EvaluateLimit "
+              << result.limitSeconds * 1000.0 << " ms" << std::endl;
+    std::cout << "  stencil deviation " << std::scientific << std::setprecision(3)
+              << result.deviation / result.diagonal << ", deformed "
+              << result.deformedDeviation / result.diagonal << std::endl;
+    std::cout << "  limit deviation " << result.limitDeviation / result.diagonal << ", normal "
+              << result.limitNormalDeviation << ", corners "
+              << result.cornerDeviation / result.diagonal << ", normal "
+              << result.cornerNormalDeviation << " (" << result.nonManifoldCorners
+              << " non-manifold skipped), convergence " << result.convergence / result.diagonal
+              << std::fixed << (passed ? "" : "  FAILED") << std::endl;
+    return passed;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    std::vector<std::string> files;
+    size_t levels = 3;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--levels" && i + 1 < argc) {
+            levels = static_cast<size_t>(std::max(std::atoi(argv[++i]), 0));
+        } else {
+            files.push_back(arg);
+        }
+    }
+    if (files.empty()) {
+        std::error_code error;
+        for (const auto& entry : std::filesystem::directory_iterator(TNM079_DATA_DIR, error)) {
+            if (entry.path().extension() == ".obj") {
+                files.push_back(entry.path().string());
+            }
+        }
+        std::sort(files.begin(), files.end());
+        if (files.empty()) {
+            std::cerr << "Error: no obj files in '" << TNM079_DATA_DIR << "'" << std::endl;
+            return 1;
+        }
+    }
+
+    bool passed = true;
+    for (const std::string& file : files) {
+        ObjIO io;
+        if (!io.Read(file) || io.GetTris().empty()) {
+            std::cerr << "Error: could not read '" << file << "', skipped" << std::endl;
+            continue;
+        }
+        Result result;
+        result.file = file;
+        result.verts = io.GetVerts().size();
+        result.faces = io.GetTris().size();
+        if (!Subdivide(io, levels, result)) {
+            std::cerr << "Error: could not build a half edge mesh of '" << file << "', skipped"
+                      << std::endl;
+            continue;
+        }
+        passed = Report(result, levels) && passed;
+    }
+    return passed ? 0 : 1;
+}
@@ -12,10 +12,13 @@
  * Code updated in the period 2017-2018 by Jochen Jankowai
  *
  *************************************************************************************************/
+#include <algorithm>
 #include <cassert>
 #include <gtc/type_ptr.hpp>
 #include <Decimation/DecimationMesh.h>
-#include <GUI/GUI.h>
+#include <GUI/MeshBuffers.h>
+#include <Util/ObjIO.h>
+#include <Util/Parallel.h>
 
 const DecimationMesh::VisualizationMode DecimationMesh::CollapseCost =
     NewVisualizationMode("Collapse cost");
@@ -33,59 +36,59 @@ void DecimationMesh::Initialize() {
 
     // Allocate memory for the references from half-edge
     // to edge collapses
-    mHalfEdge2EdgeCollapse.reserve(mEdges.size());
-    mHalfEdge2EdgeCollapse.assign(mEdges.size(), NULL);
+    mHalfEdge2EdgeCollapse.assign(mEdges.size(), NoCollapse);
 
     // Loop through the half-edges (we know they are stored
     // sequentially) and create an edge collapse operation
     // for each pair
     auto numCollapses = mEdges.size() / 2;
-    for (size_t i = 0; i < numCollapses; i++) {
-        EdgeCollapse* collapse = new EdgeCollapse();
+    mCollapses.assign(numCollapses, EdgeCollapse());
+    mVersion = 0;
+    mVertexVersions.assign(mVerts.size(), 0);
+    mRound = 0;
+    mVertexRounds.assign(mVerts.size(), 0);
+    mSplits.clear();
+    mSplitEdges.clear();
+    mNumAppliedSplits = 0;
+    ParallelFor(numCollapses, [&](size_t i) {
+        EdgeCollapse* collapse = &mCollapses[i];
 
         // Connect the edge collapse with the half-edge pair
         collapse->halfEdge = i * 2;
 
         // Check if the collapse is valid
-        if (!isValidCollapse(collapse)) {
-            delete collapse;
-        } else {
-            mHalfEdge2EdgeCollapse[i * 2] = collapse;
-            mHalfEdge2EdgeCollapse[i * 2 + 1] = collapse;
+        if (isValidCollapse(collapse)) {
+            mHalfEdge2EdgeCollapse[i * 2] = i;
+            mHalfEdge2EdgeCollapse[i * 2 + 1] = i;
+        }
+    });
 
-            // Compute the cost and push it to the heap
-            computeCollapse(collapse);
-            mHeap.push(collapse);
+    // Compute the costs of the valid collapses, they are pushed to the heap below
+    std::vector<Index> valid;
+    valid.reserve(numCollapses);
+    for (size_t i = 0; i < numCollapses; i++) {
+        if (mHalfEdge2EdgeCollapse[i * 2] != NoCollapse) {
+            valid.push_back(i);
         }
     }
+    const size_t blockSize = 1024;
+    ParallelFor(
+        (valid.size() + blockSize - 1) / blockSize,
+        [&](size_t block) {
+            const size_t first = block * blockSize;
+            computeCollapses(&valid[first], std::min(blockSize, valid.size() - first));
+        },
+        2);
+    prepareCollapseOrder();
     // mHeap.print(std::cout);
 
     HalfEdgeMesh::Initialize();
 }
 
 void DecimationMesh::Update() {
-    // Calculate and store all differentials and area
-
-    // First update all face normals and triangle areas
-    for (size_t i = 0; i < GetNumFaces(); i++) {
-        if (!isFaceCollapsed(i)) f(i).normal = FaceNormal(i);
-    }
-    // Then update all vertex normals and curvature
-    for (size_t i = 0; i < GetNumVerts(); i++) {
-        // Vertex normals are just weighted averages
-        if (!isVertexCollapsed(i)) mVerts.at(i).normal = VertexNormal(i);
-    }
-
-    // Then update vertex curvature
-    for (size_t i = 0; i < GetNumVerts(); i++) {
-        if (!isVertexCollapsed(i)) mVerts.at(i).curvature = VertexCurvature(i);
-        //    std::cerr <<   mVerts.at(i).curvature << "\n";
-    }
-
-    // Finally update face curvature
-    for (size_t i = 0; i < GetNumFaces(); i++) {
-        if (!isFaceCollapsed(i)) f(i).curvature = FaceCurvature(i);
-    }
+    // Calculate and store all differentials of the remaining vertices and faces
+    InvalidateBuffers(MeshBuffers::Normals | MeshBuffers::Colors);
+    UpdateDifferentials(&mCollapsedVerts, &mCollapsedFaces);
 
     //  std::cerr << "Area: " << Area() << ".\n";
     //  std::cerr << "Volume: " << Volume() << ".\n";
@@ -110,17 +113,17 @@ void DecimationMesh::Update() {
                       << mMaxCMap << "]" << std::endl;
         } else {
             // Compute range from vertices
-            for (auto& vert : mVerts) {
-                if (minCurvature > vert.curvature) minCurvature = vert.curvature;
-                if (maxCurvature < vert.curvature) maxCurvature = vert.curvature;
+            for (float curvature : mVerts.curvature) {
+                if (minCurvature > curvature) minCurvature = curvature;
+                if (maxCurvature < curvature) maxCurvature = curvature;
             }
             std::cerr << "Automatic mapping of color based on vertex curvature with range ["
                       << minCurvature << "," << maxCurvature << "]" << std::endl;
             mMinCMap = minCurvature;
             mMaxCMap = maxCurvature;
         }
-        for (auto& vert : mVerts) {
-            vert.color = mColorMap->Map(vert.curvature, minCurvature, maxCurvature);
+        for (size_t i = 0; i < GetNumVerts(); i++) {
+            mVerts.color[i] = mColorMap->Map(mVerts.curvature[i], minCurvature, maxCurvature);
         }
     } else if (mVisualizationMode == CurvatureFace) {
         if (!mAutoMinMax) {
@@ -128,19 +131,299 @@ void DecimationMesh::Update() {
                       << mMaxCMap << "]" << std::endl;
         } else {
             // Compute range from faces
-            for (auto& face : mFaces) {
-                if (minCurvature > face.curvature) minCurvature = face.curvature;
-                if (maxCurvature < face.curvature) maxCurvature = face.curvature;
+            for (float curvature : mFaces.curvature) {
+                if (minCurvature > curvature) minCurvature = curvature;
+                if (maxCurvature < curvature) maxCurvature = curvature;
             }
             std::cerr << "Automatic mapping of color based on face curvature with range ["
                       << minCurvature << "," << maxCurvature << "]" << std::endl;
             mMinCMap = minCurvature;
             mMaxCMap = maxCurvature;
         }
-        for (auto& face : mFaces) {
-            face.color = mColorMap->Map(face.curvature, minCurvature, maxCurvature);
+        for (size_t i = 0; i < GetNumFaces(); i++) {
+            mFaces.color[i] = mColorMap->Map(mFaces.curvature[i], minCurvature, maxCurvature);
+        }
+    }
+}
+
+void DecimationMesh::SetCollapseOrder(CollapseOrder order, size_t numChoices) {
+    const bool changed = order != mCollapseOrder;
+    mCollapseOrder = order;
+    mNumChoices = std::max<size_t>(numChoices, 1);
+    if (changed && !mCollapses.empty()) {
+        prepareCollapseOrder();
+    }
+}
+
+void DecimationMesh::mapLiveElements(std::vector<Index>& keptVerts, std::vector<Index>& keptEdges,
+                                     std::vector<Index>& keptFaces, std::vector<Index>& vertMap,
+                                     std::vector<Index>& edgeMap,
+                                     std::vector<Index>& faceMap) const {
+    // A vertex is kept as long as a half edge leaves it. This is every vertex that is not
+    // collapsed, except that the unrewired fan of a non-manifold input vertex keeps it alive.
+    std::vector<bool> referenced(mVerts.size(), false);
+    for (size_t i = 0; i < mEdges.size(); i++) {
+        if (!isEdgeCollapsed(i)) referenced[mEdges[i].vert] = true;
+    }
+
+    const Index removed = std::numeric_limits<Index>::max();
+    keptVerts.clear();
+    keptEdges.clear();
+    keptFaces.clear();
+    vertMap.assign(mVerts.size(), removed);
+    edgeMap.assign(mEdges.size(), removed);
+    faceMap.assign(mFaces.size(), removed);
+    keptVerts.reserve(mVerts.size() - mNumCollapsedVerts);
+    keptEdges.reserve(mEdges.size() - mNumCollapsedEdges);
+    keptFaces.reserve(mFaces.size() - mNumCollapsedFaces);
+    for (size_t i = 0; i < mVerts.size(); i++) {
+        if (referenced[i]) {
+            vertMap[i] = keptVerts.size();
+            keptVerts.push_back(i);
+        }
+    }
+    for (size_t i = 0; i < mEdges.size(); i++) {
+        if (!isEdgeCollapsed(i)) {
+            edgeMap[i] = keptEdges.size();
+            keptEdges.push_back(i);
+        }
+    }
+    for (size_t i = 0; i < mFaces.size(); i++) {
+        if (!isFaceCollapsed(i)) {
+            faceMap[i] = keptFaces.size();
+            keptFaces.push_back(i);
+        }
+    }
+}
+
+void DecimationMesh::copyLiveElements(VertexArrays& verts, FaceArrays& faces,
+                                      std::vector<HalfEdge>& edges) const {
+    std::vector<Index> keptVerts, keptEdges, keptFaces, vertMap, edgeMap, faceMap;
+    mapLiveElements(keptVerts, keptEdges, keptFaces, vertMap, edgeMap, faceMap);
+
+    // The links are renumbered as in Compact(), EdgeState values stay as they are
+    edges.resize(keptEdges.size());
+    for (size_t i = 0; i < keptEdges.size(); i++) {
+        HalfEdge edge = mEdges[keptEdges[i]];
+        edge.vert = vertMap[edge.vert];
+        edge.pair = edgeMap[edge.pair];
+        if (edge.face < EdgeState::Uninitialized) edge.face = faceMap[edge.face];
+        if (edge.next < EdgeState::Uninitialized) edge.next = edgeMap[edge.next];
+        edges[i] = edge;
+    }
+
+    faces.clear();
+    faces.resize(keptFaces.size());
+    for (size_t i = 0; i < keptFaces.size(); i++) {
+        const Index old = keptFaces[i];
+        faces.normal[i] = mFaces.normal[old];
+        faces.color[i] = mFaces.color[old];
+        faces.curvature[i] = mFaces.curvature[old];
+        faces.edge[i] = edgeMap[mFaces.edge[old]];
+    }
+
+    verts.clear();
+    verts.resize(keptVerts.size());
+    for (size_t i = 0; i < keptVerts.size(); i++) {
+        const Index old = keptVerts[i];
+        verts.pos[i] = mVerts.pos[old];
+        verts.normal[i] = mVerts.normal[old];
+        verts.color[i] = mVerts.color[old];
+        verts.curvature[i] = mVerts.curvature[old];
+        const Index edge = mVerts.edge[old];
+        verts.edge[i] = edge < EdgeState::Uninitialized ? edgeMap[edge] : edge;
+    }
+    // The edge of a vertex may have been removed, or rewired to another vertex
+    for (size_t i = 0; i < edges.size(); i++) {
+        const Index vert = edges[i].vert;
+        const Index edge = verts.edge[vert];
+        if (edge >= edges.size() || edges[edge].vert != vert) {
+            verts.edge[vert] = i;
+        }
+    }
+}
+
+bool DecimationMesh::SaveCache(std::ostream& os) {
+    VertexArrays verts;
+    FaceArrays faces;
+    std::vector<HalfEdge> edges;
+    copyLiveElements(verts, faces, edges);
+    return WriteCache(os, verts, faces, edges);
+}
+
+bool DecimationMesh::save(std::ostream& os) {
+    std::vector<Index> keptVerts, keptEdges, keptFaces, vertMap, edgeMap, faceMap;
+    mapLiveElements(keptVerts, keptEdges, keptFaces, vertMap, edgeMap, faceMap);
+
+    ObjWriter writer(os);
+    writer.Comment("DecimationMesh obj streamer");
+    writer.Comment("M&A 2008");
+    for (Index old : keptVerts) {
+        writer.AddVertex(mVerts.pos[old]);
+    }
+    for (Index old : keptFaces) {
+        const Index e1 = mFaces.edge[old];
+        const Index e2 = mEdges[e1].next;
+        writer.AddFace(vertMap[mEdges[e1].vert], vertMap[mEdges[e2].vert],
+                       vertMap[mEdges[mEdges[e2].next].vert]);
+    }
+    return writer.Flush();
+}
+
+void DecimationMesh::Compact() {
+    // The old index of each element that is kept, and the new index of each old element
+    const Index removed = std::numeric_limits<Index>::max();
+    std::vector<Index> keptVerts, keptEdges, keptFaces, vertMap, edgeMap, faceMap;
+    mapLiveElements(keptVerts, keptEdges, keptFaces, vertMap, edgeMap, faceMap);
+
+    // Undone collapses leave an edge of each of their faces mapped to a collapse that
+    // moved on to the other edge, drop these
+    for (size_t i = 0; i < mEdges.size(); i++) {
+        const Index ind = mHalfEdge2EdgeCollapse[i];
+        if (ind != NoCollapse && mCollapses[ind].halfEdge != i &&
+            mEdges[mCollapses[ind].halfEdge].pair != i) {
+            mHalfEdge2EdgeCollapse[i] = NoCollapse;
+        }
+    }
+
+    // Only the collapses that are still attached to both half edges survive
+    std::vector<Index> collapseMap(mCollapses.size(), NoCollapse);
+    size_t numCollapses = 0;
+    for (size_t i = 0; i < mCollapses.size(); i++) {
+        const size_t halfEdge = mCollapses[i].halfEdge;
+        if (!isEdgeCollapsed(halfEdge) && isCollapseAlive(i) &&
+            mHalfEdge2EdgeCollapse[mEdges[halfEdge].pair] == i) {
+            collapseMap[i] = numCollapses;
+            mCollapses[numCollapses] = mCollapses[i];
+            mCollapses[numCollapses].halfEdge = edgeMap[mCollapses[i].halfEdge];
+            numCollapses++;
+        }
+    }
+    mCollapses.resize(numCollapses);
+    mCollapses.shrink_to_fit();
+
+    // Renumber the links, the EdgeState values of border edges stay as they are
+    for (Index old : keptEdges) {
+        HalfEdge& edge = mEdges[old];
+        edge.vert = vertMap[edge.vert];
+        edge.pair = edgeMap[edge.pair];
+        if (edge.face < EdgeState::Uninitialized) edge.face = faceMap[edge.face];
+        if (edge.next < EdgeState::Uninitialized) edge.next = edgeMap[edge.next];
+        const Index ind = mHalfEdge2EdgeCollapse[old];
+        mHalfEdge2EdgeCollapse[old] = ind == NoCollapse ? NoCollapse : collapseMap[ind];
+    }
+    compactArray(mEdges, keptEdges);
+    compactArray(mHalfEdge2EdgeCollapse, keptEdges);
+
+    for (Index old : keptFaces) {
+        mFaces.edge[old] = edgeMap[mFaces.edge[old]];
+    }
+    compactArray(mFaces.normal, keptFaces);
+    compactArray(mFaces.color, keptFaces);
+    compactArray(mFaces.curvature, keptFaces);
+    compactArray(mFaces.edge, keptFaces);
+
+    for (Index old : keptVerts) {
+        const Index edge = mVerts.edge[old];
+        mVerts.edge[old] = edge < EdgeState::Uninitialized ? edgeMap[edge] : removed;
+    }
+    compactArray(mVerts.pos, keptVerts);
+    compactArray(mVerts.normal, keptVerts);
+    compactArray(mVerts.color, keptVerts);
+    compactArray(mVerts.curvature, keptVerts);
+    compactArray(mVerts.edge, keptVerts);
+    compactArray(mVertexVersions, keptVerts);
+    // The costs belong to the coarsest recorded level, recompute them all for this one
+    const bool undone = mNumAppliedSplits < mSplits.size();
+    if (undone) {
+        mVersion++;
+        mVertexVersions.assign(mVertexVersions.size(), mVersion);
+    }
+    compactArray(mVertexRounds, keptVerts);
+    compactVertexProperties(keptVerts);
+
+    // The edge of a vertex may have been removed, or rewired to another vertex
+    for (size_t i = 0; i < mEdges.size(); i++) {
+        const Index vert = mEdges[i].vert;
+        const Index edge = mVerts.edge[vert];
+        if (edge == removed || mEdges[edge].vert != vert) {
+            mVerts.edge[vert] = i;
+        }
+    }
+
+    mCollapsedVerts.assign(mVerts.size(), false);
+    mCollapsedEdges.assign(mEdges.size(), false);
+    mCollapsedFaces.assign(mFaces.size(), false);
+    mCollapsedVerts.shrink_to_fit();
+    mCollapsedEdges.shrink_to_fit();
+    mCollapsedFaces.shrink_to_fit();
+    mNumCollapsedVerts = 0;
+    mNumCollapsedEdges = 0;
+    mNumCollapsedFaces = 0;
+
+    // So do the properties that collapses merged, and undoing them did not split again
+    if (undone) {
+        rebuildVertexProperties();
+    }
+
+    // The history refers to the removed elements
+    mSplits.clear();
+    mSplits.shrink_to_fit();
+    mSplitEdges.clear();
+    mSplitEdges.shrink_to_fit();
+    mNumAppliedSplits = 0;
+
+    // Edge pairs without a collapse, from undone collapses or invalid ones that may have
+    // become valid, are given a new one
+    for (size_t i = 0; i < mEdges.size(); i++) {
+        const size_t pair = mEdges[i].pair;
+        if (pair < i || mHalfEdge2EdgeCollapse[i] != NoCollapse ||
+            mHalfEdge2EdgeCollapse[pair] != NoCollapse) {
+            continue;
+        }
+        EdgeCollapse collapse;
+        collapse.halfEdge = i;
+        if (isValidCollapse(&collapse)) {
+            computeCollapse(&collapse);
+            collapse.version = mVersion;
+            mHalfEdge2EdgeCollapse[i] = mCollapses.size();
+            mHalfEdge2EdgeCollapse[pair] = mCollapses.size();
+            mCollapses.push_back(collapse);
         }
     }
+
+    FreeLookupTables();
+    mOneRingsValid = false;
+    InvalidateBuffers();
+    prepareCollapseOrder();
+}
+
+void DecimationMesh::prepareCollapseOrder() {
+    mHeap.reset(mCollapseOrder == MultipleChoiceOrder ? 0 : mCollapses.size());
+    mCandidates.clear();
+
+    for (size_t i = 0; i < mCollapses.size(); i++) {
+        if (!isCollapseAlive(i)) {
+            continue;
+        }
+        if (mCollapseOrder == MultipleChoiceOrder) {
+            mCandidates.push_back(i);
+            continue;
+        }
+
+        // The heap needs up to date costs, and has no place for invalid collapses
+        EdgeCollapse* collapse = &mCollapses[i];
+        if (!isValidCollapse(collapse)) {
+            mHalfEdge2EdgeCollapse[collapse->halfEdge] = NoCollapse;
+            mHalfEdge2EdgeCollapse[mEdges[collapse->halfEdge].pair] = NoCollapse;
+            continue;
+        }
+        if (isCollapseStale(collapse)) {
+            computeCollapse(collapse);
+            collapse->version = mVersion;
+        }
+        mHeap.push(i, collapse->cost);
+    }
 }
 
 bool DecimationMesh::decimate(size_t targetFaces) {
@@ -149,10 +432,28 @@ bool DecimationMesh::decimate(size_t targetFaces) {
         targetFaces = 2;
     }
 
+    // Levels that were decimated before are taken from the history
+    SetLevelOfDetail(targetFaces);
+
     // Keep collapsing one edge at a time until the target is reached
-    // or the heap is empty (when we have no possible collapses left)
-    while (mFaces.size() - mNumCollapsedFaces > targetFaces && !mHeap.isEmpty()) {
-        decimate();
+    // or the heap is empty (when we have no possible collapses left).
+    // Sampling can miss the few valid collapses that remain, so multiple
+    // choice gives up after as many failed samples as there are candidates.
+    size_t failures = 0;
+    while (mFaces.size() - mNumCollapsedFaces > targetFaces) {
+        if (mCollapseOrder == GreedyOrder) {
+            if (mHeap.isEmpty()) break;
+            decimate();
+        } else if (mCollapseOrder == IndependentSetOrder) {
+            if (mHeap.isEmpty()) break;
+            // Each collapse removes two faces, the last round may overshoot by one like greedy
+            const size_t excess = mFaces.size() - mNumCollapsedFaces - targetFaces;
+            collapseIndependentSet((excess + 1) / 2);
+        } else if (decimate()) {
+            failures = 0;
+        } else if (mCandidates.empty() || ++failures > mCandidates.size()) {
+            break;
+        }
     }
     // Return true if target is reached
     std::cout << "Collapsed mesh to " << mFaces.size() - mNumCollapsedFaces << " faces"
@@ -161,10 +462,57 @@ bool DecimationMesh::decimate(size_t targetFaces) {
 }
 
 bool DecimationMesh::decimate() {
-    EdgeCollapse* collapse = static_cast<EdgeCollapse*>(mHeap.pop());
-    if (collapse == NULL) {
+    if (mNumAppliedSplits < mSplits.size()) {
+        SetLevelOfDetail(mFaces.size() - mNumCollapsedFaces - 1);
+        return true;
+    }
+
+    if (mCollapseOrder == MultipleChoiceOrder) {
+        EdgeCollapse* collapse = sampleCollapse();
+        return collapse != NULL && performCollapse(collapse);
+    }
+
+    if (mHeap.isEmpty()) {
         return false;
     }
+    return performCollapse(&mCollapses[mHeap.pop()]);
+}
+
+DecimationMesh::EdgeCollapse* DecimationMesh::sampleCollapse() {
+    mSamples.clear();
+    while (mSamples.size() < mNumChoices && !mCandidates.empty()) {
+        std::uniform_int_distribution<size_t> distribution(0, mCandidates.size() - 1);
+        const size_t slot = distribution(mRandom);
+        const Index ind = mCandidates[slot];
+
+        // Drop collapses that were removed since they were added to the list
+        if (!isCollapseAlive(ind)) {
+            mCandidates[slot] = mCandidates.back();
+            mCandidates.pop_back();
+            continue;
+        }
+
+        // Recompute costs lazily, only for the collapses that are sampled
+        EdgeCollapse* collapse = &mCollapses[ind];
+        if (isCollapseStale(collapse)) {
+            computeCollapse(collapse);
+            collapse->version = mVersion;
+        }
+        mSamples.push_back(collapse);
+    }
+
+    if (mSamples.empty()) {
+        return NULL;
+    }
+    // Validity is left to performCollapse(), an invalid collapse is removed there
+    // and the next step samples again
+    return *std::min_element(mSamples.begin(), mSamples.end(),
+                             [](const EdgeCollapse* a, const EdgeCollapse* b) {
+                                 return a->cost < b->cost;
+                             });
+}
+
+bool DecimationMesh::performCollapse(EdgeCollapse* collapse) {
     // Stop the collapse when we only have two triangles left
     // (the smallest entity representable)
     if (mFaces.size() - mNumCollapsedFaces == 2) {
@@ -176,149 +524,451 @@ bool DecimationMesh::decimate() {
 
     size_t v1 = mEdges[e1].vert;
     size_t v2 = mEdges[e2].vert;
-    size_t v3 = mEdges[mEdges[e1].prev].vert;
-    size_t v4 = mEdges[mEdges[e2].prev].vert;
-
-    size_t f1 = mEdges[e1].face;
-    size_t f2 = mEdges[e2].face;
 
 #ifndef NDEBUG
-    std::cout << "Collapsing faces " << f1 << " and " << f2 << std::endl;
-    std::cout << "Collapsing edges " << e1 << ", " << mEdges[e1].next << ", " << mEdges[e1].prev;
-    std::cout << ", " << e2 << ", " << mEdges[e2].next << " and " << mEdges[e2].prev << std::endl;
+    std::cout << "Collapsing faces " << mEdges[e1].face << " and " << mEdges[e2].face << std::endl;
+    std::cout << "Collapsing edges " << e1 << ", " << mEdges[e1].next << ", " << Prev(e1);
+    std::cout << ", " << e2 << ", " << mEdges[e2].next << " and " << Prev(e2) << std::endl;
     std::cout << "Collapsing vertex " << v1 << std::endl;
 #endif
 
     // Verify that the collapse is valid, exit if not so
     if (!isValidCollapse(collapse)) {
-        delete collapse;
-        mHalfEdge2EdgeCollapse[e1] = NULL;
-        mHalfEdge2EdgeCollapse[e2] = NULL;
+        mHalfEdge2EdgeCollapse[e1] = NoCollapse;
+        mHalfEdge2EdgeCollapse[e2] = NoCollapse;
         std::cout << "failed..." << std::endl;
         return false;
     }
 
+    // The one-rings are rebuilt by the next Update(), the render buffers by the next Render()
+    mOneRingsValid = false;
+    InvalidateBuffers();
+
+    removeMergedCollapses(collapse);
+    recordCollapse(collapse);
+    collapseTopology(collapse);
+    markCollapsed(e1, v1);
+    mergeVertexProperties(v1, v2);
+
+    // Finally, loop through neighborhood of v2 and update all edge collapses
+    // (and remove possible invalid cases)
+    mVersion++;
+    updateNeighborhood(v2);
+    if (mCollapseOrder != MultipleChoiceOrder) {
+        updateHeap(v2);
+    }
+
+    // mHeap.print(std::cout);
+
+    return true;
+}
+
+void DecimationMesh::removeMergedCollapses(const EdgeCollapse* collapse) {
+    // One edge collapse further removes 2 additional collapse
+    // candidates from the heap
+    const size_t e1 = collapse->halfEdge;
+    const size_t e2 = mEdges[e1].pair;
+    if (mHeap.contains(mHalfEdge2EdgeCollapse[Prev(e1)])) {
+        mHeap.remove(mHalfEdge2EdgeCollapse[Prev(e1)]);
+    }
+    if (mHeap.contains(mHalfEdge2EdgeCollapse[mEdges[e2].next])) {
+        mHeap.remove(mHalfEdge2EdgeCollapse[mEdges[e2].next]);
+    }
+}
+
+void DecimationMesh::collapseTopology(const EdgeCollapse* collapse) {
+    const size_t e1 = collapse->halfEdge;
+    const size_t e2 = mEdges[e1].pair;
+    collapseConnectivity(e1, collapse->position);
+
+    // The remaining edge of each collapsed face takes over the collapse of the other one
+    mHalfEdge2EdgeCollapse[mEdges[Prev(e1)].pair] = mHalfEdge2EdgeCollapse[mEdges[e1].next];
+    mHalfEdge2EdgeCollapse[mEdges[mEdges[e2].next].pair] = mHalfEdge2EdgeCollapse[Prev(e2)];
+
+    // Make sure the edge collapses point to valid edges
+    if (EdgeCollapse* other = getCollapse(mEdges[e1].next)) {
+        other->halfEdge = mEdges[Prev(e1)].pair;
+    }
+    if (EdgeCollapse* other = getCollapse(Prev(e2))) {
+        other->halfEdge = mEdges[mEdges[e2].next].pair;
+    }
+}
+
+void DecimationMesh::collapseConnectivity(size_t e1, const glm::vec3& position) {
+    size_t e2 = mEdges[e1].pair;
+
+    size_t v1 = mEdges[e1].vert;
+    size_t v2 = mEdges[e2].vert;
+    size_t v3 = mEdges[Prev(e1)].vert;
+    size_t v4 = mEdges[Prev(e2)].vert;
+
+    size_t f1 = mEdges[e1].face;
+    size_t f2 = mEdges[e2].face;
+
     // We want to remove v1, so we need to connect all of v1's half-edges to v2
-    size_t edge = mVerts[v1].edge;
+    size_t edge = mVerts.edge[v1];
     do {
         mEdges[edge].vert = v2;
         edge = mEdges[mEdges[edge].pair].next;
-    } while (edge != mVerts[v1].edge);
+    } while (edge != mVerts.edge[v1]);
 
     // Make sure v2 points to a valid edge
-    while (mEdges[mVerts[v2].edge].face == f1 || mEdges[mVerts[v2].edge].face == f2) {
-        mVerts[v2].edge = mEdges[mEdges[mVerts[v2].edge].pair].next;
+    while (mEdges[mVerts.edge[v2]].face == f1 || mEdges[mVerts.edge[v2]].face == f2) {
+        mVerts.edge[v2] = mEdges[mEdges[mVerts.edge[v2]].pair].next;
     }
 
     // Make sure v3 points to a valid edge
-    while (mEdges[mVerts[v3].edge].face == f1) {
-        mVerts[v3].edge = mEdges[mEdges[mVerts[v3].edge].pair].next;
+    while (mEdges[mVerts.edge[v3]].face == f1) {
+        mVerts.edge[v3] = mEdges[mEdges[mVerts.edge[v3]].pair].next;
     }
 
     // Make sure v4 points to a valid edge
-    while (mEdges[mVerts[v4].edge].face == f2) {
-        mVerts[v4].edge = mEdges[mEdges[mVerts[v4].edge].pair].next;
+    while (mEdges[mVerts.edge[v4]].face == f2) {
+        mVerts.edge[v4] = mEdges[mEdges[mVerts.edge[v4]].pair].next;
     }
 
     // Redirect pair pointers
-    mEdges[mEdges[mEdges[e1].next].pair].pair = mEdges[mEdges[e1].prev].pair;
-    mEdges[mEdges[mEdges[e1].prev].pair].pair = mEdges[mEdges[e1].next].pair;
+    mEdges[mEdges[mEdges[e1].next].pair].pair = mEdges[Prev(e1)].pair;
+    mEdges[mEdges[Prev(e1)].pair].pair = mEdges[mEdges[e1].next].pair;
 
-    mEdges[mEdges[mEdges[e2].next].pair].pair = mEdges[mEdges[e2].prev].pair;
-    mEdges[mEdges[mEdges[e2].prev].pair].pair = mEdges[mEdges[e2].next].pair;
+    mEdges[mEdges[mEdges[e2].next].pair].pair = mEdges[Prev(e2)].pair;
+    mEdges[mEdges[Prev(e2)].pair].pair = mEdges[mEdges[e2].next].pair;
 
     // Move v2 to its new position
-    mVerts[v2].pos = collapse->position;
-
-    // One edge collapse further removes 2 additional collapse
-    // candidates from the heap
-    if (mHalfEdge2EdgeCollapse[mEdges[e1].prev] != NULL) {
-        delete mHeap.remove(mHalfEdge2EdgeCollapse[mEdges[e1].prev]);
-    }
-    mHalfEdge2EdgeCollapse[mEdges[mEdges[e1].prev].pair] = mHalfEdge2EdgeCollapse[mEdges[e1].next];
-
-    if (mHalfEdge2EdgeCollapse[mEdges[e2].next] != NULL) {
-        delete mHeap.remove(mHalfEdge2EdgeCollapse[mEdges[e2].next]);
-    }
-    mHalfEdge2EdgeCollapse[mEdges[mEdges[e2].next].pair] = mHalfEdge2EdgeCollapse[mEdges[e2].prev];
-
-    // Make sure the edge collapses point to valid edges
-    if (mHalfEdge2EdgeCollapse[mEdges[e1].next] != NULL) {
-        mHalfEdge2EdgeCollapse[mEdges[e1].next]->halfEdge = mEdges[mEdges[e1].prev].pair;
-    }
-    if (mHalfEdge2EdgeCollapse[mEdges[e2].prev] != NULL) {
-        mHalfEdge2EdgeCollapse[mEdges[e2].prev]->halfEdge = mEdges[mEdges[e2].next].pair;
-    }
+    mVerts.pos[v2] = position;
+}
 
-    delete collapse;
+void DecimationMesh::markCollapsed(size_t e1, size_t v1) {
+    size_t e2 = mEdges[e1].pair;
 
     // Collapse the neighborhood
-    collapseFace(f1);
-    collapseFace(f2);
+    collapseFace(mEdges[e1].face);
+    collapseFace(mEdges[e2].face);
 
     collapseEdge(e1);
     collapseEdge(mEdges[e1].next);
-    collapseEdge(mEdges[e1].prev);
+    collapseEdge(Prev(e1));
 
     collapseEdge(e2);
     collapseEdge(mEdges[e2].next);
-    collapseEdge(mEdges[e2].prev);
+    collapseEdge(Prev(e2));
 
     collapseVertex(v1);
+}
+
+void DecimationMesh::updateNeighborhood(size_t v2) {
+    const size_t MaxRing = 32;
+    Index ring[MaxRing];
+    size_t numRing = 0;
 
-    // Finally, loop through neighborhood of v2 and update all edge collapses
-    // (and remove possible invalid cases)
     updateVertexProperties(v2);
-    edge = mVerts[v2].edge;
+    mVertexVersions[v2] = mVersion;
+    size_t edge = mVerts.edge[v2];
     do {
         size_t face = mEdges[edge].face;
         size_t vert = mEdges[mEdges[edge].pair].vert;
         if (!isFaceCollapsed(face)) updateFaceProperties(face);
-        if (!isVertexCollapsed(vert)) updateVertexProperties(vert);
-
-        collapse = mHalfEdge2EdgeCollapse[edge];
-        if (collapse != NULL) {
-            if (!isValidCollapse(collapse)) {
-                delete mHeap.remove(collapse);
-                mHalfEdge2EdgeCollapse[edge] = NULL;
-                mHalfEdge2EdgeCollapse[mEdges[edge].pair] = NULL;
+        if (!isVertexCollapsed(vert)) {
+            updateVertexProperties(vert);
+            mVertexVersions[vert] = mVersion;
+        }
+
+        // Multiple choice only marks the changed vertices, their collapses are
+        // recomputed when sampled. An invalid collapse keeps its old version.
+        const Index ind = mHalfEdge2EdgeCollapse[edge];
+        if (ind != NoCollapse && mCollapseOrder != MultipleChoiceOrder) {
+            EdgeCollapse* collapse = &mCollapses[ind];
+            if (isValidCollapse(collapse)) {
+                collapse->version = mVersion;
+                ring[numRing++] = ind;
+                if (numRing == MaxRing) {
+                    computeCollapses(ring, numRing);
+                    numRing = 0;
+                }
+            }
+        }
+
+        edge = mEdges[mEdges[edge].pair].next;
+    } while (edge != mVerts.edge[v2]);
+
+    // The vertex properties of the whole ring are up to date, so the costs are computed
+    // together
+    computeCollapses(ring, numRing);
+}
+
+void DecimationMesh::updateHeap(size_t v2) {
+    size_t edge = mVerts.edge[v2];
+    do {
+        const Index ind = mHalfEdge2EdgeCollapse[edge];
+        if (ind != NoCollapse) {
+            if (mCollapses[ind].version != mVersion) {
+                mHeap.remove(ind);
+                mHalfEdge2EdgeCollapse[edge] = NoCollapse;
+                mHalfEdge2EdgeCollapse[mEdges[edge].pair] = NoCollapse;
 #ifndef NDEBUG
                 std::cout << "Removed one invalid edge collapse" << std::endl;
 #endif
             } else {
-                computeCollapse(collapse);
-                mHeap.update(collapse);
+                mHeap.update(ind, mCollapses[ind].cost);
             }
         }
 
         edge = mEdges[mEdges[edge].pair].next;
-    } while (edge != mVerts[v2].edge);
+    } while (edge != mVerts.edge[v2]);
+}
 
-    // mHeap.print(std::cout);
+bool DecimationMesh::collapseIndependentSet(size_t maxCollapses) {
+    // Take the cheapest collapses that do not conflict with a collapse taken before.
+    // Collapses that conflict are put back and get another chance next round. Only
+    // the cheapest part of the heap is examined, and the round ends early once
+    // conflicts outnumber the selected collapses, so the order stays close to greedy
+    // and collapses are not examined over and over.
+    const size_t numExamined = std::max<size_t>(mHeap.size() / RoundDivisor, 1);
+    mRound++;
+    mSelected.clear();
+    mDeferred.clear();
+    for (size_t i = 0; i < numExamined && mSelected.size() < maxCollapses && !mHeap.isEmpty() &&
+                       mDeferred.size() <= mSelected.size();
+         i++) {
+        const Index ind = mHeap.pop();
+        if (claimNeighborhood(&mCollapses[ind])) {
+            mSelected.push_back(ind);
+        } else {
+            mDeferred.push_back(ind);
+        }
+    }
+    for (Index ind : mDeferred) {
+        mHeap.push(ind, mCollapses[ind].cost);
+    }
+
+    // The selected collapses do not write anything another one reads, so apart from
+    // the heap and the vector<bool> flags they run in parallel. An invalid collapse
+    // only blocked its neighborhood for this round.
+    mSelectedValid.resize(mSelected.size());
+    ParallelFor(
+        mSelected.size(),
+        [&](size_t i) { mSelectedValid[i] = isValidCollapse(&mCollapses[mSelected[i]]); },
+        MinParallelCollapses);
+
+    size_t numSelected = 0;
+    mSelectedVerts.clear();
+    for (size_t i = 0; i < mSelected.size(); i++) {
+        const EdgeCollapse* collapse = &mCollapses[mSelected[i]];
+        if (mSelectedValid[i]) {
+            mSelected[numSelected++] = mSelected[i];
+            mSelectedVerts.push_back(mEdges[collapse->halfEdge].vert);
+            removeMergedCollapses(collapse);
+            recordCollapse(collapse);
+        } else {
+            mHalfEdge2EdgeCollapse[collapse->halfEdge] = NoCollapse;
+            mHalfEdge2EdgeCollapse[mEdges[collapse->halfEdge].pair] = NoCollapse;
+        }
+    }
+    mSelected.resize(numSelected);
+    if (numSelected == 0) {
+        return false;
+    }
+    mOneRingsValid = false;
+    InvalidateBuffers();
+
+    ParallelFor(
+        numSelected, [&](size_t i) { collapseTopology(&mCollapses[mSelected[i]]); },
+        MinParallelCollapses);
+
+    for (size_t i = 0; i < numSelected; i++) {
+        markCollapsed(mCollapses[mSelected[i]].halfEdge, mSelectedVerts[i]);
+    }
+
+    // Every collapse of this round shares one version
+    mVersion++;
+    ParallelFor(
+        numSelected,
+        [&](size_t i) {
+            const EdgeCollapse* collapse = &mCollapses[mSelected[i]];
+            const size_t v2 = mEdges[mEdges[collapse->halfEdge].pair].vert;
+            mergeVertexProperties(mSelectedVerts[i], v2);
+            updateNeighborhood(v2);
+        },
+        MinParallelCollapses);
+
+    for (size_t i = 0; i < numSelected; i++) {
+        const EdgeCollapse* collapse = &mCollapses[mSelected[i]];
+        updateHeap(mEdges[mEdges[collapse->halfEdge].pair].vert);
+    }
 
     return true;
 }
 
-void DecimationMesh::updateVertexProperties(size_t ind) {
-    std::vector<size_t> neighborFaces = FindNeighborFaces(ind);
+bool DecimationMesh::claimNeighborhood(const EdgeCollapse* collapse) {
+    const size_t e1 = collapse->halfEdge;
+    const size_t ends[2] = {mEdges[e1].vert, mEdges[mEdges[e1].pair].vert};
 
-    // Approximate vertex normal
-    glm::vec3 n(0, 0, 0);
+    // The ring of a removed vertex cannot be walked. Such collapses are taken without
+    // claiming anything, isValidCollapse() rejects them later in the round.
+    if (isVertexCollapsed(ends[0]) || isVertexCollapsed(ends[1])) {
+        return true;
+    }
 
-    const auto numCandidates = neighborFaces.size();
-    for (size_t i = 0; i < numCandidates; i++) {
-        Face& triangle = mFaces[neighborFaces[i]];
+    // A collapse writes to its one-ring (the neighbors of v1 and v2, which include v1
+    // and v2) and reads its two-ring. Two collapses may run together if neither writes
+    // where the other reads, that is if no vertex of the one-ring is in a claimed two-ring.
+    for (size_t end : ends) {
+        for (Index neighbor : NeighborVertices(end)) {
+            if (mVertexRounds[neighbor] == mRound) {
+                return false;
+            }
+        }
+    }
 
-        // Calculate face normal
-        HalfEdge* edge = &mEdges[triangle.edge];
+    for (size_t end : ends) {
+        for (Index neighbor : NeighborVertices(end)) {
+            // Also rejected later, see above
+            if (isVertexCollapsed(neighbor)) {
+                continue;
+            }
+            for (Index vert : NeighborVertices(neighbor)) {
+                mVertexRounds[vert] = mRound;
+            }
+        }
+    }
+    return true;
+}
+
+void DecimationMesh::SetLevelOfDetail(size_t numFaces) {
+    // The rounds of IndependentSetOrder are over, so mVertexRounds marks the moved vertices
+    mRound++;
+    mMovedVerts.clear();
+    while (mNumAppliedSplits > 0 && mFaces.size() - mNumCollapsedFaces + 2 <= numFaces) {
+        splitVertex();
+    }
+    while (mNumAppliedSplits < mSplits.size() && mFaces.size() - mNumCollapsedFaces > numFaces) {
+        redoCollapse();
+    }
+    if (!mMovedVerts.empty()) {
+        mOneRingsValid = false;
+        InvalidateBuffers();
+        updateMovedProperties();
+    }
+}
 
-        glm::vec3& p0 = mVerts[edge->vert].pos;
-        edge = &mEdges[edge->next];
+void DecimationMesh::recordCollapse(const EdgeCollapse* collapse) {
+    // New collapses can only be added at the coarsest level
+    assert(mNumAppliedSplits == mSplits.size());
+
+    const size_t e1 = collapse->halfEdge;
+    const size_t e2 = mEdges[e1].pair;
+    VertexSplit split;
+    split.halfEdge = e1;
+    split.removedVertex = mEdges[e1].vert;
+    split.firstEdge = mSplitEdges.size();
+    split.vertexEdges[0] = mVerts.edge[mEdges[e2].vert];
+    split.vertexEdges[1] = mVerts.edge[mEdges[Prev(e1)].vert];
+    split.vertexEdges[2] = mVerts.edge[mEdges[Prev(e2)].vert];
+    split.oldPosition = mVerts.pos[mEdges[e2].vert];
+    split.newPosition = collapse->position;
+
+    // The same edges that collapseConnectivity() moves to v2
+    const size_t first = mVerts.edge[split.removedVertex];
+    size_t edge = first;
+    do {
+        mSplitEdges.push_back(edge);
+        edge = mEdges[mEdges[edge].pair].next;
+    } while (edge != first);
 
-        glm::vec3& p1 = mVerts[edge->vert].pos;
-        edge = &mEdges[edge->next];
+    mSplits.push_back(split);
+    mNumAppliedSplits++;
+}
 
-        glm::vec3& p2 = mVerts[edge->vert].pos;
+void DecimationMesh::splitVertex() {
+    // Collapses are undone in the reverse order, so every link they changed is as the
+    // collapse left it. The removed elements were not touched since.
+    const size_t index = --mNumAppliedSplits;
+    const VertexSplit& split = mSplits[index];
+    const size_t lastEdge =
+        index + 1 < mSplits.size() ? mSplits[index + 1].firstEdge : mSplitEdges.size();
+
+    const size_t e1 = split.halfEdge;
+    const size_t e2 = mEdges[e1].pair;
+    const size_t v1 = split.removedVertex;
+    const size_t v2 = mEdges[e2].vert;
+
+    for (size_t i = split.firstEdge; i < lastEdge; i++) {
+        mEdges[mSplitEdges[i]].vert = v1;
+    }
+
+    // The removed edges still know their pairs
+    const size_t removedEdges[4] = {mEdges[e1].next, Prev(e1), mEdges[e2].next, Prev(e2)};
+    for (size_t edge : removedEdges) {
+        mEdges[mEdges[edge].pair].pair = edge;
+    }
+
+    mVerts.pos[v2] = split.oldPosition;
+    mVerts.edge[v2] = split.vertexEdges[0];
+    mVerts.edge[mEdges[Prev(e1)].vert] = split.vertexEdges[1];
+    mVerts.edge[mEdges[Prev(e2)].vert] = split.vertexEdges[2];
+
+    restoreFace(mEdges[e1].face);
+    restoreFace(mEdges[e2].face);
+    for (size_t edge : {e1, e2}) {
+        restoreEdge(edge);
+        restoreEdge(mEdges[edge].next);
+        restoreEdge(Prev(edge));
+    }
+    restoreVertex(v1);
+
+    markMoved(v1);
+    markMoved(v2);
+}
+
+void DecimationMesh::redoCollapse() {
+    const VertexSplit& split = mSplits[mNumAppliedSplits++];
+    collapseConnectivity(split.halfEdge, split.newPosition);
+    markCollapsed(split.halfEdge, split.removedVertex);
+    markMoved(mEdges[mEdges[split.halfEdge].pair].vert);
+}
+
+void DecimationMesh::markMoved(size_t ind) {
+    if (mVertexRounds[ind] != mRound) {
+        mVertexRounds[ind] = mRound;
+        mMovedVerts.push_back(ind);
+    }
+}
+
+void DecimationMesh::updateMovedProperties() {
+    // Only the normals, the decimation data of the subclasses belongs to the coarsest
+    // level. Each vertex next to a moved one is updated once.
+    mRound++;
+    for (Index ind : mMovedVerts) {
+        if (isVertexCollapsed(ind)) {
+            continue;
+        }
+        for (Index face : NeighborFaces(ind)) {
+            updateFaceProperties(face);
+        }
+        for (Index vert : NeighborVertices(ind)) {
+            if (mVertexRounds[vert] != mRound && !isVertexCollapsed(vert)) {
+                mVertexRounds[vert] = mRound;
+                DecimationMesh::updateVertexProperties(vert);
+            }
+        }
+        if (mVertexRounds[ind] != mRound) {
+            mVertexRounds[ind] = mRound;
+            DecimationMesh::updateVertexProperties(ind);
+        }
+    }
+}
+
+void DecimationMesh::updateVertexProperties(size_t ind) {
+    // Approximate vertex normal
+    glm::vec3 n(0, 0, 0);
+
+    for (Index face : NeighborFaces(ind)) {
+        // Calculate face normal
+        const std::array<Index, 3> verts = FaceVertices(face);
+
+        const glm::vec3& p0 = mVerts.pos[verts[0]];
+        const glm::vec3& p1 = mVerts.pos[verts[1]];
+        const glm::vec3& p2 = mVerts.pos[verts[2]];
 
         glm::vec3 v1 = p1 - p0;
         glm::vec3 v2 = p2 - p0;
@@ -329,19 +979,19 @@ void DecimationMesh::updateVertexProperties(size_t ind) {
     }
 
     n = glm::normalize(n);
-    mVerts[ind].normal = n;
+    mVerts.normal[ind] = n;
 }
 
 void DecimationMesh::updateFaceProperties(size_t ind) {
-    HalfEdge* edge = &mEdges[mFaces[ind].edge];
+    HalfEdge* edge = &mEdges[mFaces.edge[ind]];
 
-    glm::vec3& p0 = mVerts[edge->vert].pos;
+    glm::vec3& p0 = mVerts.pos[edge->vert];
     edge = &mEdges[edge->next];
 
-    glm::vec3& p1 = mVerts[edge->vert].pos;
+    glm::vec3& p1 = mVerts.pos[edge->vert];
     edge = &mEdges[edge->next];
 
-    glm::vec3& p2 = mVerts[edge->vert].pos;
+    glm::vec3& p2 = mVerts.pos[edge->vert];
 
     // Calculate face normal
     glm::vec3 v1 = p1 - p0;
@@ -349,7 +999,7 @@ void DecimationMesh::updateFaceProperties(size_t ind) {
     glm::vec3 n = glm::cross(v1, v2);
     n = glm::normalize(n);
 
-    mFaces[ind].normal = n;
+    mFaces.normal[ind] = n;
 }
 
 bool DecimationMesh::isValidCollapse(EdgeCollapse* collapse) {
@@ -358,31 +1008,51 @@ bool DecimationMesh::isValidCollapse(EdgeCollapse* collapse) {
 
     size_t v1 = mEdges[e1].vert;
     size_t v2 = mEdges[e2].vert;
-    size_t v3 = mEdges[mEdges[e1].prev].vert;
-    size_t v4 = mEdges[mEdges[e2].prev].vert;
+    size_t v3 = mEdges[Prev(e1)].vert;
+    size_t v4 = mEdges[Prev(e2)].vert;
 
     // Do a dummy check
     if (isEdgeCollapsed(e1) || isEdgeCollapsed(e1) || isVertexCollapsed(v1) ||
         isVertexCollapsed(v2))
         return false;
 
-    size_t edge = mVerts[v2].edge;
-    std::vector<size_t> neighbors;
-    do {
-        size_t ind = mEdges[mEdges[edge].pair].vert;
-        if (ind != v3 && ind != v4) neighbors.push_back(ind);
-        edge = mEdges[mEdges[edge].pair].next;
-    } while (edge != mVerts[v2].edge);
-
-    edge = mVerts[v1].edge;
+    // The only vertices that v1 and v2 may share are v3 and v4, the ring of v2 is walked
+    // once per neighbor of v1 instead of being copied so that the test writes no state.
+    // A removed neighbor is left over from a non-manifold vertex in the input (cow.obj
+    // has one) whose second fan was not rewired, such neighborhoods are left alone.
+    size_t edge1 = mVerts.edge[v1];
     do {
-        size_t ind = mEdges[mEdges[edge].pair].vert;
-        if (find(neighbors.begin(), neighbors.end(), ind) != neighbors.end()) {
+        const size_t ind = mEdges[mEdges[edge1].pair].vert;
+        if (isVertexCollapsed(ind)) {
             return false;
         }
+        if (ind != v3 && ind != v4) {
+            size_t edge2 = mVerts.edge[v2];
+            do {
+                const size_t neighbor = mEdges[mEdges[edge2].pair].vert;
+                if (neighbor == ind || isVertexCollapsed(neighbor)) {
+                    return false;
+                }
+                edge2 = mEdges[mEdges[edge2].pair].next;
+            } while (edge2 != mVerts.edge[v2]);
+        }
 
-        edge = mEdges[mEdges[edge].pair].next;
-    } while (edge != mVerts[v1].edge);
+        edge1 = mEdges[mEdges[edge1].pair].next;
+    } while (edge1 != mVerts.edge[v1]);
+
+    // An edge of a tetrahedron passes the test above, but its collapse leaves two faces
+    // back to back. Its v3 and v4 have only three neighbors, which is otherwise ruled out.
+    for (size_t vert : {v3, v4}) {
+        size_t edge = mVerts.edge[vert];
+        size_t numNeighbors = 0;
+        do {
+            numNeighbors++;
+            edge = mEdges[mEdges[edge].pair].next;
+        } while (edge != mVerts.edge[vert] && numNeighbors <= 3);
+        if (numNeighbors <= 3) {
+            return false;
+        }
+    }
 
     return true;
 }
@@ -393,6 +1063,7 @@ void DecimationMesh::Cleanup() {
 }
 
 void DecimationMesh::Render() {
+#ifndef MOA_HEADLESS
     glEnable(GL_LIGHTING);
     glMatrixMode(GL_MODELVIEW);
 
@@ -406,100 +1077,105 @@ void DecimationMesh::Render() {
     if (mWireframe) glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
     // Draw geometry
-    for (size_t i = 0; i < mFaces.size(); i++) {
-        if (isFaceCollapsed(i)) {
-            continue;
-        }
-
-        // Render without notations
-        Face& f = mFaces[i];
-
-        HalfEdge* edge = &mEdges[f.edge];
-
-        Vertex& v1 = mVerts[edge->vert];
-        edge = &mEdges[edge->next];
-
-        Vertex& v2 = mVerts[edge->vert];
-        edge = &mEdges[edge->next];
-
-        Vertex& v3 = mVerts[edge->vert];
-
-        // Render with notations
-        //  Uncomment this block, and comment the block above
-        //    to render with notations
-        /*
-            Face & f = mFaces[i];
-
-            char buffer[10];
-            glColor3f(1.0, 0.0, 0.0);
-            HalfEdge* edge = &mEdges[mFaces[i].edge];
-
-            // draw face
-            sprintf(buffer, "f%i\n", i);
-            glm::vec3 vec = (mVerts[edge->vert].pos +
-           mVerts[mEdges[edge->pair].vert].pos)*0.5; vec += 0.5 *
-           (mVerts[mEdges[edge->prev].vert].pos - vec); drawText(vec, buffer);
+    if (MeshBuffers::IsSupported()) {
+        DrawBuffers(mVerts, mFaces);
+    } else {
+        for (size_t i = 0; i < mFaces.size(); i++) {
+            if (isFaceCollapsed(i)) {
+                continue;
+            }
 
-            // draw e1
-            sprintf(buffer, "e%i\n", mFaces[i].edge);
-            vec = (mVerts[edge->vert].pos +
-           mVerts[mEdges[edge->pair].vert].pos)*0.5; vec += 0.1 *
-           (mVerts[mEdges[edge->prev].vert].pos - vec); drawText(vec, buffer);
+            // Render without notations
+            const FaceRef f = mFaces[i];
 
-            // draw v1
-            Vertex& v1 = mVerts[edge->vert];
-            sprintf(buffer, "v%i\n", edge->vert);
-            drawText(vec, buffer);
+            HalfEdge* edge = &mEdges[f.edge];
 
-            sprintf(buffer, "e%i\n", edge->next);
+            const VertexRef v1 = mVerts[edge->vert];
             edge = &mEdges[edge->next];
 
-            // draw e2
-            vec = (mVerts[edge->vert].pos +
-           mVerts[mEdges[edge->pair].vert].pos)*0.5; vec += 0.1 *
-           (mVerts[mEdges[edge->prev].vert].pos - vec); drawText(vec, buffer);
+            const VertexRef v2 = mVerts[edge->vert];
+            edge = &mEdges[edge->next];
 
-            // draw v2
-            Vertex& v2 = mVerts[edge->vert];
-            sprintf(buffer, "v%i\n", edge->vert);
-            drawText(vec, buffer);
+            const VertexRef v3 = mVerts[edge->vert];
+
+            // Render with notations
+            //  Uncomment this block, and comment the block above
+            //    to render with notations. Notations need the immediate mode path, so
+            //    also replace the MeshBuffers::IsSupported() test above with false
+            /*
+                const FaceRef f = mFaces[i];
+
+                char buffer[10];
+                glColor3f(1.0, 0.0, 0.0);
+                HalfEdge* edge = &mEdges[mFaces.edge[i]];
+
+                // draw face
+                sprintf(buffer, "f%i\n", i);
+                glm::vec3 vec = (mVerts.pos[edge->vert] +
+               mVerts.pos[mEdges[edge->pair].vert])*0.5; vec += 0.5 *
+               (mVerts.pos[mEdges[Prev(edge - &mEdges[0])].vert] - vec); drawText(vec, buffer);
+
+                // draw e1
+                sprintf(buffer, "e%i\n", mFaces.edge[i]);
+                vec = (mVerts.pos[edge->vert] +
+               mVerts.pos[mEdges[edge->pair].vert])*0.5; vec += 0.1 *
+               (mVerts.pos[mEdges[Prev(edge - &mEdges[0])].vert] - vec); drawText(vec, buffer);
+
+                // draw v1
+                Vertex& v1 = mVerts[edge->vert];
+                sprintf(buffer, "v%i\n", edge->vert);
+                drawText(vec, buffer);
+
+                sprintf(buffer, "e%i\n", edge->next);
+                edge = &mEdges[edge->next];
+
+                // draw e2
+                vec = (mVerts.pos[edge->vert] +
+               mVerts.pos[mEdges[edge->pair].vert])*0.5; vec += 0.1 *
+               (mVerts.pos[mEdges[Prev(edge - &mEdges[0])].vert] - vec); drawText(vec, buffer);
+
+                // draw v2
+                Vertex& v2 = mVerts[edge->vert];
+                sprintf(buffer, "v%i\n", edge->vert);
+                drawText(vec, buffer);
+
+                sprintf(buffer, "e%i\n", edge->next);
+                edge = &mEdges[edge->next];
+
+                // draw e3
+                vec = (mVerts.pos[edge->vert] +
+               mVerts.pos[mEdges[edge->pair].vert])*0.5; vec += 0.1 *
+               (mVerts.pos[mEdges[Prev(edge - &mEdges[0])].vert] - vec); drawText(vec, buffer);
+
+                // draw v3
+                Vertex& v3 = mVerts[edge->vert];
+                sprintf(buffer, "v%i\n", edge->vert);
+                drawText(vec, buffer);
+             */
+
+            glBegin(GL_TRIANGLES);
+            if (mVisualizationMode == CurvatureVertex) {
+                glColor3fv(glm::value_ptr(v1.color));
+                glNormal3fv(glm::value_ptr(v1.normal));
+                glVertex3fv(glm::value_ptr(v1.pos));
 
-            sprintf(buffer, "e%i\n", edge->next);
-            edge = &mEdges[edge->next];
+                glColor3fv(glm::value_ptr(v2.color));
+                glNormal3fv(glm::value_ptr(v2.normal));
+                glVertex3fv(glm::value_ptr(v2.pos));
 
-            // draw e3
-            vec = (mVerts[edge->vert].pos +
-           mVerts[mEdges[edge->pair].vert].pos)*0.5; vec += 0.1 *
-           (mVerts[mEdges[edge->prev].vert].pos - vec); drawText(vec, buffer);
-
-            // draw v3
-            Vertex& v3 = mVerts[edge->vert];
-            sprintf(buffer, "v%i\n", edge->vert);
-            drawText(vec, buffer);
-         */
-
-        glBegin(GL_TRIANGLES);
-        if (mVisualizationMode == CurvatureVertex) {
-            glColor3fv(glm::value_ptr(v1.color));
-            glNormal3fv(glm::value_ptr(v1.normal));
-            glVertex3fv(glm::value_ptr(v1.pos));
-
-            glColor3fv(glm::value_ptr(v2.color));
-            glNormal3fv(glm::value_ptr(v2.normal));
-            glVertex3fv(glm::value_ptr(v2.pos));
-
-            glColor3fv(glm::value_ptr(v3.color));
-            glNormal3fv(glm::value_ptr(v3.normal));
-            glVertex3fv(glm::value_ptr(v3.pos));
-        } else {
-            glColor3fv(glm::value_ptr(f.color));
-            glNormal3fv(glm::value_ptr(f.normal));
+                glColor3fv(glm::value_ptr(v3.color));
+                glNormal3fv(glm::value_ptr(v3.normal));
+                glVertex3fv(glm::value_ptr(v3.pos));
+            } else {
+                glColor3fv(glm::value_ptr(f.color));
+                glNormal3fv(glm::value_ptr(f.normal));
 
-            glVertex3fv(glm::value_ptr(v1.pos));
-            glVertex3fv(glm::value_ptr(v2.pos));
-            glVertex3fv(glm::value_ptr(v3.pos));
+                glVertex3fv(glm::value_ptr(v1.pos));
+                glVertex3fv(glm::value_ptr(v2.pos));
+                glVertex3fv(glm::value_ptr(v3.pos));
+            }
+            glEnd();
         }
-        glEnd();
     }
 
     if (mWireframe) {
@@ -510,7 +1186,7 @@ void DecimationMesh::Render() {
         float minCost = std::numeric_limits<float>::max();
         float maxCost = -std::numeric_limits<float>::max();
         for (auto iter = mEdges.begin(); iter != mEdges.end(); iter++) {
-            EdgeCollapse* collapse = mHalfEdge2EdgeCollapse.at(iter - mEdges.begin());
+            EdgeCollapse* collapse = getCollapse(iter - mEdges.begin());
             if (collapse != NULL) {
                 if (minCost > collapse->cost) minCost = collapse->cost;
                 if (maxCost < collapse->cost) maxCost = collapse->cost;
@@ -529,18 +1205,18 @@ void DecimationMesh::Render() {
         for (auto iter = mEdges.begin(); iter != mEdges.end(); iter++) {
             size_t ind = iter - mEdges.begin();
             if (!isEdgeCollapsed(ind)) {
-                const Vertex& v1 = v(e(ind).vert);
-                const Vertex& v2 = v(e(e(ind).pair).vert);
+                const glm::vec3& p1 = mVerts.pos[e(ind).vert];
+                const glm::vec3& p2 = mVerts.pos[e(e(ind).pair).vert];
 
-                EdgeCollapse* collapse = mHalfEdge2EdgeCollapse.at(ind);
+                EdgeCollapse* collapse = getCollapse(ind);
                 if (collapse == NULL) {
                     glColor3f(1, 1, 1);
                 } else {
                     glColor3fv(glm::value_ptr(mColorMap->Map(collapse->cost, minCost, maxCost)));
                 }
 
-                glVertex3fv(glm::value_ptr(v1.pos));
-                glVertex3fv(glm::value_ptr(v2.pos));
+                glVertex3fv(glm::value_ptr(p1));
+                glVertex3fv(glm::value_ptr(p2));
             }
         }
         glEnd();
@@ -553,11 +1229,14 @@ void DecimationMesh::Render() {
     glPopMatrix();
 
     GLObject::Render();
+#endif
 }
 
 void DecimationMesh::drawText(const glm::vec3& pos, const char* str) {
+#ifndef MOA_HEADLESS
     glRasterPos3f(pos[0], pos[1], pos[2]);
     for (size_t i = 0; str[i] != '\n'; i++) {
         glutBitmapCharacter(GLUT_BITMAP_HELVETICA_18, str[i]);
     }
+#endif
 }
@@ -3,7 +3,8 @@
 #include <Decimation/DecimationInterface.h>
 #include <Geometry/HalfEdgeMesh.h>
 #include <Util/ColorMap.h>
-#include <Util/Heap.h>
+#include <Util/IndexedHeap.h>
+#include <random>
 
 class DecimationMesh : public DecimationInterface, public HalfEdgeMesh {
 public:
@@ -14,23 +15,76 @@ public:
         return L;
     }
 
-    DecimationMesh() : mNumCollapsedVerts(0), mNumCollapsedEdges(0), mNumCollapsedFaces(0) {}
+    //! How decimate() picks the next edge to collapse
+    enum CollapseOrder {
+        //! Always the cheapest collapse, from a heap that is updated after every collapse
+        GreedyOrder,
+        //! The cheapest of a few randomly sampled collapses (multiple choice, Wu and Kobbelt).
+        //! Costs are recomputed when a sampled collapse is out of date, no heap is kept.
+        MultipleChoiceOrder,
+        //! Rounds of cheap collapses that do not overlap, applied on all hardware threads.
+        //! decimate() without a target still collapses one edge at a time.
+        IndependentSetOrder
+    };
+
+    DecimationMesh()
+        : mNumCollapsedVerts(0),
+          mNumCollapsedEdges(0),
+          mNumCollapsedFaces(0),
+          mCollapseOrder(GreedyOrder),
+          mNumChoices(8),
+          mVersion(0),
+          mRound(0),
+          mNumAppliedSplits(0) {}
     virtual ~DecimationMesh() {}
 
-    /*! The EdgeCollapse is a Heapable type */
-    struct EdgeCollapse : public Heap::Heapable {
+    /*! An edge collapse candidate, kept in mCollapses and ordered by cost in mHeap */
+    struct EdgeCollapse {
+        EdgeCollapse() : halfEdge(0), position(0.f, 0.f, 0.f), cost(0), version(0) {}
         size_t halfEdge;
         glm::vec3 position;
+        float cost;
+        //! Value of mVersion when the cost was computed
+        size_t version;
     };
 
+    /*! Selects greedy, multiple choice or independent set decimation, also after Initialize()
+     * \param[in] order the strategy used by decimate(), see CollapseOrder
+     * \param[in] numChoices number of collapses sampled per step in MultipleChoiceOrder
+     */
+    void SetCollapseOrder(CollapseOrder order, size_t numChoices = 8);
+    CollapseOrder GetCollapseOrder() const { return mCollapseOrder; }
+
     virtual void Initialize();
 
     virtual void Update();
 
+    //! Collapses one edge, or redoes the next recorded collapse if collapses were undone
     virtual bool decimate();
 
+    //! Moves through the recorded collapses first, see SetLevelOfDetail()
     virtual bool decimate(size_t targetFaces);
 
+    /*! Undoes or redoes recorded collapses until the mesh has at most numFaces faces, as
+     * close to it as the history allows. Only the collapses between the current and the
+     * new level are touched. Faces below the coarsest recorded level take a decimate().
+     */
+    void SetLevelOfDetail(size_t numFaces);
+    //! Number of collapses recorded since Initialize(), and how many of them are applied
+    size_t GetNumRecordedCollapses() const { return mSplits.size(); }
+    size_t GetNumAppliedCollapses() const { return mNumAppliedSplits; }
+    //! Heap operations since the heap was last built, none in MultipleChoiceOrder
+    const IndexedHeap<Index>::Counts& GetHeapCounts() const { return mHeap.counts(); }
+
+    /*! Removes the collapsed vertices, edges and faces from the arrays and renumbers the
+     * rest, so a decimated mesh costs as much as its remaining faces. Decimation can
+     * continue afterwards, but the recorded collapses are dropped.
+     */
+    void Compact();
+
+    //! Writes the elements that are not collapsed, renumbered as in Compact()
+    virtual bool SaveCache(std::ostream& os) override;
+
     virtual void Render() override;
 
     virtual const char* GetTypeName() { return typeid(DecimationMesh).name(); }
@@ -38,24 +92,125 @@ public:
 protected:
     virtual void updateVertexProperties(size_t ind);
 
+    //! Called when vertex 'from' is collapsed into vertex 'to', before the neighborhood is updated
+    virtual void mergeVertexProperties(size_t from, size_t to) {}
+
+    //! Called by Compact(), vertex kept[i] becomes vertex i
+    virtual void compactVertexProperties(const std::vector<Index>& kept) {}
+
+    /*! Called by Compact() when collapses were undone, the properties merged by
+     * mergeVertexProperties() then still belong to the coarsest recorded level
+     */
+    virtual void rebuildVertexProperties() {}
+
+    /*! The old index of each vertex, half edge and face that Compact() keeps, and the
+     * new index of each old one, or the maximum Index if it is removed
+     */
+    void mapLiveElements(std::vector<Index>& keptVerts, std::vector<Index>& keptEdges,
+                         std::vector<Index>& keptFaces, std::vector<Index>& vertMap,
+                         std::vector<Index>& edgeMap, std::vector<Index>& faceMap) const;
+
+    //! Copies the elements that Compact() keeps to new arrays, with renumbered links
+    void copyLiveElements(VertexArrays& verts, FaceArrays& faces,
+                          std::vector<HalfEdge>& edges) const;
+
+    //! Moves the elements at the ascending indices in 'kept' to the front and frees the rest
+    template <typename T>
+    static void compactArray(std::vector<T>& array, const std::vector<Index>& kept) {
+        for (size_t i = 0; i < kept.size(); i++) {
+            array[i] = array[kept[i]];
+        }
+        array.resize(kept.size());
+        array.shrink_to_fit();
+    }
+
     virtual void updateFaceProperties(size_t ind);
 
     virtual void computeCollapse(EdgeCollapse* collapse) = 0;
 
+    //! computeCollapse() for the collapses at the given indices, overridden to batch them
+    virtual void computeCollapses(const Index* indices, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            computeCollapse(&mCollapses[indices[i]]);
+        }
+    }
+
     virtual void Cleanup();
 
     bool isValidCollapse(EdgeCollapse* collapse);
 
-    inline bool isVertexCollapsed(size_t ind) { return mCollapsedVerts[ind]; }
-    inline bool isEdgeCollapsed(size_t ind) { return mCollapsedEdges[ind]; }
-    inline bool isFaceCollapsed(size_t ind) { return mCollapsedFaces[ind]; }
+    //! Collapses an edge and updates its neighborhood, false if the collapse is invalid
+    bool performCollapse(EdgeCollapse* collapse);
+
+    // The steps of performCollapse(), in order. collapseTopology() and updateNeighborhood()
+    // only write to the one-ring of the edge and read its two-ring, see claimNeighborhood().
+
+    //! Takes the collapses of the two edges that are merged into others out of the heap
+    void removeMergedCollapses(const EdgeCollapse* collapse);
+    //! Merges the first vertex of the half edge into the second and moves it into place
+    void collapseTopology(const EdgeCollapse* collapse);
+    //! The half edge links of collapseTopology(), without the collapse bookkeeping
+    void collapseConnectivity(size_t e1, const glm::vec3& position);
+    //! Flags the removed vertex v1 and the removed edges and faces around half edge e1
+    void markCollapsed(size_t e1, size_t v1);
+    //! Updates the properties and recomputes the valid collapses around v2
+    void updateNeighborhood(size_t v2);
+    //! Moves the collapses around v2 in the heap, and removes the invalid ones
+    void updateHeap(size_t v2);
+
+    /*! Performs one round of IndependentSetOrder
+     * \param[in] maxCollapses upper bound on the collapses of the round
+     * \return false if no collapse was performed
+     */
+    bool collapseIndependentSet(size_t maxCollapses);
+
+    //! Claims what a collapse reads and writes, false if it conflicts with the round so far
+    bool claimNeighborhood(const EdgeCollapse* collapse);
+
+    //! Adds a collapse to the history, before its topology changes
+    void recordCollapse(const EdgeCollapse* collapse);
+    //! Undoes the last applied collapse of the history
+    void splitVertex();
+    //! Redoes the next collapse of the history
+    void redoCollapse();
+    //! Adds a vertex to mMovedVerts once
+    void markMoved(size_t ind);
+    //! Recomputes the normals around the moved vertices once the history stops moving
+    void updateMovedProperties();
+
+    //! The cheapest of mNumChoices sampled collapses, or NULL if no candidates are left
+    EdgeCollapse* sampleCollapse();
+
+    //! Fills the heap or the candidate list for the current collapse order
+    void prepareCollapseOrder();
+
+    //! True if the half edge of a collapse still refers to it
+    inline bool isCollapseAlive(Index ind) {
+        return mHalfEdge2EdgeCollapse[mCollapses[ind].halfEdge] == ind;
+    }
+
+    //! True if an endpoint of the collapse changed after its cost was computed
+    inline bool isCollapseStale(const EdgeCollapse* collapse) {
+        const HalfEdge& edge = mEdges[collapse->halfEdge];
+        return mVertexVersions[edge.vert] > collapse->version ||
+               mVertexVersions[mEdges[edge.pair].vert] > collapse->version;
+    }
+
+    //! Collapsed faces are left out of the render buffers
+    virtual bool GetRenderFace(size_t faceIndex, glm::uvec3& tri) const override {
+        return !mCollapsedFaces[faceIndex] && HalfEdgeMesh::GetRenderFace(faceIndex, tri);
+    }
+
+    inline bool isVertexCollapsed(size_t ind) const { return mCollapsedVerts[ind]; }
+    inline bool isEdgeCollapsed(size_t ind) const { return mCollapsedEdges[ind]; }
+    inline bool isFaceCollapsed(size_t ind) const { return mCollapsedFaces[ind]; }
 
     inline void collapseVertex(size_t ind) {
         mCollapsedVerts[ind] = true;
         mNumCollapsedVerts++;
     }
     inline void collapseEdge(size_t ind) {
-        mHalfEdge2EdgeCollapse[ind] = NULL;
+        mHalfEdge2EdgeCollapse[ind] = NoCollapse;
         mCollapsedEdges[ind] = true;
         mNumCollapsedEdges++;
     }
@@ -64,6 +219,19 @@ protected:
         mNumCollapsedFaces++;
     }
 
+    inline void restoreVertex(size_t ind) {
+        mCollapsedVerts[ind] = false;
+        mNumCollapsedVerts--;
+    }
+    inline void restoreEdge(size_t ind) {
+        mCollapsedEdges[ind] = false;
+        mNumCollapsedEdges--;
+    }
+    inline void restoreFace(size_t ind) {
+        mCollapsedFaces[ind] = false;
+        mNumCollapsedFaces--;
+    }
+
     //! State array of 'active' verts
     std::vector<bool> mCollapsedVerts;
     //! State array of 'active' edges
@@ -78,32 +246,84 @@ protected:
     //! Number of collapsed faces
     size_t mNumCollapsedFaces;
 
-    //! Utility mapping between half edges and collapses
-    std::vector<EdgeCollapse*> mHalfEdge2EdgeCollapse;
+    //! Marks half edges without a collapse in mHalfEdge2EdgeCollapse
+    static constexpr Index NoCollapse = std::numeric_limits<Index>::max();
+
+    //! The collapse of a half edge, or NULL if it has none
+    inline EdgeCollapse* getCollapse(size_t halfEdge) {
+        const Index ind = mHalfEdge2EdgeCollapse[halfEdge];
+        return ind == NoCollapse ? NULL : &mCollapses[ind];
+    }
+
+    //! All edge collapses, one per initial half edge pair. Allocated once in Initialize(),
+    //! a collapse that is no longer needed is only taken out of the heap
+    std::vector<EdgeCollapse> mCollapses;
+
+    //! Utility mapping between half edges and indices into mCollapses
+    std::vector<Index> mHalfEdge2EdgeCollapse;
+
+    //! The heap that orders the edge collapses by cost
+    IndexedHeap<Index> mHeap;
+
+    CollapseOrder mCollapseOrder;
+    size_t mNumChoices;
+
+    //! The collapses sampled from in MultipleChoiceOrder. Collapses that were removed
+    //! are only dropped from the list when they are sampled.
+    std::vector<Index> mCandidates;
+    //! The collapses sampled in one step, reused between steps
+    std::vector<EdgeCollapse*> mSamples;
+    std::mt19937 mRandom;
+
+    //! Incremented by every collapse
+    size_t mVersion;
+    //! Value of mVersion when the properties of each vertex last changed
+    std::vector<size_t> mVertexVersions;
 
-    //! The heap that stores the edge collapses
-    Heap mHeap;
+    //! IndependentSetOrder examines at most the cheapest 1 / RoundDivisor of the heap per round
+    static constexpr size_t RoundDivisor = 16;
+    //! A round uses no more threads than it has blocks of this many collapses
+    static constexpr size_t MinParallelCollapses = 256;
+    //! Incremented by every round of IndependentSetOrder
+    size_t mRound;
+    //! Value of mRound when each vertex was last claimed by a collapse
+    std::vector<size_t> mVertexRounds;
+    //! The collapses of the current round and the vertex each of them removes
+    std::vector<Index> mSelected;
+    std::vector<size_t> mSelectedVerts;
+    //! Validity of the selected collapses, a char per collapse so threads can write it
+    std::vector<char> mSelectedValid;
+    //! Collapses of the current round that overlap a selected one
+    std::vector<Index> mDeferred;
+
+    /*! \brief One recorded collapse, the inverse is a vertex split (Hoppe)
+     *
+     * The removed edges, faces and vertex keep their links and positions, so the
+     * half edge and the edges that were moved from v1 to v2 are enough to undo it.
+     */
+    struct VertexSplit {
+        //! The collapsed half edge, from the removed vertex v1 to v2
+        Index halfEdge;
+        Index removedVertex;
+        //! The outgoing edges of v1 are mSplitEdges[firstEdge] up to the next split's
+        Index firstEdge;
+        //! The edges of v2 and of the opposite vertices v3 and v4 before the collapse
+        Index vertexEdges[3];
+        //! The position of v2 before and after the collapse
+        glm::vec3 oldPosition;
+        glm::vec3 newPosition;
+    };
+
+    //! The collapses since Initialize(), in the order they were applied
+    std::vector<VertexSplit> mSplits;
+    std::vector<Index> mSplitEdges;
+    //! The first mNumAppliedSplits collapses of mSplits are applied
+    size_t mNumAppliedSplits;
+    //! The vertices whose neighborhood changed while moving through the history
+    std::vector<Index> mMovedVerts;
 
     void drawText(const glm::vec3& pos, const char* str);
 
-    virtual bool save(std::ostream& os) {
-        os << "# DecimationMesh obj streamer\n# M&A 2008\n\n";
-        os << "# Vertices\n";
-        for (size_t i = 0; i < GetNumVerts(); i++) {
-            os << "v " << v(i).pos[0] << " " << v(i).pos[1] << " " << v(i).pos[2] << "\n";
-        }
-        os << "\n# Faces\n";
-        for (size_t i = 0; i < GetNumFaces(); i++) {
-            if (!isFaceCollapsed(i)) {
-                size_t ind = f(i).edge;
-                os << "f ";
-                os << e(ind).vert + 1 << " ";
-                ind = e(ind).next;
-                os << e(ind).vert + 1 << " ";
-                ind = e(ind).next;
-                os << e(ind).vert + 1 << "\n";
-            }
-        }
-        return os.good();
-    }
+    //! Writes the vertices and faces that are not collapsed, renumbered as in Compact()
+    virtual bool save(std::ostream& os);
 };
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <glm.hpp>
+
+/*! \brief Symmetric 4x4 error quadric stored as its 10 unique coefficients
+ *
+ * The quadric Q = [A b; b^T c] measures the sum of squared distances to a set
+ * of planes, v^T Q v with v = (x, y, z, 1). Only the upper triangle is stored,
+ * in the order a00 a01 a02 a03 a11 a12 a13 a22 a23 a33, which is 40 bytes
+ * instead of the 64 of a glm::mat4.
+ */
+class ErrorQuadric {
+public:
+    ErrorQuadric() {
+        for (float& q : mQ) {
+            q = 0.f;
+        }
+    }
+
+    //! The quadric of the plane ax + by + cz + d = 0, the outer product of the plane with itself
+    static ErrorQuadric FromPlane(const glm::vec4& plane) {
+        const float a = plane[0], b = plane[1], c = plane[2], d = plane[3];
+        ErrorQuadric K;
+        K.mQ[0] = a * a;
+        K.mQ[1] = a * b;
+        K.mQ[2] = a * c;
+        K.mQ[3] = a * d;
+        K.mQ[4] = b * b;
+        K.mQ[5] = b * c;
+        K.mQ[6] = b * d;
+        K.mQ[7] = c * c;
+        K.mQ[8] = c * d;
+        K.mQ[9] = d * d;
+        return K;
+    }
+
+    ErrorQuadric& operator+=(const ErrorQuadric& other) {
+        for (int i = 0; i < 10; i++) {
+            mQ[i] += other.mQ[i];
+        }
+        return *this;
+    }
+
+    ErrorQuadric operator+(const ErrorQuadric& other) const {
+        ErrorQuadric sum = *this;
+        sum += other;
+        return sum;
+    }
+
+    //! The error v^T Q v at the point p
+    float Evaluate(const glm::vec3& p) const {
+        const float x = p[0], y = p[1], z = p[2];
+        return x * (mQ[0] * x + 2.f * (mQ[1] * y + mQ[2] * z + mQ[3])) +
+               y * (mQ[4] * y + 2.f * (mQ[5] * z + mQ[6])) + z * (mQ[7] * z + 2.f * mQ[8]) +
+               mQ[9];
+    }
+
+    /*! Finds the point of minimal error by solving A p = -b. A is factorized as
+     * L D L^T in double precision, which needs no square roots and detects a
+     * singular A through the pivots in D.
+     * \param[out] p the optimal position, unchanged on failure
+     * \param[in] minPivot A is treated as singular if a pivot is below this
+     * fraction of its trace, e.g. for the planes of a flat or cylindrical region
+     * \return false if A is singular, then the caller has to pick a position
+     */
+    bool Minimize(glm::vec3& p, double minPivot = 1e-5) const {
+        const double a00 = mQ[0], a01 = mQ[1], a02 = mQ[2];
+        const double a11 = mQ[4], a12 = mQ[5], a22 = mQ[7];
+
+        // A is positive semidefinite, so a regular A has positive pivots. The tests are
+        // negated to also reject NaN from degenerate faces
+        const double tolerance = minPivot * (a00 + a11 + a22);
+        const double d0 = a00;
+        if (!(d0 > tolerance)) return false;
+        const double l10 = a01 / d0;
+        const double l20 = a02 / d0;
+
+        const double d1 = a11 - l10 * a01;
+        if (!(d1 > tolerance)) return false;
+        const double l21 = (a12 - l20 * a01) / d1;
+
+        const double d2 = a22 - l20 * a02 - l21 * l21 * d1;
+        if (!(d2 > tolerance)) return false;
+
+        // Forward substitution with L, scaling by D and back substitution with L^T
+        const double y0 = -mQ[3];
+        const double y1 = -mQ[6] - l10 * y0;
+        const double y2 = -mQ[8] - l20 * y0 - l21 * y1;
+
+        const double x2 = y2 / d2;
+        const double x1 = y1 / d1 - l21 * x2;
+        const double x0 = y0 / d0 - l10 * x1 - l20 * x2;
+
+        p = glm::vec3(x0, x1, x2);
+        return true;
+    }
+
+    //! The 10 stored coefficients, in the order above
+    const float* Coefficients() const { return mQ; }
+
+    //! The full symmetric matrix, for code that works with glm::mat4
+    glm::mat4 Matrix() const {
+        return glm::mat4(mQ[0], mQ[1], mQ[2], mQ[3], mQ[1], mQ[4], mQ[5], mQ[6], mQ[2], mQ[5],
+                         mQ[7], mQ[8], mQ[3], mQ[6], mQ[8], mQ[9]);
+    }
+
+protected:
+    float mQ[10];
+};
@@ -0,0 +1,190 @@
+#include <Decimation/QuadricBatch.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define QUADRIC_BATCH_SSE2
+#include <immintrin.h>
+#endif
+
+#ifdef QUADRIC_BATCH_SSE2
+namespace {
+
+// Four lanes of doubles, in one AVX register or two SSE2 registers. The solve runs in
+// double precision like ErrorQuadric::Minimize(), the rest in float.
+#ifdef __AVX__
+struct Double4 {
+    __m256d v;
+};
+inline Double4 ToDouble(__m128 a) { return {_mm256_cvtps_pd(a)}; }
+inline __m128 ToFloat(Double4 a) { return _mm256_cvtpd_ps(a.v); }
+inline Double4 Set(double a) { return {_mm256_set1_pd(a)}; }
+inline Double4 operator+(Double4 a, Double4 b) { return {_mm256_add_pd(a.v, b.v)}; }
+inline Double4 operator-(Double4 a, Double4 b) { return {_mm256_sub_pd(a.v, b.v)}; }
+inline Double4 operator*(Double4 a, Double4 b) { return {_mm256_mul_pd(a.v, b.v)}; }
+inline Double4 operator/(Double4 a, Double4 b) { return {_mm256_div_pd(a.v, b.v)}; }
+inline Double4 operator-(Double4 a) { return {_mm256_xor_pd(a.v, _mm256_set1_pd(-0.0))}; }
+//! All bits set in the float lanes where a > b, false for NaN
+inline __m128 Greater(Double4 a, Double4 b) {
+    const __m256d mask = _mm256_cmp_pd(a.v, b.v, _CMP_GT_OQ);
+    return _mm_shuffle_ps(_mm_castpd_ps(_mm256_castpd256_pd128(mask)),
+                          _mm_castpd_ps(_mm256_extractf128_pd(mask, 1)), _MM_SHUFFLE(2, 0, 2, 0));
+}
+#else
+struct Double4 {
+    __m128d lo, hi;
+};
+inline Double4 ToDouble(__m128 a) { return {_mm_cvtps_pd(a), _mm_cvtps_pd(_mm_movehl_ps(a, a))}; }
+inline __m128 ToFloat(Double4 a) { return _mm_movelh_ps(_mm_cvtpd_ps(a.lo), _mm_cvtpd_ps(a.hi)); }
+inline Double4 Set(double a) { return {_mm_set1_pd(a), _mm_set1_pd(a)}; }
+inline Double4 operator+(Double4 a, Double4 b) {
+    return {_mm_add_pd(a.lo, b.lo), _mm_add_pd(a.hi, b.hi)};
+}
+inline Double4 operator-(Double4 a, Double4 b) {
+    return {_mm_sub_pd(a.lo, b.lo), _mm_sub_pd(a.hi, b.hi)};
+}
+inline Double4 operator*(Double4 a, Double4 b) {
+    return {_mm_mul_pd(a.lo, b.lo), _mm_mul_pd(a.hi, b.hi)};
+}
+inline Double4 operator/(Double4 a, Double4 b) {
+    return {_mm_div_pd(a.lo, b.lo), _mm_div_pd(a.hi, b.hi)};
+}
+inline Double4 operator-(Double4 a) {
+    const __m128d sign = _mm_set1_pd(-0.0);
+    return {_mm_xor_pd(a.lo, sign), _mm_xor_pd(a.hi, sign)};
+}
+//! All bits set in the float lanes where a > b, false for NaN
+inline __m128 Greater(Double4 a, Double4 b) {
+    return _mm_shuffle_ps(_mm_castpd_ps(_mm_cmpgt_pd(a.lo, b.lo)),
+                          _mm_castpd_ps(_mm_cmpgt_pd(a.hi, b.hi)), _MM_SHUFFLE(2, 0, 2, 0));
+}
+#endif
+
+inline __m128 Select(__m128 mask, __m128 a, __m128 b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+//! Four points, one coordinate per register
+struct Points {
+    __m128 x, y, z;
+};
+
+//! ErrorQuadric::Evaluate() on four lanes, with the same order of operations
+inline __m128 Evaluate(const __m128 q[10], const Points& p) {
+    const __m128 two = _mm_set1_ps(2.f);
+    const __m128 tx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(q[1], p.y), _mm_mul_ps(q[2], p.z)), q[3]);
+    const __m128 ex = _mm_mul_ps(p.x, _mm_add_ps(_mm_mul_ps(q[0], p.x), _mm_mul_ps(two, tx)));
+    const __m128 ty = _mm_add_ps(_mm_mul_ps(q[5], p.z), q[6]);
+    const __m128 ey = _mm_mul_ps(p.y, _mm_add_ps(_mm_mul_ps(q[4], p.y), _mm_mul_ps(two, ty)));
+    const __m128 ez =
+        _mm_mul_ps(p.z, _mm_add_ps(_mm_mul_ps(q[7], p.z), _mm_mul_ps(two, q[8])));
+    return _mm_add_ps(_mm_add_ps(_mm_add_ps(ex, ey), ez), q[9]);
+}
+
+inline Points Select(__m128 mask, const Points& a, const Points& b) {
+    return {Select(mask, a.x, b.x), Select(mask, a.y, b.y), Select(mask, a.z, b.z)};
+}
+
+//! Loads the sum of the quadrics of two vertices, in the layout of ErrorQuadric
+inline void LoadSum(const ErrorQuadric& a, const ErrorQuadric& b, __m128 sum[3]) {
+    const float* qa = a.Coefficients();
+    const float* qb = b.Coefficients();
+    sum[0] = _mm_add_ps(_mm_loadu_ps(qa), _mm_loadu_ps(qb));
+    sum[1] = _mm_add_ps(_mm_loadu_ps(qa + 4), _mm_loadu_ps(qb + 4));
+    // Only two coefficients are left, a full load could read past the last quadric
+    sum[2] = _mm_add_ps(_mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64*>(qa + 8)),
+                        _mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64*>(qb + 8)));
+}
+
+//! MinimizeCollapses() for four collapses
+void MinimizeFour(const ErrorQuadric* quadrics, const glm::vec3* positions,
+                  const Mesh::Index* first, const Mesh::Index* second, glm::vec3* optimal,
+                  float* costs) {
+    // Sum the quadrics of each collapse, then transpose so that register k holds
+    // coefficient k of all four
+    __m128 sums[4][3];
+    for (int l = 0; l < 4; l++) {
+        LoadSum(quadrics[first[l]], quadrics[second[l]], sums[l]);
+    }
+    __m128 q[12];
+    for (int c = 0; c < 3; c++) {
+        __m128 r0 = sums[0][c], r1 = sums[1][c], r2 = sums[2][c], r3 = sums[3][c];
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        q[4 * c] = r0;
+        q[4 * c + 1] = r1;
+        q[4 * c + 2] = r2;
+        q[4 * c + 3] = r3;
+    }
+
+    const glm::vec3 &a0 = positions[first[0]], &a1 = positions[first[1]],
+                    &a2 = positions[first[2]], &a3 = positions[first[3]];
+    const glm::vec3 &b0 = positions[second[0]], &b1 = positions[second[1]],
+                    &b2 = positions[second[2]], &b3 = positions[second[3]];
+    const Points p1 = {_mm_setr_ps(a0[0], a1[0], a2[0], a3[0]),
+                       _mm_setr_ps(a0[1], a1[1], a2[1], a3[1]),
+                       _mm_setr_ps(a0[2], a1[2], a2[2], a3[2])};
+    const Points p2 = {_mm_setr_ps(b0[0], b1[0], b2[0], b3[0]),
+                       _mm_setr_ps(b0[1], b1[1], b2[1], b3[1]),
+                       _mm_setr_ps(b0[2], b1[2], b2[2], b3[2])};
+    const __m128 half = _mm_set1_ps(0.5f);
+    const Points mid = {_mm_mul_ps(_mm_add_ps(p1.x, p2.x), half),
+                        _mm_mul_ps(_mm_add_ps(p1.y, p2.y), half),
+                        _mm_mul_ps(_mm_add_ps(p1.z, p2.z), half)};
+
+    // ErrorQuadric::Minimize() in every lane, the pivot tests decide which lanes use it
+    const Double4 a00 = ToDouble(q[0]), a01 = ToDouble(q[1]), a02 = ToDouble(q[2]);
+    const Double4 a11 = ToDouble(q[4]), a12 = ToDouble(q[5]), a22 = ToDouble(q[7]);
+    const Double4 tolerance = Set(1e-5) * (a00 + a11 + a22);
+    const Double4 d0 = a00;
+    const Double4 l10 = a01 / d0;
+    const Double4 l20 = a02 / d0;
+    const Double4 d1 = a11 - l10 * a01;
+    const Double4 l21 = (a12 - l20 * a01) / d1;
+    const Double4 d2 = a22 - l20 * a02 - l21 * l21 * d1;
+    const __m128 solved = _mm_and_ps(_mm_and_ps(Greater(d0, tolerance), Greater(d1, tolerance)),
+                                     Greater(d2, tolerance));
+
+    const Double4 y0 = -ToDouble(q[3]);
+    const Double4 y1 = -ToDouble(q[6]) - l10 * y0;
+    const Double4 y2 = -ToDouble(q[8]) - l20 * y0 - l21 * y1;
+    const Double4 x2 = y2 / d2;
+    const Double4 x1 = y1 / d1 - l21 * x2;
+    const Double4 x0 = y0 / d0 - l10 * x1 - l20 * x2;
+    const Points minimum = {ToFloat(x0), ToFloat(x1), ToFloat(x2)};
+
+    // The cheapest of the endpoints and the midpoint where A is singular
+    Points cheapest = mid;
+    __m128 smallest = _mm_set1_ps(std::numeric_limits<float>::infinity());
+    for (const Points* candidate : {&p1, &p2, &mid}) {
+        const __m128 error = Evaluate(q, *candidate);
+        const __m128 less = _mm_cmplt_ps(error, smallest);
+        smallest = Select(less, error, smallest);
+        cheapest = Select(less, *candidate, cheapest);
+    }
+
+    const Points position = Select(solved, minimum, cheapest);
+    alignas(16) float x[4], y[4], z[4];
+    _mm_store_ps(x, position.x);
+    _mm_store_ps(y, position.y);
+    _mm_store_ps(z, position.z);
+    _mm_storeu_ps(costs, Evaluate(q, position));
+    for (int l = 0; l < 4; l++) {
+        optimal[l] = glm::vec3(x[l], y[l], z[l]);
+    }
+}
+
+}  // namespace
+#endif
+
+void MinimizeCollapses(const ErrorQuadric* quadrics, const glm::vec3* positions,
+                       const Mesh::Index* first, const Mesh::Index* second, size_t count,
+                       glm::vec3* optimal, float* costs) {
+    size_t i = 0;
+#ifdef QUADRIC_BATCH_SSE2
+    for (; i + 4 <= count; i += 4) {
+        MinimizeFour(quadrics, positions, first + i, second + i, optimal + i, costs + i);
+    }
+#endif
+    for (; i < count; i++) {
+        const ErrorQuadric Q = quadrics[first[i]] + quadrics[second[i]];
+        costs[i] = MinimizeCollapse(Q, positions[first[i]], positions[second[i]], optimal[i]);
+    }
+}
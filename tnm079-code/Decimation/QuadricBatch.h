@@ -0,0 +1,45 @@
+#pragma once
+
+#include <Decimation/ErrorQuadric.h>
+#include <Geometry/Mesh.h>
+#include <limits>
+
+/*! Finds the position and cost of collapsing the edge between p1 and p2 under the
+ * quadric Q of both endpoints. The position minimizes Q if it can, otherwise it is the
+ * cheapest of p1, p2 and their midpoint.
+ * \param[out] position the new vertex position
+ * \return the cost at position
+ */
+inline float MinimizeCollapse(const ErrorQuadric& Q, const glm::vec3& p1, const glm::vec3& p2,
+                              glm::vec3& position) {
+    position = (p1 + p2) * 0.5f;
+    if (!Q.Minimize(position)) {
+        const glm::vec3 mid = position;
+        float smallest = std::numeric_limits<float>::infinity();
+        for (const glm::vec3& candidate : {p1, p2, mid}) {
+            const float error = Q.Evaluate(candidate);
+            if (error < smallest) {
+                smallest = error;
+                position = candidate;
+            }
+        }
+    }
+    return Q.Evaluate(position);
+}
+
+/*! \brief MinimizeCollapse() for many edges at once
+ *
+ * Collapse i merges vertex first[i] into second[i], under the sum of their quadrics.
+ * Four collapses are evaluated together with SSE2, or AVX when the compiler targets
+ * it. The results are the same as MinimizeCollapse() to the bit, so the collapse order
+ * does not depend on the instruction set. That needs the compiler to not fuse multiplies
+ * and adds, which it does not unless FMA is targeted (e.g. -march=native). Other
+ * processors use MinimizeCollapse().
+ * \param[in] quadrics the quadric of each vertex
+ * \param[in] positions the position of each vertex
+ * \param[out] optimal the new vertex position of each collapse
+ * \param[out] costs the cost of each collapse
+ */
+void MinimizeCollapses(const ErrorQuadric* quadrics, const glm::vec3* positions,
+                       const Mesh::Index* first, const Mesh::Index* second, size_t count,
+                       glm::vec3* optimal, float* costs);
@@ -1,4 +1,8 @@
 #include "QuadricDecimationMesh.h"
+#include "Decimation/QuadricBatch.h"
+#include "Util/Parallel.h"
+#include <algorithm>
+#include <cmath>
 
 const QuadricDecimationMesh::VisualizationMode QuadricDecimationMesh::QuadricIsoSurfaces =
     NewVisualizationMode("Quadric Iso Surfaces");
@@ -7,7 +11,6 @@ void QuadricDecimationMesh::Initialize() {
     // Allocate memory for the quadric array
     size_t numVerts = mVerts.size();
     mQuadrics.reserve(numVerts);
-    std::streamsize width = std::cerr.precision();  // store stream precision
     for (size_t i = 0; i < numVerts; i++) {
 
         // Algrotihm steps
@@ -16,18 +19,7 @@ void QuadricDecimationMesh::Initialize() {
 
         // Compute quadric for vertex i here
         mQuadrics.push_back(createQuadricForVert(i));
-
-        // Calculate initial error, should be numerically close to 0
-
-        glm::vec3 v0 = mVerts[i].pos;
-        glm::vec4 v(v0[0], v0[1], v0[2], 1);
-        glm::mat4 m = mQuadrics.back();
-
-        // TODO CHECK
-        float error = glm::dot(v, (m * v));
-        //std::cerr << std::scientific << std::setprecision(2) << error << " ";
     }
-    std::cerr << std::setprecision(width) << std::fixed;  // reset stream precision
 
     // Run the initialize for the parent class to initialize the edge collapses
     DecimationMesh::Initialize();
@@ -49,68 +41,75 @@ void QuadricDecimationMesh::computeCollapse(EdgeCollapse* collapse) {
 
     // 3. Compute the optimal contraction target v_bar for each valid pair (v1, v2). The error
     //     v_bar_t * (Q1 + Q2) * v_bar of the target becomes the *cost* of contracting that pair
-    glm::mat4 Q = mQuadrics[v1] + mQuadrics[v2]; // Q1 + Q2
-
-    glm::mat4 Q_bar = Q;
-
-    // Q_bar, found in section 4 of Surface Simplification Using Quadric Error Metrics
-    Q_bar[0][3] = 0.0f;
-    Q_bar[1][3] = 0.0f;
-    Q_bar[2][3] = 0.0f;
-    Q_bar[3][3] = 1.0f;
-
-
-    glm::vec4 v_bar;
+    const ErrorQuadric Q = mQuadrics[v1] + mQuadrics[v2]; // Q1 + Q2
 
-    // Needs to check if Q_bar is invertible with det(Q_bar) != 0
-    if (abs(glm::determinant(Q_bar)) > 0.0000000001f) {
+    // Solve for the minimum of Q_bar, found in section 4 of Surface Simplification Using
+    // Quadric Error Metrics. Where the upper 3x3 block of Q is singular the cheapest of
+    // v1, v2 and their midpoint is taken instead
+    glm::vec3 v_bar;
+    const float cost = MinimizeCollapse(Q, v(v1).pos, v(v2).pos, v_bar);
 
-        v_bar = glm::inverse(Q_bar) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f); // Q_bar is invertible
-
-    } else{ // Q_bar is not invertible
-        // Extract both vertex positions, and a midpoint between them
-        glm::vec4 pos_v1 = glm::vec4(v(v1).pos, 1.0f);
-        glm::vec4 pos_v2 = glm::vec4(v(v2).pos, 1.0f);
-        glm::vec4 pos_mid = ((pos_v1 + pos_v2) * 0.5f);
-
-        // Construct a list of canditades for the smallest errors, will be looped through with range based loop
-        std::vector<glm::vec4> candidates{pos_v1, pos_v2, pos_mid};
+    // 4. Place all the pairs in a heap keyed on cost with the minimum cost pair at the top
+    collapse->position = v_bar;  // Set the target position for this collapse
+    collapse->cost = cost;
 
-        // Calculate smallest error
-        float smallest = std::numeric_limits<float>::infinity(); // Positive infinity, so the first value will be the smallest
+    //std::cerr << "computeCollapse in QuadricDecimationMesh not implemented.\n";
+}
 
-        for (const auto& candidate : candidates) {
-            float error = glm::dot(candidate, Q * candidate); // Calculate error 
-            if (error < smallest) {
-                smallest = error;
-                v_bar = candidate;
-            }
+/*! Gathers the endpoints of the collapses and evaluates them with MinimizeCollapses() */
+void QuadricDecimationMesh::computeCollapses(const Index* indices, size_t count) {
+    const size_t chunkSize = 64;
+    Index first[chunkSize], second[chunkSize];
+    glm::vec3 optimal[chunkSize];
+    float costs[chunkSize];
+    for (size_t start = 0; start < count; start += chunkSize) {
+        const size_t n = std::min(chunkSize, count - start);
+        for (size_t i = 0; i < n; i++) {
+            const size_t e1 = mCollapses[indices[start + i]].halfEdge;
+            first[i] = mEdges[e1].vert;
+            second[i] = mEdges[mEdges[e1].pair].vert;
+        }
+        MinimizeCollapses(mQuadrics.data(), mVerts.pos.data(), first, second, n, optimal, costs);
+        for (size_t i = 0; i < n; i++) {
+            EdgeCollapse& collapse = mCollapses[indices[start + i]];
+            collapse.position = optimal[i];
+            collapse.cost = costs[i];
         }
     }
-    // 4. Place all the pairs in a heap keyed on cost with the minimum cost pair at the top
-    collapse->position = glm::vec3(v_bar.x, v_bar.y, v_bar.z);  // Set the target position for this collapse
-    collapse->cost = glm::dot(v_bar, Q * v_bar);
-
-    //std::cerr << "computeCollapse in QuadricDecimationMesh not implemented.\n";
 }
 
 /*! After each edge collapse the vertex properties need to be updated */
 void QuadricDecimationMesh::updateVertexProperties(size_t ind) {
     DecimationMesh::updateVertexProperties(ind);
-    mQuadrics[ind] = createQuadricForVert(ind);
+    if (mQuadricUpdate == RecomputeQuadrics) {
+        mQuadrics[ind] = createQuadricForVert(ind);
+    }
+}
+
+/*! Q(to) += Q(from), the remaining vertex inherits the planes of the removed one */
+void QuadricDecimationMesh::mergeVertexProperties(size_t from, size_t to) {
+    if (mQuadricUpdate == AccumulateQuadrics) {
+        mQuadrics[to] += mQuadrics[from];
+    }
+}
+
+/*! The accumulated quadrics of the coarsest level count the planes of restored vertices
+ * twice, and the recomputed ones were computed from its faces
+ */
+void QuadricDecimationMesh::rebuildVertexProperties() {
+    ParallelFor(mVerts.size(), [&](size_t i) { mQuadrics[i] = createQuadricForVert(i); }, 256);
 }
 
 /*!
  * \param[in] indx vertex index, points into HalfEdgeMesh::mVerts
  */
-glm::mat4 QuadricDecimationMesh::createQuadricForVert(size_t indx) const {
-    glm::mat4 Q({0.0f, 0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 0.0f, 0.0f},
-                {0.0f, 0.0f, 0.0f, 0.0f});
+ErrorQuadric QuadricDecimationMesh::createQuadricForVert(size_t indx) const {
+    ErrorQuadric Q;
 
     // The quadric for a vertex is the sum of all the quadrics for the adjacent
-    // faces Tip: Matrix4x4 has an operator +=
+    // faces Tip: ErrorQuadric has an operator +=
 
-    for (size_t faceIndx : FindNeighborFaces(indx)) {;
+    for (Index faceIndx : NeighborFaces(indx)) {
         Q += createQuadricForFace(faceIndx);
     }
 
@@ -120,7 +119,7 @@ glm::mat4 QuadricDecimationMesh::createQuadricForVert(size_t indx) const {
 /*!
  * \param[in] indx face index, points into HalfEdgeMesh::mFaces
  */
-glm::mat4 QuadricDecimationMesh::createQuadricForFace(size_t indx) const {
+ErrorQuadric QuadricDecimationMesh::createQuadricForFace(size_t indx) const {
 
     // Calculate the quadric (outer product of plane parameters) for a face
     // here using the formula from Garland and Heckbert
@@ -136,6 +135,10 @@ glm::mat4 QuadricDecimationMesh::createQuadricForFace(size_t indx) const {
     // take the planes that meet at the vertex
     // planets ekvation
     glm::vec3 plane = f(indx).normal;
+    // A face that collapsed to a line or a point has no plane (and a NaN normal)
+    if (!std::isfinite(plane[0] + plane[1] + plane[2])) {
+        return ErrorQuadric();
+    }
     a = plane[0];
     b = plane[1];
     c = plane[2];
@@ -145,11 +148,7 @@ glm::mat4 QuadricDecimationMesh::createQuadricForFace(size_t indx) const {
 
     d = -glm::dot(plane, vert);
     // Kpi
-    glm::mat4 K({a * a, a * b, a * c, a * d},
-                       {a * b, b * b, b * c, b * d},
-                       {c * a, c * b, c * c, c * d},
-                       {a * d, b * d, c * d, d * d});
-    return K;
+    return ErrorQuadric::FromPlane(glm::vec4(a, b, c, d));
     /*
     glm::vec3 v1 = v(indx).pos; // Vertex v1, extracted from edge e1
     //std::cerr << "Vertex positiom { " << v1.x << ",  " << v1.y << ",  " << v1.z << " }";
@@ -165,6 +164,7 @@ glm::mat4 QuadricDecimationMesh::createQuadricForFace(size_t indx) const {
 }
 
 void QuadricDecimationMesh::Render() {
+#ifndef MOA_HEADLESS
     DecimationMesh::Render();
 
     glEnable(GL_LIGHTING);
@@ -180,4 +180,5 @@ void QuadricDecimationMesh::Render() {
         // Restore modelview matrix
         glPopMatrix();
     }
+#endif
 }
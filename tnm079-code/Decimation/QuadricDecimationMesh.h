@@ -1,14 +1,9 @@
 #pragma once
 
 #include "Decimation/DecimationMesh.h"
+#include "Decimation/ErrorQuadric.h"
 #include <iomanip>
 
-#ifdef __APPLE__
-#include "GLUT/glut.h"
-#else
-#include "GL/glut.h"
-#endif
-
 class QuadricDecimationMesh : public virtual DecimationMesh {
 public:
     static const VisualizationMode QuadricIsoSurfaces;
@@ -19,24 +14,47 @@ public:
         return L;
     }
 
-    QuadricDecimationMesh() {}
+    /*! How the quadric of the remaining vertex is found after a collapse */
+    enum QuadricUpdate {
+        //! Rebuild the quadrics around the vertex from the current, decimated faces
+        RecomputeQuadrics,
+        //! Add the quadric of the removed vertex (Garland and Heckbert). The error then
+        //! stays measured against the planes of the original surface, and no faces are visited
+        AccumulateQuadrics
+    };
+
+    QuadricDecimationMesh() : mQuadricUpdate(RecomputeQuadrics) {}
     virtual ~QuadricDecimationMesh() {}
 
+    void SetQuadricUpdate(QuadricUpdate update) { mQuadricUpdate = update; }
+    QuadricUpdate GetQuadricUpdate() const { return mQuadricUpdate; }
+
     //! Initialize member data (error quadrics)
     virtual void Initialize();
 
 protected:
     //! Compute the cost and new position for an edge collapse
     virtual void computeCollapse(EdgeCollapse* collapse);
+    //! Computes many collapses at once with the vectorized MinimizeCollapses()
+    virtual void computeCollapses(const Index* indices, size_t count);
     //! Update vertex properties. Used after an edge collapse
     virtual void updateVertexProperties(size_t ind);
+    //! Merges the quadrics of a collapsed edge in AccumulateQuadrics mode
+    virtual void mergeVertexProperties(size_t from, size_t to);
+    //! Keeps the quadrics of the remaining vertices
+    virtual void compactVertexProperties(const std::vector<Index>& kept) {
+        compactArray(mQuadrics, kept);
+    }
+    //! Rebuilds the quadrics from the faces of the current level
+    virtual void rebuildVertexProperties();
     //! Compute the quadric for a vertex
-    glm::mat4 createQuadricForVert(size_t indx) const;
+    ErrorQuadric createQuadricForVert(size_t indx) const;
     //! Copmute the quadric for a face
-    glm::mat4 createQuadricForFace(size_t indx) const;
+    ErrorQuadric createQuadricForFace(size_t indx) const;
     //! Render (redefined)
     virtual void Render();
 
     //! The quadrics used in the decimation
-    std::vector<glm::mat4> mQuadrics;
+    std::vector<ErrorQuadric> mQuadrics;
+    QuadricUpdate mQuadricUpdate;
 };
@@ -19,7 +19,7 @@ void SimpleDecimationMesh::computeCollapse(EdgeCollapse* collapse) {
     // position halfway along the edge. The cost is computed as
     // the vertex-to-vertex distance between the new vertex
     // and the old vertices at the edge's endpoints
-    const glm::vec3& v0 = mVerts[mEdges[collapse->halfEdge].vert].pos;
+    const glm::vec3& v0 = mVerts.pos[mEdges[collapse->halfEdge].vert];
     const glm::vec3& v1 = mVerts[mEdges[mEdges[collapse->halfEdge].pair].vert].pos;
 
     collapse->position = 0.5f * (v0 + v1);
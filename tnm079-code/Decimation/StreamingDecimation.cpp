@@ -0,0 +1,236 @@
+#include <Decimation/StreamingDecimation.h>
+#include <Util/ObjIO.h>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+namespace {
+
+//! Bits per axis in a packed grid coordinate, and per cell index in a triangle key
+const unsigned int KeyBits = 21;
+
+//! Packs three values below 2^21 into a 64 bit key
+inline uint64_t PackKey(uint64_t a, uint64_t b, uint64_t c) {
+    return (a << (2 * KeyBits)) | (b << KeyBits) | c;
+}
+
+}  // namespace
+
+StreamingDecimation::StreamingDecimation()
+    : mMemoryBudget(size_t(256) << 20),
+      mGridResolution(0),
+      mBlockSize(size_t(4) << 20),
+      mMin(0.f),
+      mMax(0.f),
+      mNumInputFaces(0),
+      mCellSize(1.f),
+      mResolution(0),
+      mNumOutputVerts(0),
+      mPeakMemory(0) {}
+
+bool StreamingDecimation::Decimate(const std::string& input, const std::string& output) {
+    mPeakMemory = 0;
+    mNumOutputVerts = 0;
+    if (!readPositions(input)) {
+        return false;
+    }
+
+    // A cell needs its own storage, a hash slot, and on a closed surface about two
+    // triangles with their hash slots. The hash tables are at least half empty.
+    const size_t slot = 2 * (sizeof(uint64_t) + sizeof(uint32_t));
+    const size_t bytesPerCell = sizeof(Cell) + 2 * slot + 2 * (sizeof(glm::uvec3) + 2 * slot);
+    const size_t fixed = usedMemory() + 2 * mBlockSize;
+    if (fixed >= mMemoryBudget) {
+        std::cerr << "Error: the " << mPositions.size() << " input vertices need more than the "
+                  << mMemoryBudget << " byte budget" << std::endl;
+        return false;
+    }
+    const size_t maxCells = std::min((mMemoryBudget - fixed) / bytesPerCell, MaxCells);
+
+    // A surface occupies roughly resolution^2 cells of a grid, a few times that for
+    // rough or folded ones. Too fine a grid is retried coarser.
+    size_t resolution = mGridResolution;
+    if (resolution == 0) {
+        resolution = static_cast<size_t>(std::sqrt(maxCells / 4.0));
+    }
+    resolution = std::min<size_t>(resolution, (size_t(1) << KeyBits) - 1);
+
+    bool fits = false;
+    while (!fits) {
+        if (resolution < 1) {
+            std::cerr << "Error: no grid fits in the " << mMemoryBudget << " byte budget"
+                      << std::endl;
+            return false;
+        }
+        if (!cluster(input, resolution, fits)) {
+            return false;
+        }
+        if (!fits) {
+            std::cout << "Grid of " << resolution << " cells does not fit, retrying" << std::endl;
+            resolution = resolution * 3 / 4;
+        }
+    }
+
+    std::cout << "Clustered " << mNumInputFaces << " faces to " << mTris.size() << " on a grid of "
+              << mResolution << " cells, peak memory " << (mPeakMemory >> 20) << " MB"
+              << std::endl;
+    return write(output);
+}
+
+bool StreamingDecimation::readPositions(const std::string& input) {
+    std::vector<glm::vec3>().swap(mPositions);
+    mMin = glm::vec3(std::numeric_limits<float>::max());
+    mMax = glm::vec3(-std::numeric_limits<float>::max());
+    mNumInputFaces = 0;
+
+    auto addBlock = [&](const std::vector<glm::vec3>& verts, const std::vector<glm::uvec3>& tris) {
+        for (const glm::vec3& v : verts) {
+            mMin = glm::min(mMin, v);
+            mMax = glm::max(mMax, v);
+        }
+        mPositions.insert(mPositions.end(), verts.begin(), verts.end());
+        mNumInputFaces += tris.size();
+        return usedMemory() <= mMemoryBudget;
+    };
+
+    ObjIO io;
+    if (!io.Stream(input, mBlockSize, addBlock)) {
+        std::cerr << "Error: could not read '" << input << "' within the budget" << std::endl;
+        return false;
+    }
+    mPositions.shrink_to_fit();
+    return true;
+}
+
+bool StreamingDecimation::cluster(const std::string& input, size_t resolution, bool& fits) {
+    mResolution = resolution;
+    const glm::vec3 extent = mMax - mMin;
+    const float longest = std::max(std::max(extent[0], extent[1]), extent[2]);
+    mCellSize = longest > 0.f ? longest / resolution : 1.f;
+
+    std::vector<Cell>().swap(mCells);
+    mCellMap.clear();
+    std::vector<glm::uvec3>().swap(mTris);
+    mTriSet.clear();
+
+    fits = true;
+    auto addBlock = [&](const std::vector<glm::vec3>& verts, const std::vector<glm::uvec3>& tris) {
+        for (const glm::uvec3& tri : tris) {
+            if (tri[0] >= mPositions.size() || tri[1] >= mPositions.size() ||
+                tri[2] >= mPositions.size()) {
+                std::cerr << "Error: face refers to a missing vertex" << std::endl;
+                return false;
+            }
+            const glm::vec3& p0 = mPositions[tri[0]];
+            const glm::vec3& p1 = mPositions[tri[1]];
+            const glm::vec3& p2 = mPositions[tri[2]];
+            const uint32_t cells[3] = {findCell(p0), findCell(p1), findCell(p2)};
+            if (mCells.size() >= MaxCells) {
+                fits = false;
+                return false;
+            }
+
+            // Weighted by area, so that many small faces do not outweigh a large one
+            const glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+            const float length = glm::length(normal);
+            if (length > 0.f && std::isfinite(length)) {
+                const glm::vec3 n = normal / std::sqrt(length);
+                const ErrorQuadric Q = ErrorQuadric::FromPlane(glm::vec4(n, -glm::dot(n, p0)));
+                for (uint32_t cell : cells) {
+                    mCells[cell].quadric += Q;
+                }
+            }
+
+            if (cells[0] == cells[1] || cells[1] == cells[2] || cells[0] == cells[2]) {
+                continue;
+            }
+            // Many faces give the same triangle. Its key starts at the smallest index and
+            // keeps the orientation.
+            const int first = cells[0] < cells[1] ? (cells[0] < cells[2] ? 0 : 2)
+                                                  : (cells[1] < cells[2] ? 1 : 2);
+            const glm::uvec3 out(cells[first], cells[(first + 1) % 3], cells[(first + 2) % 3]);
+            if (mTriSet.insert(PackKey(out[0], out[1], out[2]), 0).second) {
+                mTris.push_back(out);
+            }
+        }
+
+        fits = usedMemory() <= mMemoryBudget;
+        return fits;
+    };
+
+    ObjIO io;
+    return io.Stream(input, mBlockSize, addBlock) || !fits;
+}
+
+uint32_t StreamingDecimation::findCell(const glm::vec3& p) {
+    const glm::vec3 grid = (p - mMin) / mCellSize;
+    uint64_t coords[3];
+    for (int i = 0; i < 3; i++) {
+        coords[i] = std::min<uint64_t>(static_cast<uint64_t>(std::max(grid[i], 0.f)), mResolution);
+    }
+
+    const std::pair<uint32_t*, bool> slot = mCellMap.insert(
+        PackKey(coords[0], coords[1], coords[2]), static_cast<uint32_t>(mCells.size()));
+    if (slot.second) {
+        mCells.push_back(Cell());
+    }
+    Cell& cell = mCells[*slot.first];
+    cell.sum += p;
+    cell.count++;
+    return *slot.first;
+}
+
+size_t StreamingDecimation::usedMemory() {
+    const size_t used = mPositions.capacity() * sizeof(glm::vec3) +
+                        mCells.capacity() * sizeof(Cell) + mCellMap.memory() +
+                        mTris.capacity() * sizeof(glm::uvec3) + mTriSet.memory();
+    mPeakMemory = std::max(mPeakMemory, used);
+    return used;
+}
+
+bool StreamingDecimation::write(const std::string& output) {
+    std::ofstream os(output.c_str());
+    if (!os) {
+        std::cerr << "Error: could not write '" << output << "'" << std::endl;
+        return false;
+    }
+
+    // Cells that only degenerate faces reached are left out, the rest keep their order
+    const uint32_t unused = std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> index(mCells.size(), unused);
+    for (const glm::uvec3& tri : mTris) {
+        index[tri[0]] = index[tri[1]] = index[tri[2]] = 0;
+    }
+    mNumOutputVerts = 0;
+    for (uint32_t& ind : index) {
+        if (ind != unused) {
+            ind = static_cast<uint32_t>(mNumOutputVerts++);
+        }
+    }
+
+    ObjWriter writer(os);
+    writer.Comment("StreamingDecimation obj streamer");
+    for (size_t i = 0; i < mCells.size(); i++) {
+        if (index[i] == unused) {
+            continue;
+        }
+        // A flat cell has no unique minimum, and a nearly singular one may put the
+        // minimum far away. Both fall back to the mean of the cell's vertices.
+        const Cell& cell = mCells[i];
+        const glm::vec3 mean = cell.sum / static_cast<float>(std::max<uint32_t>(cell.count, 1));
+        glm::vec3 pos = mean;
+        if (cell.quadric.Minimize(pos)) {
+            const glm::vec3 offset = glm::abs(pos - mean);
+            if (std::max(std::max(offset[0], offset[1]), offset[2]) > mCellSize) {
+                pos = mean;
+            }
+        }
+        writer.AddVertex(pos);
+    }
+    for (const glm::uvec3& tri : mTris) {
+        writer.AddFace(index[tri[0]], index[tri[1]], index[tri[2]]);
+    }
+    return writer.Flush();
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <Decimation/ErrorQuadric.h>
+#include <Util/HashMap.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm.hpp>
+
+/*! \brief Out-of-core simplification of OBJ files by vertex clustering
+ *
+ * Follows Lindstrom's out-of-core simplification. The file is streamed once
+ * for the vertex positions and once for the faces. Every vertex falls in a
+ * cell of a uniform grid. The quadrics of the faces are summed per cell, and
+ * only the faces with corners in three different cells are kept. Each cell
+ * becomes one output vertex, placed at the minimum of its quadric. The input
+ * triangles are never held in memory, and no half edge mesh is built.
+ *
+ * Memory holds the input positions (faces may refer to any earlier vertex),
+ * the occupied cells and the output triangles. The grid resolution is chosen
+ * to fit the budget. If the occupied cells turn out not to fit, the faces are
+ * streamed again on a coarser grid.
+ */
+class StreamingDecimation {
+public:
+    StreamingDecimation();
+
+    //! Bytes the simplification may use, 256 MB by default
+    void SetMemoryBudget(size_t bytes) { mMemoryBudget = bytes; }
+    //! Cells along the longest side of the bounding box, 0 (default) fits them to the budget
+    void SetGridResolution(size_t cells) { mGridResolution = cells; }
+    //! Bytes of the file parsed at a time, 4 MB by default
+    void SetBlockSize(size_t bytes) { mBlockSize = bytes; }
+
+    /*! Simplifies the OBJ file input and writes the result to the OBJ file output
+     * \return false if a file can not be read or written, or if the budget is too small
+     */
+    bool Decimate(const std::string& input, const std::string& output);
+
+    size_t GetNumInputVerts() const { return mPositions.size(); }
+    size_t GetNumInputFaces() const { return mNumInputFaces; }
+    size_t GetNumOutputVerts() const { return mNumOutputVerts; }
+    size_t GetNumOutputFaces() const { return mTris.size(); }
+    //! The grid resolution of the last Decimate()
+    size_t GetGridResolution() const { return mResolution; }
+    //! The most memory held by the containers during the last Decimate()
+    size_t GetPeakMemory() const { return mPeakMemory; }
+
+protected:
+    //! The cell indices of a triangle key take 21 bits each
+    static constexpr size_t MaxCells = size_t(1) << 21;
+
+    struct Cell {
+        Cell() : sum(0.f), count(0) {}
+        ErrorQuadric quadric;
+        //! The face corners in the cell, for their mean when the quadric has no minimum
+        glm::vec3 sum;
+        uint32_t count;
+    };
+
+    //! Reads the positions and their bounding box
+    bool readPositions(const std::string& input);
+    /*! Clusters the faces on a grid of the given resolution
+     * \return false on read errors, or with fits = false if the cells exceed the budget
+     */
+    bool cluster(const std::string& input, size_t resolution, bool& fits);
+    //! Places the cells that the triangles use and writes them and the triangles
+    bool write(const std::string& output);
+
+    //! Adds a cell for the grid cell of p if it has none, and returns its index
+    uint32_t findCell(const glm::vec3& p);
+    //! The memory held by the containers, and updates the peak
+    size_t usedMemory();
+
+    size_t mMemoryBudget;
+    size_t mGridResolution;
+    size_t mBlockSize;
+
+    std::vector<glm::vec3> mPositions;
+    glm::vec3 mMin, mMax;
+    size_t mNumInputFaces;
+
+    //! Grid cell size and the resolution actually used
+    float mCellSize;
+    size_t mResolution;
+
+    //! The occupied cells, and the cell of each packed grid coordinate
+    std::vector<Cell> mCells;
+    HashMap<uint32_t> mCellMap;
+    //! The output triangles, and the packed cell triples already in mTris
+    std::vector<glm::uvec3> mTris;
+    HashMap<char> mTriSet;
+    //! The cells written by the last Decimate()
+    size_t mNumOutputVerts;
+
+    size_t mPeakMemory;
+};
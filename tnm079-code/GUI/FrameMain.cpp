@@ -329,11 +329,16 @@ void FrameMain::SaveMesh(wxCommandEvent& event) {
                 this,
                 _T("Save mesh '") + wxString(mesh->GetName().c_str(), wxConvUTF8) + _T("' as"),
                 _T("."), wxString(mesh->GetName().c_str(), wxConvUTF8) + _T(".obj"),
-                _T("OBJ (*.obj)|*.obj"), wxFD_SAVE, wxDefaultPosition);
+                _T("OBJ (*.obj)|*.obj|Binary mesh cache (*.moa)|*.moa"), wxFD_SAVE,
+                wxDefaultPosition);
             if (dialog->ShowModal() == wxID_OK) {
                 wxString filename = dialog->GetPath();
-                std::ofstream out(filename.mb_str());
-                mesh->save(out);
+                if (dialog->GetFilterIndex() == 1 || filename.AfterLast('.') == _T("moa")) {
+                    MeshCache::Save(mesh, std::string(filename.mb_str()));
+                } else {
+                    std::ofstream out(filename.mb_str());
+                    mesh->save(out);
+                }
             }
         }
     }
@@ -546,6 +551,24 @@ void FrameMain::DecimateObjects(wxCommandEvent& event) {
     mGLViewer->Render();
 }
 
+void FrameMain::CompactObjects(wxCommandEvent& event) {
+    std::list<GLObject*> objects = mGLViewer->GetSelectedObjects();
+    for (GLObject* object : objects) {
+        if (!object) continue;
+
+        DecimationMesh* mesh = dynamic_cast<DecimationMesh*>(object);
+        if (mesh == NULL) {
+            std::cerr << "Warning: Object '" << object->GetName()
+                      << "' is not a decimation mesh - can't be compacted" << std::endl;
+        } else {
+            // Drops the collapsed elements and the recorded levels of detail
+            mesh->Compact();
+        }
+    }
+
+    mGLViewer->Render();
+}
+
 #endif  // Lab2
 
 #ifdef LAB3
@@ -653,10 +676,11 @@ void FrameMain::AddObjectImplicitMesh(wxCommandEvent& event) {
             SimpleMesh* mesh = new SimpleMesh();
 
             // Load mesh
-            std::ifstream infile;
             ObjIO objIO;
-            infile.open(path.mb_str());
-            objIO.Load(mesh, infile);
+            if (!objIO.Load(mesh, std::string(path.mb_str()))) {
+                delete mesh;
+                return;
+            }
 
             // Create new implicit mesh with loaded mesh as argument
             ImplicitMesh* implicitMesh = new ImplicitMesh(mesh);
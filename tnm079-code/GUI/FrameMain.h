@@ -10,6 +10,7 @@
 #include "GLGridPlane.h"
 #include "GUI.h"
 #include "Util/ColorMapFactory.h"
+#include "Util/MeshCache.h"
 #include "Util/ObjIO.h"
 
 #include <fstream>
@@ -133,6 +134,7 @@ protected:
     void AddObjectSimpleDecimationMesh(wxCommandEvent& event);
     void AddObjectQuadricDecimationMesh(wxCommandEvent& event);
     void DecimateObjects(wxCommandEvent& event);
+    void CompactObjects(wxCommandEvent& event);
 #endif  // Lab2
 
 #ifdef LAB3
@@ -209,16 +211,23 @@ MeshType* FrameMain::AddMesh(const wxString& path) {
         filename = path.AfterLast('\\');
     wxString suffix = path.AfterLast('.');
 
-    if (suffix == _T("obj")) {
+    if (suffix == _T("obj") || suffix == _T("moa")) {
         // Create new mesh
         MeshType* mesh = new MeshType();
         mesh->SetName(std::string(filename.mb_str()));
 
         // Load mesh and add to geometry list
-        std::ifstream infile;
-        ObjIO objIO;
-        infile.open(path.mb_str());
-        objIO.Load(mesh, infile);
+        bool loaded;
+        if (suffix == _T("moa")) {
+            loaded = MeshCache::Load(mesh, std::string(path.mb_str()));
+        } else {
+            ObjIO objIO;
+            loaded = objIO.Load(mesh, std::string(path.mb_str()));
+        }
+        if (!loaded) {
+            delete mesh;
+            return NULL;
+        }
         mesh->Initialize();
 
         // Add mesh to scene
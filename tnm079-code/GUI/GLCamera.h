@@ -6,6 +6,7 @@
 #endif
 
 #include <Util/trackball.h>
+#include <cmath>
 #include <glm.hpp>
 /////////////////////////////////
 // Note: All angles in degrees  //
@@ -33,20 +34,20 @@ public:
     void RotateX(float r) {
         if (useCameraRotation) {
             r = r * (1.f / 180.f);
-            mCameraUp = cos(r) * mCameraUp + sin(r) * mCameraFwd;
-            mCameraFwd = cos(r) * mCameraFwd - sin(r) * mCameraUp;
+            mCameraUp = std::cos(r) * mCameraUp + std::sin(r) * mCameraFwd;
+            mCameraFwd = std::cos(r) * mCameraFwd - std::sin(r) * mCameraUp;
         }
     }
     void RotateY(float r) {
         if (useCameraRotation) {
             r = r * (1.f / 180.f);
-            mCameraFwd = cos(r) * mCameraFwd + sin(r) * GetRightVector();
+            mCameraFwd = std::cos(r) * mCameraFwd + std::sin(r) * GetRightVector();
         }
     }
     void RotateZ(float r) {
         if (useCameraRotation) {
             r = r * (1.f / 180.f);
-            mCameraUp = cos(r) * mCameraUp + sin(r) * GetRightVector();
+            mCameraUp = std::cos(r) * mCameraUp + std::sin(r) * GetRightVector();
         }
     }
 
@@ -64,6 +65,21 @@ public:
     glm::vec3 GetUpVector() const { return mCameraUp; }
     glm::vec3 GetLookAtPoint() const { return glm::vec3(mCameraPos + mCameraFwd); }
 
+    //! The camera position in the coordinates of the objects, undoing the trackball rotation
+    glm::vec3 GetScenePosition() const {
+        float quat[4] = {curquat[0], curquat[1], curquat[2], curquat[3]};
+        GLfloat m[4][4];
+        build_rotmatrix(m, quat);
+        // The rotation is orthonormal, so its inverse is its transpose
+        glm::vec3 pos(0.f, 0.f, 0.f);
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) {
+                pos[i] += m[i][j] * mCameraPos[j];
+            }
+        }
+        return pos;
+    }
+
     void LookAtOrigo() { mCameraFwd = -mCameraPos; }
 
     void Reset() { *this = GLCamera(); }
@@ -87,9 +103,9 @@ public:
         const float phi = spherical[1];
         const float theta = spherical[2];
 
-        const float x = r * sin(theta) * sin(phi);
-        const float y = r * cos(theta);
-        const float z = r * sin(theta) * cos(phi);
+        const float x = r * std::sin(theta) * std::sin(phi);
+        const float y = r * std::cos(theta);
+        const float z = r * std::sin(theta) * std::cos(phi);
 
         return glm::vec3(x, y, z);
     }
@@ -100,8 +116,8 @@ public:
         const float z = cartesian[2];
 
         const float r = glm::length(cartesian);
-        const float theta = acos(y / r);
-        const float phi = atan2(x, z);
+        const float theta = std::acos(y / r);
+        const float phi = std::atan2(x, z);
 
         return glm::vec3(r, phi, theta);
     }
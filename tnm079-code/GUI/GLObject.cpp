@@ -5,6 +5,7 @@
 void GLObject::Render() { CheckGLError(); }
 
 void GLObject::CheckGLError() {
+#ifndef MOA_HEADLESS
     GLenum error = glGetError();
     while (error != GL_NO_ERROR) {
         const GLubyte* errorString = gluErrorString(error);
@@ -12,4 +13,5 @@ void GLObject::CheckGLError() {
                   << std::endl;
         error = glGetError();
     }
+#endif
 }
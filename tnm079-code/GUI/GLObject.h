@@ -3,11 +3,14 @@
 #ifndef _GL_OBJECT
 #define _GL_OBJECT
 
+// Headless builds, like the benchmarks, compile the objects without GL and render nothing
+#ifndef MOA_HEADLESS
 #ifdef __WXMAC__
 #include "GLUT/glut.h"
 #else
 #include <GL/glut.h>
 #endif
+#endif
 
 #include "Util/BlackWhiteColorMap.h"
 
@@ -89,7 +92,7 @@ public:
     void ToggleSelect() { mSelected = !mSelected; }
     bool IsSelected() const { return mSelected; }
 
-    virtual void PickChildren(GLuint* objects, int numberOfObjects) {}
+    virtual void PickChildren(unsigned int* objects, int numberOfObjects) {}
 
     float mMinCMap, mMaxCMap;
     bool mAutoMinMax;
@@ -106,11 +109,13 @@ protected:
     void CheckGLError();
 
     void RenderString(float x, float y, float z, char* string) {
+#ifndef MOA_HEADLESS
         glRasterPos3f(x, y, z);
         int len = (int)strlen(string);
         for (int i = 0; i < len; i++) {
             glutBitmapCharacter(GLUT_BITMAP_HELVETICA_18, string[i]);
         }
+#endif
     }
 
     static VisualizationMode NewVisualizationMode(const std::string& name) {
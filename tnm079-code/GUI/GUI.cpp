@@ -335,6 +335,10 @@ BaseFrameMain::BaseFrameMain(wxWindow* parent, wxWindowID id, const wxString& ti
                               wxDefaultPosition, wxDefaultSize, 0);
     sbSizer7->Add(mInfo1, 0, wxALL, 5);
 
+    mButtonCompact = new wxButton(mPanelDecimation, wxID_ANY, wxT("Compact"), wxDefaultPosition,
+                                  wxDefaultSize, 0);
+    sbSizer7->Add(mButtonCompact, 0, wxALL, 5);
+
     mPanelDecimation->SetSizer(sbSizer7);
     mPanelDecimation->Layout();
     sbSizer7->Fit(mPanelDecimation);
@@ -875,6 +879,8 @@ BaseFrameMain::BaseFrameMain(wxWindow* parent, wxWindowID id, const wxString& ti
                         wxCommandEventHandler(BaseFrameMain::PlaySimulation), NULL, this);
     mButtonDecimate->Connect(wxEVT_COMMAND_BUTTON_CLICKED,
                              wxCommandEventHandler(BaseFrameMain::DecimateObjects), NULL, this);
+    mButtonCompact->Connect(wxEVT_COMMAND_BUTTON_CLICKED,
+                            wxCommandEventHandler(BaseFrameMain::CompactObjects), NULL, this);
     mButtonSubdivide->Connect(wxEVT_COMMAND_BUTTON_CLICKED,
                               wxCommandEventHandler(BaseFrameMain::SubdivideObjects), NULL, this);
     m_button7->Connect(wxEVT_COMMAND_BUTTON_CLICKED,
@@ -997,13 +1003,13 @@ BaseFrameMain::BaseFrameMain(wxWindow* parent, wxWindowID id, const wxString& ti
     m_button27->Connect(wxEVT_COMMAND_BUTTON_CLICKED, wxCommandEventHandler(BaseFrameMain::Smooth),
                         NULL, this);
 
-    std::array<wxButton*, 27> mButtons{
+    std::array<wxButton*, 28> mButtons{
         m_button14,        m_button13,      m_button15,       m_button16,       m_button18,
         m_button19,        m_button20,      m_button21,       m_button22,       m_button24,
         m_button27,        m_button4,       m_button5,        m_button6,        m_button7,
         m_button8,         mButtonDecimate, mButtonSubdivide, mButtonTransform, mDeleteObjects,
         mDifference,       mDilate,         mErode,           mFluidSaveButton, mIntersection,
-        mNarrowBandButton, mUnion};
+        mNarrowBandButton, mUnion,          mButtonCompact};
 
     for (auto button : mButtons) {
         button->SetForegroundColour(black);
@@ -1108,6 +1114,8 @@ BaseFrameMain::~BaseFrameMain() {
                            wxCommandEventHandler(BaseFrameMain::PlaySimulation), NULL, this);
     mButtonDecimate->Disconnect(wxEVT_COMMAND_BUTTON_CLICKED,
                                 wxCommandEventHandler(BaseFrameMain::DecimateObjects), NULL, this);
+    mButtonCompact->Disconnect(wxEVT_COMMAND_BUTTON_CLICKED,
+                               wxCommandEventHandler(BaseFrameMain::CompactObjects), NULL, this);
     mButtonSubdivide->Disconnect(wxEVT_COMMAND_BUTTON_CLICKED,
                                  wxCommandEventHandler(BaseFrameMain::SubdivideObjects), NULL,
                                  this);
@@ -70,6 +70,7 @@ protected:
     wxButton* mButtonDecimate;
     wxStaticText* mInfo1;
     wxTextCtrl* m_DecimationTargetTxtBox;
+    wxButton* mButtonCompact;
     wxPanel* mPanelSubdivision;
     wxButton* mButtonSubdivide;
     wxPanel* mPanelLevelset;
@@ -178,6 +179,7 @@ protected:
     virtual void FluidVisualizeVoxelsClassification(wxCommandEvent& event) { event.Skip(); }
     virtual void PlaySimulation(wxCommandEvent& event) { event.Skip(); }
     virtual void DecimateObjects(wxCommandEvent& event) { event.Skip(); }
+    virtual void CompactObjects(wxCommandEvent& event) { event.Skip(); }
     virtual void SubdivideObjects(wxCommandEvent& event) { event.Skip(); }
     virtual void LevelsetReinitialize(wxCommandEvent& event) { event.Skip(); }
     virtual void LevelsetAdvect(wxCommandEvent& event) { event.Skip(); }
@@ -0,0 +1,142 @@
+// GLEW has to be included before any other GL header
+#include <GL/glew.h>
+
+#include <GUI/MeshBuffers.h>
+#include <iostream>
+
+bool MeshBuffers::IsSupported() {
+    // Needs a current context, so it is resolved on the first draw rather than at startup
+    static const bool supported = [] {
+        const GLenum error = glewInit();
+        if (error != GLEW_OK) {
+            std::cerr << "GLEW initialization failed: " << glewGetErrorString(error)
+                      << ", using immediate mode rendering" << std::endl;
+            return false;
+        }
+        if (!GLEW_VERSION_1_5) {
+            std::cerr << "OpenGL 1.5 buffer objects not available, using immediate mode rendering"
+                      << std::endl;
+            return false;
+        }
+        return true;
+    }();
+    return supported;
+}
+
+MeshBuffers::MeshBuffers() : mDirty(All) {
+    for (size_t i = 0; i < NumBuffers; i++) {
+        mBuffers[i] = 0;
+        mCounts[i] = 0;
+    }
+}
+
+MeshBuffers::MeshBuffers(const MeshBuffers&) : MeshBuffers() {}
+
+MeshBuffers& MeshBuffers::operator=(const MeshBuffers& other) {
+    if (this != &other) {
+        Invalidate();
+    }
+    return *this;
+}
+
+MeshBuffers::~MeshBuffers() { Release(); }
+
+void MeshBuffers::Release() {
+    for (size_t i = 0; i < NumBuffers; i++) {
+        if (mBuffers[i] != 0) {
+            glDeleteBuffers(1, &mBuffers[i]);
+            mBuffers[i] = 0;
+        }
+        mCounts[i] = 0;
+    }
+    mDirty = All;
+}
+
+size_t MeshBuffers::Slot(Attribute attribute) {
+    switch (attribute) {
+        case Positions:
+            return 0;
+        case Normals:
+            return 1;
+        case Colors:
+            return 2;
+        default:
+            return 3;
+    }
+}
+
+void MeshBuffers::Upload(Attribute attribute, const std::vector<glm::vec3>& data) {
+    UploadData(attribute, data.data(), data.size() * sizeof(glm::vec3), data.size());
+}
+
+void MeshBuffers::Upload(const std::vector<uint32_t>& indices) {
+    UploadData(Indices, indices.data(), indices.size() * sizeof(uint32_t), indices.size());
+}
+
+void MeshBuffers::UploadData(Attribute attribute, const void* data, size_t bytes, size_t count) {
+    const size_t slot = Slot(attribute);
+    const GLenum target = attribute == Indices ? GL_ELEMENT_ARRAY_BUFFER : GL_ARRAY_BUFFER;
+    if (mBuffers[slot] == 0) {
+        glGenBuffers(1, &mBuffers[slot]);
+    }
+
+    glBindBuffer(target, mBuffers[slot]);
+    if (count == mCounts[slot] && count > 0) {
+        // Same size, update in place instead of reallocating the storage
+        glBufferSubData(target, 0, bytes, data);
+    } else {
+        glBufferData(target, bytes, data, GL_STATIC_DRAW);
+    }
+    glBindBuffer(target, 0);
+
+    mCounts[slot] = count;
+    mDirty &= ~attribute;
+}
+
+void MeshBuffers::Draw(unsigned int mode, float opacity) const {
+    const size_t numVerts = mCounts[Slot(Positions)];
+    if (numVerts == 0) {
+        return;
+    }
+
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER, mBuffers[Slot(Positions)]);
+    glVertexPointer(3, GL_FLOAT, 0, NULL);
+
+    if (mCounts[Slot(Normals)] == numVerts) {
+        glEnableClientState(GL_NORMAL_ARRAY);
+        glBindBuffer(GL_ARRAY_BUFFER, mBuffers[Slot(Normals)]);
+        glNormalPointer(GL_FLOAT, 0, NULL);
+    }
+
+    if (mCounts[Slot(Colors)] == numVerts) {
+        glEnableClientState(GL_COLOR_ARRAY);
+        glBindBuffer(GL_ARRAY_BUFFER, mBuffers[Slot(Colors)]);
+        glColorPointer(3, GL_FLOAT, 0, NULL);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // The color arrays carry no alpha, a constant opacity is blended through the blend color
+    const bool translucent = opacity < 1.f;
+    if (translucent) {
+        glBlendColor(0.f, 0.f, 0.f, opacity);
+        glBlendFunc(GL_CONSTANT_ALPHA, GL_ONE_MINUS_CONSTANT_ALPHA);
+    }
+
+    const size_t numIndices = mCounts[Slot(Indices)];
+    if (numIndices > 0) {
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mBuffers[Slot(Indices)]);
+        glDrawElements(mode, static_cast<GLsizei>(numIndices), GL_UNSIGNED_INT, NULL);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    } else {
+        glDrawArrays(mode, 0, static_cast<GLsizei>(numVerts));
+    }
+
+    if (translucent) {
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    }
+
+    glPopClientAttrib();
+}
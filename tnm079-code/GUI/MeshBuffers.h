@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <glm.hpp>
+#include <vector>
+
+/*! \brief Vertex and index buffer objects for drawing a mesh with one call
+ *
+ * Holds a position, normal and color array and an optional index buffer in
+ * GPU memory. Every array is uploaded once, and again only after it has been
+ * invalidated, so a mesh that is not modified costs a single glDrawElements
+ * (or glDrawArrays) per frame. Copies start out empty and fully dirty, the GL
+ * buffers themselves are never shared. The header does not include GL, so meshes
+ * can use the attribute flags in headless builds.
+ */
+class MeshBuffers {
+public:
+    //! The buffers, used as flags for invalidation
+    enum Attribute : unsigned int {
+        Positions = 1,
+        Normals = 2,
+        Colors = 4,
+        Indices = 8,
+        All = Positions | Normals | Colors | Indices
+    };
+
+    //! True if the current GL context has buffer objects, initializes GLEW on the first call
+    static bool IsSupported();
+
+    MeshBuffers();
+    MeshBuffers(const MeshBuffers&);
+    MeshBuffers& operator=(const MeshBuffers&);
+    ~MeshBuffers();
+
+    //! Marks attributes that have to be uploaded again before they are drawn
+    void Invalidate(unsigned int attributes = All) { mDirty |= attributes; }
+    bool IsDirty(unsigned int attributes) const { return (mDirty & attributes) != 0; }
+
+    //! Uploads a vec3 attribute array and clears its dirty flag
+    void Upload(Attribute attribute, const std::vector<glm::vec3>& data);
+
+    //! Uploads the triangle indices, an empty index buffer draws the arrays in order
+    void Upload(const std::vector<uint32_t>& indices);
+
+    /*! Draws the buffers as primitives of the given mode
+     * \param[in] mode GL_TRIANGLES or GL_LINES
+     * \param[in] opacity constant alpha, applied through the blend color
+     */
+    void Draw(unsigned int mode, float opacity = 1.f) const;
+
+    //! Deletes the GL buffers, needs the context they were created in
+    void Release();
+
+protected:
+    static const size_t NumBuffers = 4;
+
+    //! Position in mBuffers of a single attribute flag
+    static size_t Slot(Attribute attribute);
+
+    void UploadData(Attribute attribute, const void* data, size_t bytes, size_t count);
+
+    //! GL buffer names
+    unsigned int mBuffers[NumBuffers];
+    //! Number of elements in each buffer
+    size_t mCounts[NumBuffers];
+    unsigned int mDirty;
+};
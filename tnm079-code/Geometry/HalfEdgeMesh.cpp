@@ -1,8 +1,12 @@
 #include <Geometry/HalfEdgeMesh.h>
+#include <GUI/MeshBuffers.h>
+#include <Util/MeshCache.h>
+#include <Util/Parallel.h>
+#include <algorithm>
 #include <gtc/type_ptr.hpp>
 #include <iterator>
 
-HalfEdgeMesh::HalfEdgeMesh() {}
+HalfEdgeMesh::HalfEdgeMesh() : mCachedDifferentials(false), mOneRingsValid(false) {}
 
 HalfEdgeMesh::~HalfEdgeMesh() {}
 
@@ -21,11 +25,25 @@ bool HalfEdgeMesh::AddFace(const std::vector<glm::vec3>& verts) {
     const size_t index2 = AddVertex(verts.at(1));
     const size_t index3 = AddVertex(verts.at(2));
 
+    AddIndexedFace(index1, index2, index3);
+    return true;
+}
+
+/*!
+ * Connects three existing vertices with a new triangle
+ * \param[in] index1 vertex 1, index into mVerts
+ * \param[in] index2 vertex 2, index into mVerts
+ * \param[in] index3 vertex 3, index into mVerts
+ */
+void HalfEdgeMesh::AddIndexedFace(size_t index1, size_t index2, size_t index3) {
     // Add all half-edge pairs
     std::pair<size_t, size_t> pair1 = AddHalfEdgePair(index1, index2);
     std::pair<size_t, size_t> pair2 = AddHalfEdgePair(index2, index3);
     std::pair<size_t, size_t> pair3 = AddHalfEdgePair(index3, index1);
 
+    mOneRingsValid = false;
+    InvalidateBuffers();
+
     HalfEdge& hEdge1 = e(pair1.first);
     HalfEdge& hEdge2 = e(pair2.first);
     HalfEdge& hEdge3 = e(pair3.first);
@@ -35,17 +53,13 @@ bool HalfEdgeMesh::AddFace(const std::vector<glm::vec3>& verts) {
     hEdge2.next = pair3.first;
     hEdge3.next = pair1.first;
 
-    hEdge1.prev = pair3.first;
-    hEdge2.prev = pair1.first;
-    hEdge3.prev = pair2.first;
-
     // Finally, create the face, don't forget to set the normal (which should be
     // normalized)
     Face hEdgeFace{};
     hEdgeFace.edge = pair1.first; // Face added and connected to one of the edges
 
     mFaces.push_back(hEdgeFace); // Add the newly added face to the list
-    mFaces.back().normal = FaceNormal(mFaces.size() - 1); // Newly created face will be the last face in the face list
+    mFaces.normal.back() = FaceNormal(mFaces.size() - 1); // Newly created face will be the last face in the face list
 
     // All half-edges share the same left face (previously added)
     hEdge1.face = mFaces.size() - 1;
@@ -54,6 +68,229 @@ bool HalfEdgeMesh::AddFace(const std::vector<glm::vec3>& verts) {
 
     // Optionally, track the (outer) boundary half-edges
     // to represent non-closed surfaces
+}
+
+/*!
+ * The half edges are linked in a single pass over the triangles, pairing the
+ * directed edges through the edge hash table.
+ * \param[in] verts the vertex positions
+ * \param[in] tris the triangles as indices into verts
+ * \return false if a triangle references a vertex out of range
+ */
+bool HalfEdgeMesh::Build(const std::vector<glm::vec3>& verts,
+                         const std::vector<glm::uvec3>& tris) {
+    if (!ValidIndices(verts.size(), tris)) {
+        return false;
+    }
+
+    // Unreferenced vertices would be left without an edge, so drop them
+    std::vector<size_t> map;
+    const size_t numVerts = MapReferencedVertices(verts.size(), tris, map);
+
+    mEdges.clear();
+    mFaces.clear();
+    mVerts.clear();
+    mVerts.resize(numVerts);
+    FreeLookupTables();
+    mFaces.reserve(tris.size());
+    mEdges.reserve(3 * tris.size());
+    mUniqueEdgePairs.reserve(3 * tris.size() / 2);
+
+    for (size_t i = 0; i < verts.size(); i++) {
+        if (map[i] < numVerts) mVerts.pos[map[i]] = verts[i];
+    }
+    for (const glm::uvec3& tri : tris) {
+        AddIndexedFace(map[tri[0]], map[tri[1]], map[tri[2]]);
+    }
+
+    // The edge table is only needed while linking
+    FreeLookupTables();
+    return true;
+}
+
+namespace {
+
+//! Converts a link to the 32 bit cache index, keeping the EdgeState sentinels
+template <typename T>
+inline uint32_t ToCacheIndex(T index) {
+    const T distance = std::numeric_limits<T>::max() - index;
+    return distance < 2 ? MeshCache::Invalid - static_cast<uint32_t>(distance)
+                        : static_cast<uint32_t>(index);
+}
+
+template <typename T>
+inline T FromCacheIndex(uint32_t index) {
+    const uint32_t distance = MeshCache::Invalid - index;
+    return distance < 2 ? std::numeric_limits<T>::max() - distance : static_cast<T>(index);
+}
+
+//! A range of stored indices, for the one-ring kernels
+template <typename T>
+struct IndexRange {
+    const T* first;
+    const T* last;
+    const T* begin() const { return first; }
+    const T* end() const { return last; }
+};
+
+}  // namespace
+
+bool HalfEdgeMesh::SaveCache(std::ostream& os) { return WriteCache(os, mVerts, mFaces, mEdges); }
+
+bool HalfEdgeMesh::WriteCache(std::ostream& os, const VertexArrays& verts, const FaceArrays& faces,
+                              const std::vector<HalfEdge>& edges) {
+    const size_t numVerts = verts.size();
+    const size_t numFaces = faces.size();
+    const size_t numEdges = edges.size();
+    if (std::max(numEdges, numVerts) >= MeshCache::Invalid - 1) {
+        std::cerr << "Error: mesh is too large for the mesh cache format" << std::endl;
+        return false;
+    }
+
+    // The attribute arrays are written as they are stored
+    std::vector<uint32_t> vertEdges(numVerts);
+    for (size_t i = 0; i < numVerts; i++) {
+        vertEdges[i] = ToCacheIndex(verts.edge[i]);
+    }
+
+    std::vector<glm::uvec3> tris(numFaces);
+    std::vector<uint32_t> faceEdges(numFaces);
+    for (size_t i = 0; i < numFaces; i++) {
+        const size_t e1 = faces.edge[i];
+        const size_t e2 = edges[e1].next;
+        tris[i] = glm::uvec3(edges[e1].vert, edges[e2].vert, edges[edges[e2].next].vert);
+        faceEdges[i] = ToCacheIndex(faces.edge[i]);
+    }
+
+    std::vector<MeshCache::HalfEdge> cacheEdges(numEdges);
+    for (size_t i = 0; i < numEdges; i++) {
+        const HalfEdge& edge = edges[i];
+        cacheEdges[i].vert = ToCacheIndex(edge.vert);
+        cacheEdges[i].face = ToCacheIndex(edge.face);
+        cacheEdges[i].next = ToCacheIndex(edge.next);
+        cacheEdges[i].pair = ToCacheIndex(edge.pair);
+    }
+
+    MeshCache::Data data;
+    data.numVerts = numVerts;
+    data.numFaces = numFaces;
+    data.numEdges = numEdges;
+    data.positions = verts.pos.data();
+    data.tris = tris.data();
+    data.edges = cacheEdges.data();
+    data.vertEdges = vertEdges.data();
+    data.faceEdges = faceEdges.data();
+    data.normals = verts.normal.data();
+    data.curvature = verts.curvature.data();
+    return MeshCache::Write(os, data);
+}
+
+/*!
+ * Without stored half edges the mesh is built from the index buffer as usual.
+ * \param[in] cache a valid, mapped mesh cache
+ * \return false if the stored connectivity references elements out of range
+ */
+bool HalfEdgeMesh::LoadCache(const MeshCache& cache) {
+    if (!cache.Has(MeshCache::HalfEdges)) {
+        return Mesh::LoadCache(cache) && RestoreCachedDifferentials(cache);
+    }
+
+    const size_t numVerts = cache.GetNumVerts();
+    const size_t numFaces = cache.GetNumFaces();
+    const size_t numEdges = cache.GetNumEdges();
+
+    FreeLookupTables();
+    mOneRingsValid = false;
+    InvalidateBuffers();
+    mVerts.clear();
+    mVerts.resize(numVerts);
+    mFaces.clear();
+    mFaces.resize(numFaces);
+    mEdges.assign(numEdges, HalfEdge());
+
+    // Links must point inside the arrays. Only the face and next of a border half edge
+    // and the edge of an isolated vertex may be one of the EdgeState values instead.
+    bool valid = true;
+    auto index = [&valid](uint32_t index, size_t size) {
+        const Index i = FromCacheIndex<Index>(index);
+        valid = valid && i < size;
+        return i;
+    };
+    auto link = [&valid](uint32_t index, size_t size) {
+        const Index i = FromCacheIndex<Index>(index);
+        valid = valid && (i < size || i >= EdgeState::Uninitialized);
+        return i;
+    };
+
+    mVerts.pos.assign(cache.GetPositions(), cache.GetPositions() + numVerts);
+    const uint32_t* vertEdges = cache.GetVertEdges();
+    for (size_t i = 0; i < numVerts; i++) {
+        mVerts.edge[i] = link(vertEdges[i], numEdges);
+    }
+
+    const MeshCache::HalfEdge* edges = cache.GetEdges();
+    for (size_t i = 0; i < numEdges; i++) {
+        HalfEdge& edge = mEdges[i];
+        edge.vert = index(edges[i].vert, numVerts);
+        edge.face = link(edges[i].face, numFaces);
+        edge.next = edge.face < numFaces ? index(edges[i].next, numEdges)
+                                         : link(edges[i].next, numEdges);
+        edge.pair = index(edges[i].pair, numEdges);
+    }
+
+    const uint32_t* faceEdges = cache.GetFaceEdges();
+    for (size_t i = 0; i < numFaces; i++) {
+        mFaces.edge[i] = index(faceEdges[i], numEdges);
+    }
+
+    // The circulators rely on the pairs being mutual and the faces being triangles
+    for (size_t i = 0; valid && i < numEdges; i++) {
+        const HalfEdge& edge = mEdges[i];
+        valid = edge.pair != i && mEdges[edge.pair].pair == i;
+        if (valid && edge.face < numFaces) {
+            const Index next = edge.next, nextNext = mEdges[next].next;
+            valid = mEdges[next].face == edge.face && nextNext < numEdges &&
+                    mEdges[nextNext].face == edge.face && mEdges[nextNext].next == i;
+        }
+    }
+    for (size_t i = 0; valid && i < numVerts; i++) {
+        valid = mVerts.edge[i] >= EdgeState::Uninitialized || mEdges[mVerts.edge[i]].vert == i;
+    }
+    for (size_t i = 0; valid && i < numFaces; i++) {
+        valid = mEdges[mFaces.edge[i]].face == i;
+    }
+
+    if (!valid) {
+        std::cerr << "Error: mesh cache has invalid half edge links" << std::endl;
+        mVerts.clear();
+        mFaces.clear();
+        mEdges.clear();
+        return false;
+    }
+
+    for (size_t i = 0; i < numFaces; i++) {
+        mFaces.normal[i] = FaceNormal(i);
+    }
+    return RestoreCachedDifferentials(cache);
+}
+
+/*!
+ * Copies the stored vertex normals and curvature, if present, and derives the
+ * face curvature from them so the next Update() can skip the differentials.
+ */
+bool HalfEdgeMesh::RestoreCachedDifferentials(const MeshCache& cache) {
+    mCachedDifferentials = false;
+    if (!cache.Has(MeshCache::VertexNormals) || !cache.Has(MeshCache::VertexCurvature) ||
+        cache.GetNumVerts() != GetNumVerts()) {
+        return true;
+    }
+
+    mVerts.normal.assign(cache.GetNormals(), cache.GetNormals() + GetNumVerts());
+    mVerts.curvature.assign(cache.GetCurvature(), cache.GetCurvature() + GetNumVerts());
+    for (size_t i = 0; i < GetNumFaces(); i++) {
+        mFaces.curvature[i] = FaceCurvature(i);
+    }
+    mCachedDifferentials = true;
     return true;
 }
 
@@ -62,13 +299,14 @@ bool HalfEdgeMesh::AddFace(const std::vector<glm::vec3>& verts) {
  * \return the index to the vertex
  */
 size_t HalfEdgeMesh::AddVertex(const glm::vec3& v) {
-    std::map<glm::vec3, size_t>::iterator it = mUniqueVerts.find(v);
-    if (it != mUniqueVerts.end()) { // If we at any point find a non-unique vertex, if it==mUniqueVerts.end(), v is a unique vertex
-        return (*it).second;  // get the index of the already existing vertex
-    }
+    RebuildVertexLookup();
 
     const auto indx = GetNumVerts(); // For the unique vertex we assign it to the index corresponding to the last position in our vertex list
-    mUniqueVerts[v] = indx;  // op. [ ] constructs a new entry in map
+    std::pair<size_t, bool> welded = mUniqueVerts.insert(v, indx);
+    if (!welded.second) { // If we at any point find a non-unique vertex, v is merged with it
+        return welded.first;  // get the index of the already existing vertex
+    }
+
     Vertex vert; // Instatiate the new vertex
     vert.pos = v; // Assign the position of v to the new vertex
     mVerts.push_back(vert);  // add it to the vertex list
@@ -85,20 +323,22 @@ size_t HalfEdgeMesh::AddVertex(const glm::vec3& v) {
  * \return a pair the indices to the half-edges
  */
 std::pair<size_t, size_t> HalfEdgeMesh::AddHalfEdgePair(size_t v1, size_t v2) {
-    std::map<OrderedPair, size_t>::iterator it = mUniqueEdgePairs.find(OrderedPair(v1, v2));
-    if (it != mUniqueEdgePairs.end()) { // Look if current pair is unqie or not, same manner as the vertex check
-        auto indx1 = it->second; // get the index of the first half edge that was a duplicate
-        auto indx2 = e(it->second).pair; // get the index of the second half edge that was a duplicate
+    RebuildEdgeLookup();
+
+    // Calculate both half-edges indices in case the pair is new
+    const auto indx1 = mEdges.size(); // This will be the new half edge, currently last index
+    const auto indx2 = indx1 + 1; // And this will be the other part of the half, this is the actual last index now
+
+    std::pair<Index*, bool> it = mUniqueEdgePairs.insert(MakeEdgePairKey(v1, v2), indx1);
+    if (!it.second) { // Look if current pair is unqie or not, same manner as the vertex check
+        auto indx1 = *it.first; // get the index of the first half edge that was a duplicate
+        auto indx2 = e(indx1).pair; // get the index of the second half edge that was a duplicate
         if (v1 != e(indx1).vert) {
             std::swap(indx1, indx2);  // sort correctly
         }
         return {indx1, indx2}; // Return the already existing half edge pair, sorted correclty
     }
 
-    // If not found, calculate both half-edges indices
-    const auto indx1 = mEdges.size(); // This will be the new half edge, currently last index
-    const auto indx2 = indx1 + 1; // And this will be the other part of the half, this is the actual last index now
-
     // Create edges and set pair index
     HalfEdge edge1, edge2; // Instansiate the half edges
     edge1.pair = indx2; // First half edge is the last edge in the half edge list
@@ -116,14 +356,53 @@ std::pair<size_t, size_t> HalfEdgeMesh::AddHalfEdgePair(size_t v1, size_t v2) {
     mEdges.push_back(edge1);
     mEdges.push_back(edge2);
 
-    // Store the first edge in the map as an OrderedPair
-    OrderedPair op(v1, v2);
-    mUniqueEdgePairs[op] = indx1;  // op. [ ] constructs a new entry in map, ordering not important
-    // sorting done when retrieving
-
     return {indx1, indx2}; // Return the new half edge pair as indicies to the half edge list
 }
 
+/*!
+ * \param [in] numFaces the number of triangles that will be added
+ */
+void HalfEdgeMesh::Reserve(size_t numFaces) {
+    // A closed triangle mesh has 3 half edges per face and roughly half as many
+    // vertices as faces
+    mFaces.reserve(numFaces);
+    mEdges.reserve(3 * numFaces);
+    mVerts.reserve(numFaces / 2 + 2);
+    mUniqueVerts.reserve(numFaces / 2 + 2);
+    mUniqueEdgePairs.reserve(3 * numFaces / 2);
+}
+
+void HalfEdgeMesh::SetWeldTolerance(float tolerance) {
+    mUniqueVerts.SetTolerance(tolerance);
+    RebuildVertexLookup();
+}
+
+void HalfEdgeMesh::FreeLookupTables() {
+    mUniqueVerts.clear();
+    mUniqueEdgePairs.clear();
+}
+
+/*! The lookup tables are only needed while faces are added. Once freed they
+ * are rebuilt from the vertex and edge arrays the next time they are used.
+ */
+void HalfEdgeMesh::RebuildVertexLookup() {
+    if (mUniqueVerts.size() == 0 && !mVerts.empty()) {
+        mUniqueVerts.reserve(mVerts.size());
+        for (size_t i = 0; i < mVerts.size(); i++) {
+            mUniqueVerts.insert(mVerts.pos[i], i);
+        }
+    }
+}
+
+void HalfEdgeMesh::RebuildEdgeLookup() {
+    if (mUniqueEdgePairs.isEmpty() && !mEdges.empty()) {
+        mUniqueEdgePairs.reserve(mEdges.size() / 2);
+        for (size_t i = 0; i < mEdges.size(); i += 2) {
+            mUniqueEdgePairs.insert(MakeEdgePairKey(mEdges[i].vert, mEdges[i + 1].vert), i);
+        }
+    }
+}
+
 /*! \lab1 HalfEdgeMesh Implement the MergeAdjacentBoundaryEdge */
 /*!
  * Merges the outer UNINITIALIZED/BORDER to an already set inner half-edge.
@@ -151,7 +430,6 @@ void HalfEdgeMesh::Validate() {
         if ((*iterEdge).face == EdgeState::Uninitialized ||
             (*iterEdge).next == EdgeState::Uninitialized ||
             (*iterEdge).pair == EdgeState::Uninitialized ||
-            (*iterEdge).prev == EdgeState::Uninitialized ||
             (*iterEdge).vert == EdgeState::Uninitialized)
         {
             std::cerr << "HalfEdge " << iterEdge - mEdges.begin() << " not properly initialized"
@@ -162,45 +440,37 @@ void HalfEdgeMesh::Validate() {
     }
     std::cerr << "Done with edge check (checked " << GetNumEdges() << " edges)" << std::endl;
 
-    std::vector<Face>::iterator iterTri = mFaces.begin();
-    std::vector<Face>::iterator iterTriEnd = mFaces.end();
-    while (iterTri != iterTriEnd) {
-        if ((*iterTri).edge == EdgeState::Uninitialized) {
-            std::cerr << "Tri " << iterTri - mFaces.begin() << " not properly initialized"
-                      << std::endl;
+    for (size_t i = 0; i < GetNumFaces(); i++) {
+        if (mFaces.edge[i] == EdgeState::Uninitialized) {
+            std::cerr << "Tri " << i << " not properly initialized" << std::endl;
         }
-
-        iterTri++;
     }
     std::cerr << "Done with face check (checked " << GetNumFaces() << " faces)" << std::endl;
 
-    std::vector<Vertex>::iterator iterVertex = mVerts.begin();
-    std::vector<Vertex>::iterator iterVertexEnd = mVerts.end();
-    while (iterVertex != iterVertexEnd) {
-        if ((*iterVertex).edge == EdgeState::Uninitialized) {
-            std::cerr << "Vertex " << iterVertex - mVerts.begin() << " not properly initialized"
-                      << std::endl;
+    for (size_t i = 0; i < GetNumVerts(); i++) {
+        if (mVerts.edge[i] == EdgeState::Uninitialized) {
+            std::cerr << "Vertex " << i << " not properly initialized" << std::endl;
         }
-
-        iterVertex++;
     }
     std::cerr << "Done with vertex check (checked " << GetNumVerts() << " vertices)" << std::endl;
 
     std::cerr << "Looping through triangle neighborhood of each vertex... ";
-    iterVertex = mVerts.begin();
-    iterVertexEnd = mVerts.end();
     int emptyCount = 0;
     std::vector<size_t> problemVerts;
-    while (iterVertex != iterVertexEnd) {
-        std::vector<size_t> foundFaces = FindNeighborFaces(iterVertex - mVerts.begin());
-        std::vector<size_t> foundVerts = FindNeighborVertices(iterVertex - mVerts.begin());
-        if (foundFaces.empty() || foundVerts.empty()) emptyCount++;
-        std::set<size_t> uniqueFaces(foundFaces.begin(), foundFaces.end());
-        std::set<size_t> uniqueVerts(foundVerts.begin(), foundVerts.end());
-        if (foundFaces.size() != uniqueFaces.size() || foundVerts.size() != uniqueVerts.size()) {
-            problemVerts.push_back(iterVertex - mVerts.begin());
-        }
-        iterVertex++;
+    std::vector<Index> found;
+    for (size_t i = 0; i < GetNumVerts(); i++) {
+        // A ring may not contain a face or a vertex twice
+        found.assign(NeighborFaces(i).begin(), NeighborFaces(i).end());
+        std::sort(found.begin(), found.end());
+        bool duplicates = std::adjacent_find(found.begin(), found.end()) != found.end();
+        const bool noFaces = found.empty();
+
+        found.assign(NeighborVertices(i).begin(), NeighborVertices(i).end());
+        std::sort(found.begin(), found.end());
+        duplicates = duplicates || std::adjacent_find(found.begin(), found.end()) != found.end();
+
+        if (noFaces || found.empty()) emptyCount++;
+        if (duplicates) problemVerts.push_back(i);
     }
     std::cerr << std::endl << "Done: " << emptyCount << " isolated vertices found" << std::endl;
     if (problemVerts.size()) {
@@ -227,17 +497,9 @@ void HalfEdgeMesh::Validate() {
 std::vector<size_t> HalfEdgeMesh::FindNeighborVertices(size_t vertexIndex) const {
     // Collected vertices, sorted counter clockwise!
     std::vector<size_t> oneRing;
-
-    // Add your code here
-    HalfEdge currEdge = e(v(vertexIndex).edge);
-    std::size_t end = currEdge.pair;
-    oneRing.push_back(e(currEdge.next).vert);
-
-    while (currEdge.prev != end) {
-        currEdge = e(e(currEdge.prev).pair);
-        oneRing.push_back(e(currEdge.next).vert);
+    for (Index vert : NeighborVertices(vertexIndex)) {
+        oneRing.push_back(vert);
     }
-
     return oneRing;
 }
 
@@ -249,76 +511,80 @@ std::vector<size_t> HalfEdgeMesh::FindNeighborVertices(size_t vertexIndex) const
 std::vector<size_t> HalfEdgeMesh::FindNeighborFaces(size_t vertexIndex) const {
     // Collected faces, sorted counter clockwise!
     std::vector<size_t> foundFaces;
-
-    // Add your code here
-    HalfEdge currEdge = e(v(vertexIndex).edge);
-    std::size_t end = currEdge.pair;
-    foundFaces.push_back(e(currEdge.next).face);
-
-    while (currEdge.prev != end) {
-        currEdge = e(e(currEdge.prev).pair);
-        foundFaces.push_back(e(currEdge.next).face);
+    for (Index face : NeighborFaces(vertexIndex)) {
+        foundFaces.push_back(face);
     }
-
-    return foundFaces;
-
     return foundFaces;
 }
 
-/*! \lab1 Implement the curvature */
-float HalfEdgeMesh::VertexCurvature(size_t vertexIndex) const {
-    std::vector<size_t> oneRing = FindNeighborVertices(vertexIndex);
-    assert(oneRing.size() != 0);
-    size_t curr, next, prev;
+/*!
+ * \param[in] edges the outgoing half edges, border edges are skipped
+ */
+template <typename EdgeRange>
+glm::vec3 HalfEdgeMesh::OneRingNormal(const EdgeRange& edges) const {
+    glm::vec3 n(0.f, 0.f, 0.f);
+    for (Index edge : edges) {
+        const Index face = mEdges[edge].face;
+        if (face < EdgeState::Uninitialized) n += mFaces.normal[face];
+    }
+    return glm::normalize(n);
+}
 
+/*!
+ * Sums the cotangent weights face by face. A face (v, a, b) adds the
+ * cotangent of its angle at b to the edge va, and the one at a to the edge
+ * vb, so every interior edge gets the weight cot(alpha) + cot(beta).
+ * \param[in] vertexIndex the vertex to compute the curvature at
+ * \param[in] edges the outgoing half edges, border edges are skipped
+ */
+template <typename EdgeRange>
+float HalfEdgeMesh::OneRingCurvature(size_t vertexIndex, const EdgeRange& edges) const {
+    const glm::vec3& pos = mVerts.pos[vertexIndex];
     glm::vec3 sum = {0, 0, 0};
     float area = 0;
 
-    for (size_t i = 0; i < oneRing.size(); i++) {
-        curr = oneRing.at(i);
-
-        if (i == 0) {
-            prev = oneRing.back();
-        } else {
-            prev = oneRing.at(i - 1);
-        }
-
-        if (i < oneRing.size() - 1) {
-            next = oneRing.at(i + 1);
-        } else {
-            next = oneRing.front();
-        }
-
-        float cotangentAlpha = Cotangent(v(curr).pos, v(prev).pos, v(vertexIndex).pos);
-        float cotangentBeta = Cotangent(v(curr).pos, v(next).pos, v(vertexIndex).pos);
-
-        sum += (cotangentAlpha + cotangentBeta) * (v(vertexIndex).pos - v(curr).pos);
-        area += ((cotangentAlpha + cotangentBeta) * pow(glm::length(v(vertexIndex).pos - v(curr).pos), 2.0f));
+    for (Index edge : edges) {
+        const HalfEdge& e1 = mEdges[edge];
+        if (e1.face >= EdgeState::Uninitialized) continue;
+        const HalfEdge& e2 = mEdges[e1.next];
+        const glm::vec3& a = mVerts.pos[e2.vert];
+        const glm::vec3& b = mVerts.pos[mEdges[e2.next].vert];
+
+        const float cotangentA = Cotangent(b, a, pos);
+        const float cotangentB = Cotangent(a, b, pos);
+        sum += cotangentB * (pos - a) + cotangentA * (pos - b);
+        area += cotangentB * glm::dot(pos - a, pos - a) + cotangentA * glm::dot(pos - b, pos - b);
     }
     area = area / 8.0f;
 
-	return glm::length(sum / (4.0f * area));
+    return glm::length(sum / (4.0f * area));
+}
+
+/*! \lab1 Implement the curvature */
+float HalfEdgeMesh::VertexCurvature(size_t vertexIndex) const {
+    assert(OutgoingEdges(vertexIndex).begin() != OutgoingEdges(vertexIndex).end());
+    return OneRingCurvature(vertexIndex, OutgoingEdges(vertexIndex));
 }
 
 float HalfEdgeMesh::FaceCurvature(size_t faceIndex) const {
     // NB Assumes vertex curvature already computed
-    size_t indx = f(faceIndex).edge;
+    size_t indx = mFaces.edge.at(faceIndex);
     const EdgeIterator it = GetEdgeIterator(indx);
 
-    const auto& v1 = v(it.GetEdgeVertexIndex());
-    const auto& v2 = v(it.Next().GetEdgeVertexIndex());
-    const auto& v3 = v(it.Next().GetEdgeVertexIndex());
+    const float c1 = mVerts.curvature[it.GetEdgeVertexIndex()];
+    const float c2 = mVerts.curvature[it.Next().GetEdgeVertexIndex()];
+    const float c3 = mVerts.curvature[it.Next().GetEdgeVertexIndex()];
 
-    return (v1.curvature + v2.curvature + v3.curvature) / 3.f;
+    return (c1 + c2 + c3) / 3.f;
 }
 
 glm::vec3 HalfEdgeMesh::FaceNormal(size_t faceIndex) const {
-    size_t indx = f(faceIndex).edge;
+    size_t indx = mFaces.edge.at(faceIndex);
     const EdgeIterator it = GetEdgeIterator(indx);
 
-    const auto& p1 = v(it.GetEdgeVertexIndex()).pos;
-    const auto& p2 = v(it.Next().GetEdgeVertexIndex()).pos;
-    const auto& p3 = v(it.Next().GetEdgeVertexIndex()).pos;
+    const glm::vec3& p1 = mVerts.pos[it.GetEdgeVertexIndex()];
+    const glm::vec3& p2 = mVerts.pos[it.Next().GetEdgeVertexIndex()];
+    const glm::vec3& p3 = mVerts.pos[it.Next().GetEdgeVertexIndex()];
 
     const auto e1 = p2 - p1;
     const auto e2 = p3 - p1;
@@ -326,47 +592,93 @@ glm::vec3 HalfEdgeMesh::FaceNormal(size_t faceIndex) const {
 }
 
 glm::vec3 HalfEdgeMesh::VertexNormal(size_t vertexIndex) const {
-    glm::vec3 n(0.f, 0.f, 0.f); //n_vI
+    // Vertex normals are the average of the surrounding face normals
+    return OneRingNormal(OutgoingEdges(vertexIndex));
+}
 
-    // Add your code here
-    std::vector<size_t> neighborFaces = FindNeighborFaces(vertexIndex);
+void HalfEdgeMesh::BuildOneRings(const std::vector<bool>* collapsedVerts) {
+    const size_t numVerts = GetNumVerts();
+    if (mOneRingsValid && mOneRings.offsets.size() == numVerts + 1) {
+        return;
+    }
 
-    for (auto face : neighborFaces) {
-        n += f(face).normal;
+    auto collapsed = [collapsedVerts](size_t i) {
+        return collapsedVerts != NULL && (*collapsedVerts)[i];
+    };
+
+    // Count the valences, then turn them into offsets
+    std::vector<Index>& offsets = mOneRings.offsets;
+    offsets.assign(numVerts + 1, 0);
+    ParallelFor(numVerts, [&](size_t i) {
+        if (collapsed(i)) return;
+        Index valence = 0;
+        for (Index edge : OutgoingEdges(i)) {
+            (void)edge;
+            valence++;
+        }
+        offsets[i + 1] = valence;
+    });
+    for (size_t i = 0; i < numVerts; i++) {
+        offsets[i + 1] += offsets[i];
     }
 
-    n = glm::normalize(n);
+    mOneRings.edges.resize(offsets.back());
+    ParallelFor(numVerts, [&](size_t i) {
+        if (collapsed(i)) return;
+        Index k = offsets[i];
+        for (Index edge : OutgoingEdges(i)) {
+            mOneRings.edges[k++] = edge;
+        }
+    });
+    mOneRingsValid = true;
+}
+
+void HalfEdgeMesh::UpdateDifferentials(const std::vector<bool>* collapsedVerts,
+                                       const std::vector<bool>* collapsedFaces) {
+    BuildOneRings(collapsedVerts);
+
+    auto faceCollapsed = [collapsedFaces](size_t i) {
+        return collapsedFaces != NULL && (*collapsedFaces)[i];
+    };
+
+    // First update all face normals
+    ParallelFor(GetNumFaces(), [&](size_t i) {
+        if (!faceCollapsed(i)) mFaces.normal[i] = FaceNormal(i);
+    });
+
+    // Then update all vertex normals and curvature, collapsed and isolated
+    // vertices have empty rings
+    const Index* offsets = mOneRings.offsets.data();
+    const Index* edges = mOneRings.edges.data();
+    ParallelFor(GetNumVerts(), [&](size_t i) {
+        if (offsets[i] == offsets[i + 1]) return;
+        const IndexRange<Index> ring = {edges + offsets[i], edges + offsets[i + 1]};
+        mVerts.normal[i] = OneRingNormal(ring);
+        mVerts.curvature[i] = OneRingCurvature(i, ring);
+    });
 
-    return n;
+    // Finally update face curvature
+    ParallelFor(GetNumFaces(), [&](size_t i) {
+        if (!faceCollapsed(i)) mFaces.curvature[i] = FaceCurvature(i);
+    });
 }
 
 void HalfEdgeMesh::Initialize() {
+    // The mesh is complete, so the lookup tables are no longer needed
+    FreeLookupTables();
     Validate();
     Update();
 }
 
 void HalfEdgeMesh::Update() {
     // Calculate and store all differentials and area
+    InvalidateBuffers(MeshBuffers::Normals | MeshBuffers::Colors);
 
-    // First update all face normals and triangle areas
-    for (size_t i = 0; i < GetNumFaces(); i++) {
-        f(i).normal = FaceNormal(i);
-    }
-    // Then update all vertex normals and curvature
-    for (size_t i = 0; i < GetNumVerts(); i++) {
-        // Vertex normals are just weighted averages
-        mVerts.at(i).normal = VertexNormal(i);
-    }
-
-    // Then update vertex curvature
-    for (size_t i = 0; i < GetNumVerts(); i++) {
-        mVerts.at(i).curvature = VertexCurvature(i);
-        //    std::cerr <<   mVerts.at(i).curvature << "\n";
-    }
-
-    // Finally update face curvature
-    for (size_t i = 0; i < GetNumFaces(); i++) {
-        f(i).curvature = FaceCurvature(i);
+    if (mCachedDifferentials) {
+        // Normals and curvature were just restored from a mesh cache
+        mCachedDifferentials = false;
+    } else {
+        UpdateDifferentials();
     }
 
     std::cerr << "Area: " << Area() << ".\n";
@@ -391,17 +703,17 @@ void HalfEdgeMesh::Update() {
                       << mMaxCMap << "]" << std::endl;
         } else {
             // Compute range from vertices
-            for (auto& vert : mVerts) {
-                if (minCurvature > vert.curvature) minCurvature = vert.curvature;
-                if (maxCurvature < vert.curvature) maxCurvature = vert.curvature;
+            for (float curvature : mVerts.curvature) {
+                if (minCurvature > curvature) minCurvature = curvature;
+                if (maxCurvature < curvature) maxCurvature = curvature;
             }
             std::cerr << "Automatic mapping of color based on vertex curvature with range ["
                       << minCurvature << "," << maxCurvature << "]" << std::endl;
             mMinCMap = minCurvature;
             mMaxCMap = maxCurvature;
         }
-        for (auto& vert : mVerts) {
-            vert.color = mColorMap->Map(vert.curvature, minCurvature, maxCurvature);
+        for (size_t i = 0; i < GetNumVerts(); i++) {
+            mVerts.color[i] = mColorMap->Map(mVerts.curvature[i], minCurvature, maxCurvature);
         }
     } else if (mVisualizationMode == CurvatureFace) {
         if (!mAutoMinMax) {
@@ -409,17 +721,17 @@ void HalfEdgeMesh::Update() {
                       << mMaxCMap << "]" << std::endl;
         } else {
             // Compute range from faces
-            for (auto& face : mFaces) {
-                if (minCurvature > face.curvature) minCurvature = face.curvature;
-                if (maxCurvature < face.curvature) maxCurvature = face.curvature;
+            for (float curvature : mFaces.curvature) {
+                if (minCurvature > curvature) minCurvature = curvature;
+                if (maxCurvature < curvature) maxCurvature = curvature;
             }
             std::cerr << "Automatic mapping of color based on face curvature with range ["
                       << minCurvature << "," << maxCurvature << "]" << std::endl;
             mMinCMap = minCurvature;
             mMaxCMap = maxCurvature;
         }
-        for (auto& face : mFaces) {
-            face.color = mColorMap->Map(face.curvature, minCurvature, maxCurvature);
+        for (size_t i = 0; i < GetNumFaces(); i++) {
+            mFaces.color[i] = mColorMap->Map(mFaces.curvature[i], minCurvature, maxCurvature);
         }
     }
 }
@@ -431,13 +743,12 @@ float HalfEdgeMesh::Area() const {
 
     //std::cerr << "Area calculation not implemented for half-edge mesh!\n"; DO NOT UNCOMMENT
 
-    for (auto face : mFaces) {
-        size_t index = face.edge;
+    for (size_t index : mFaces.edge) {
         const EdgeIterator it = GetEdgeIterator(index);
 
-        const auto& v1 = v(it.GetEdgeVertexIndex()).pos;
-        const auto& v2 = v(it.Next().GetEdgeVertexIndex()).pos;
-        const auto& v3 = v(it.Next().GetEdgeVertexIndex()).pos;
+        const glm::vec3& v1 = mVerts.pos[it.GetEdgeVertexIndex()];
+        const glm::vec3& v2 = mVerts.pos[it.Next().GetEdgeVertexIndex()];
+        const glm::vec3& v3 = mVerts.pos[it.Next().GetEdgeVertexIndex()];
 
         const auto e1 = v2 - v1;
         const auto e2 = v3 - v1;
@@ -453,19 +764,18 @@ float HalfEdgeMesh::Volume() const {
     float volume = 0;
     // Add code here
     //std::cerr << "Volume calculation not implemented for half-edge mesh!\n";
-    for (auto face : mFaces) {
-        size_t index = face.edge;
-        const EdgeIterator it = GetEdgeIterator(index);
+    for (size_t i = 0; i < GetNumFaces(); i++) {
+        const EdgeIterator it = GetEdgeIterator(mFaces.edge[i]);
 
-        const auto& v1 = v(it.GetEdgeVertexIndex()).pos;
-        const auto& v2 = v(it.Next().GetEdgeVertexIndex()).pos;
-        const auto& v3 = v(it.Next().GetEdgeVertexIndex()).pos;
+        const glm::vec3& v1 = mVerts.pos[it.GetEdgeVertexIndex()];
+        const glm::vec3& v2 = mVerts.pos[it.Next().GetEdgeVertexIndex()];
+        const glm::vec3& v3 = mVerts.pos[it.Next().GetEdgeVertexIndex()];
 
         const auto e1 = v2 - v1;
         const auto e2 = v3 - v1;
 
         const auto centroid = glm::length((v1 + v2 + v3) / 3.0f);
-        const auto faceNormal = glm::length(face.normal);
+        const auto faceNormal = glm::length(mFaces.normal[i]);
         const float area = glm::length(glm::cross(e1, e2)) / 2;
 
         volume += centroid * faceNormal * area;
@@ -488,30 +798,31 @@ size_t HalfEdgeMesh::Genus() const {
 }
 
 void HalfEdgeMesh::Dilate(float amount) {
-    for (Vertex& v : mVerts) {
-        v.pos += amount * v.normal;
+    for (size_t i = 0; i < GetNumVerts(); i++) {
+        mVerts.pos[i] += amount * mVerts.normal[i];
     }
-    Initialize();
+    InvalidateBuffers(MeshBuffers::Positions);
     Update();
 }
 
 void HalfEdgeMesh::Erode(float amount) {
-    for (Vertex& v : mVerts) {
-        v.pos -= amount * v.normal;
+    for (size_t i = 0; i < GetNumVerts(); i++) {
+        mVerts.pos[i] -= amount * mVerts.normal[i];
     }
-    Initialize();
+    InvalidateBuffers(MeshBuffers::Positions);
     Update();
 }
 
 void HalfEdgeMesh::Smooth(float amount) {
-    for (Vertex& v : mVerts) {
-        v.pos -= amount * v.normal * v.curvature;
+    for (size_t i = 0; i < GetNumVerts(); i++) {
+        mVerts.pos[i] -= amount * mVerts.normal[i] * mVerts.curvature[i];
     }
-    Initialize();
+    InvalidateBuffers(MeshBuffers::Positions);
     Update();
 }
 
 void HalfEdgeMesh::Render() {
+#ifndef MOA_HEADLESS
     glEnable(GL_LIGHTING);
     glMatrixMode(GL_MODELVIEW);
 
@@ -527,43 +838,47 @@ void HalfEdgeMesh::Render() {
     }
 
     // Draw geometry
-    glBegin(GL_TRIANGLES);
-    const auto numTriangles = GetNumFaces();
-    for (size_t i = 0; i < numTriangles; i++) {
-        auto& face = f(i);
+    if (MeshBuffers::IsSupported()) {
+        DrawBuffers(mVerts, mFaces);
+    } else {
+        glBegin(GL_TRIANGLES);
+        const auto numTriangles = GetNumFaces();
+        for (size_t i = 0; i < numTriangles; i++) {
+            const FaceRef face = f(i);
 
-        auto* edge = &e(face.edge);
+            auto* edge = &e(face.edge);
 
-        auto& v1 = v(edge->vert);
-        edge = &e(edge->next);
+            const VertexRef v1 = v(edge->vert);
+            edge = &e(edge->next);
 
-        auto& v2 = v(edge->vert);
-        edge = &e(edge->next);
+            const VertexRef v2 = v(edge->vert);
+            edge = &e(edge->next);
 
-        auto& v3 = v(edge->vert);
+            const VertexRef v3 = v(edge->vert);
 
-        if (mVisualizationMode == CurvatureVertex) {
-            glColor3fv(glm::value_ptr(v1.color));
-            glNormal3fv(glm::value_ptr(v1.normal));
-            glVertex3fv(glm::value_ptr(v1.pos));
+            if (mVisualizationMode == CurvatureVertex) {
+                glColor3fv(glm::value_ptr(v1.color));
+                glNormal3fv(glm::value_ptr(v1.normal));
+                glVertex3fv(glm::value_ptr(v1.pos));
 
-            glColor3fv(glm::value_ptr(v2.color));
-            glNormal3fv(glm::value_ptr(v2.normal));
-            glVertex3fv(glm::value_ptr(v2.pos));
+                glColor3fv(glm::value_ptr(v2.color));
+                glNormal3fv(glm::value_ptr(v2.normal));
+                glVertex3fv(glm::value_ptr(v2.pos));
 
-            glColor3fv(glm::value_ptr(v3.color));
-            glNormal3fv(glm::value_ptr(v3.normal));
-            glVertex3fv(glm::value_ptr(v3.pos));
-        } else {
-            glColor3fv(glm::value_ptr(face.color));
-            glNormal3fv(glm::value_ptr(face.normal));
+                glColor3fv(glm::value_ptr(v3.color));
+                glNormal3fv(glm::value_ptr(v3.normal));
+                glVertex3fv(glm::value_ptr(v3.pos));
+            } else {
+                glColor3fv(glm::value_ptr(face.color));
+                glNormal3fv(glm::value_ptr(face.normal));
 
-            glVertex3fv(glm::value_ptr(v1.pos));
-            glVertex3fv(glm::value_ptr(v2.pos));
-            glVertex3fv(glm::value_ptr(v3.pos));
+                glVertex3fv(glm::value_ptr(v1.pos));
+                glVertex3fv(glm::value_ptr(v2.pos));
+                glVertex3fv(glm::value_ptr(v3.pos));
+            }
         }
+        glEnd();
     }
-    glEnd();
 
     // Mesh normals by courtesy of Richard Khoury
     if (mShowNormals) {
@@ -571,17 +886,17 @@ void HalfEdgeMesh::Render() {
         glBegin(GL_LINES);
         const auto numTriangles = GetNumFaces();
         for (size_t i = 0; i < numTriangles; i++) {
-            auto& face = f(i);
+            const FaceRef face = f(i);
 
             auto* edge = &e(face.edge);
 
-            auto& v1 = v(edge->vert);
+            const VertexRef v1 = v(edge->vert);
             edge = &e(edge->next);
 
-            auto& v2 = v(edge->vert);
+            const VertexRef v2 = v(edge->vert);
             edge = &e(edge->next);
 
-            auto& v3 = v(edge->vert);
+            const VertexRef v3 = v(edge->vert);
 
             auto faceStart = (v1.pos + v2.pos + v3.pos) / 3.f;
             auto faceEnd = faceStart + face.normal * 0.1f;
@@ -608,4 +923,5 @@ void HalfEdgeMesh::Render() {
     glPopMatrix();
 
     GLObject::Render();
+#endif
 }
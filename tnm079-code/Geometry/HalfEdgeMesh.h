@@ -1,11 +1,16 @@
 #pragma once
 
 #include <Geometry/Mesh.h>
+#include <Util/HashMap.h>
 #include <Util/ObjIO.h>
 #include <Util/Util.h>
+#include <Util/VertexWelder.h>
+#include <array>
 #include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
 #include <limits>
-#include <map>
 #include <set>
 
 /*! \brief A half edge triangle mesh class.
@@ -24,7 +29,7 @@ public:
     protected:
         // should not change what mesh the pointer points to, can change mesh though
         HalfEdgeMesh const* mHem;
-        mutable size_t mIndex;
+        mutable Index mIndex;
         EdgeIterator(HalfEdgeMesh const* he, size_t index) {
             mHem = he;
             // Guard against outside access
@@ -38,7 +43,7 @@ public:
             return *this;
         }
         EdgeIterator& Prev() {
-            mIndex = mHem->e(mIndex).prev;
+            mIndex = mHem->Prev(mIndex);
             return *this;
         }
         EdgeIterator& Pair() {
@@ -50,7 +55,7 @@ public:
             return *this;
         }
         const EdgeIterator& Prev() const {
-            mIndex = mHem->e(mIndex).prev;
+            mIndex = mHem->Prev(mIndex);
             return *this;
         }
         const EdgeIterator& Pair() const {
@@ -70,6 +75,18 @@ public:
     //! Adds a triangle to the mesh
     virtual bool AddFace(const std::vector<glm::vec3>& verts);
 
+    //! Replaces the mesh with an indexed face set, without welding vertices
+    virtual bool Build(const std::vector<glm::vec3>& verts, const std::vector<glm::uvec3>& tris);
+
+    //! Preallocates the mesh arrays and lookup tables for numFaces triangles
+    virtual void Reserve(size_t numFaces);
+
+    //! Sets the distance below which vertices are merged in AddFace
+    virtual void SetWeldTolerance(float tolerance);
+
+    //! Releases the vertex and edge lookup tables, they are rebuilt on demand
+    virtual void FreeLookupTables();
+
     //! Calculates the area of the mesh
     virtual float Area() const;
 
@@ -100,75 +117,331 @@ public:
     virtual void Render() override;
 
 protected:
-    enum EdgeState : size_t {
-        Uninitialized = std::numeric_limits<size_t>::max() - 1,
-        Border = std::numeric_limits<size_t>::max()
+    enum EdgeState : Index {
+        Uninitialized = std::numeric_limits<Index>::max() - 1,
+        Border = std::numeric_limits<Index>::max()
     };
 
     /*! \brief The core half-edge struct
-     *  Implements the linked data structure edge type
+     *  Implements the linked data structure edge type. All faces are
+     *  triangles, so the previous edge is not stored but found through
+     *  Prev() as next(next(e)).
      */
     struct HalfEdge {
         HalfEdge()
             : vert(EdgeState::Uninitialized)
             , face(EdgeState::Uninitialized)
             , next(EdgeState::Uninitialized)
-            , prev(EdgeState::Uninitialized)
             , pair(EdgeState::Uninitialized) {}
-        size_t vert;  //!< index into mVerts (the origin vertex)
-        size_t face;  //!< index into mFaces
-        size_t next;  //!< index into mEdges
-        size_t prev;  //!< index into mEdges
-        size_t pair;  //!< index into mEdges
+        Index vert;  //!< index into mVerts (the origin vertex)
+        Index face;  //!< index into mFaces
+        Index next;  //!< index into mEdges
+        Index pair;  //!< index into mEdges
     };
 
     /*! \brief A vertex is a point and an edge index
      */
     struct Vertex : public Mesh::Vertex {
         Vertex() : edge(EdgeState::Uninitialized) {}
-        size_t edge;  //!< index into mEdges
+        Index edge;  //!< index into mEdges
     };
 
     /*! \brief A face has a normal and an index to an edge
      */
     struct Face : public Mesh::Face {
         Face() : edge(EdgeState::Uninitialized) {}
-        size_t edge;  //!< index into mEdges
+        Index edge;  //!< index into mEdges
+    };
+
+    //! View of a vertex stored in VertexArrays
+    struct VertexRef {
+        glm::vec3& pos;
+        glm::vec3& normal;
+        glm::vec3& color;
+        float& curvature;
+        Index& edge;
+    };
+
+    //! View of a face stored in FaceArrays
+    struct FaceRef {
+        glm::vec3& normal;
+        glm::vec3& color;
+        float& curvature;
+        Index& edge;
+    };
+
+    //! Vertex attributes and the outgoing half edge of each vertex
+    struct VertexArrays : public Mesh::VertexArrays {
+        std::vector<Index> edge;
+
+        void reserve(size_t n) {
+            Mesh::VertexArrays::reserve(n);
+            edge.reserve(n);
+        }
+        void resize(size_t n) {
+            Mesh::VertexArrays::resize(n);
+            edge.resize(n, EdgeState::Uninitialized);
+        }
+        void clear() {
+            Mesh::VertexArrays::clear();
+            edge.clear();
+        }
+        void push_back(const Vertex& v) {
+            Mesh::VertexArrays::push_back(v);
+            edge.push_back(v.edge);
+        }
+        VertexRef operator[](size_t i) {
+            return VertexRef{pos[i], normal[i], color[i], curvature[i], edge[i]};
+        }
+        VertexRef at(size_t i) {
+            return VertexRef{pos.at(i), normal[i], color[i], curvature[i], edge[i]};
+        }
+        Vertex at(size_t i) const {
+            Vertex v;
+            v.pos = pos.at(i);
+            v.normal = normal[i];
+            v.color = color[i];
+            v.curvature = curvature[i];
+            v.edge = edge[i];
+            return v;
+        }
+    };
+
+    //! Face attributes and one of the half edges of each face
+    struct FaceArrays : public Mesh::FaceArrays {
+        std::vector<Index> edge;
+
+        void reserve(size_t n) {
+            Mesh::FaceArrays::reserve(n);
+            edge.reserve(n);
+        }
+        void resize(size_t n) {
+            Mesh::FaceArrays::resize(n);
+            edge.resize(n, EdgeState::Uninitialized);
+        }
+        void clear() {
+            Mesh::FaceArrays::clear();
+            edge.clear();
+        }
+        void push_back(const Face& f) {
+            Mesh::FaceArrays::push_back(f);
+            edge.push_back(f.edge);
+        }
+        FaceRef operator[](size_t i) { return FaceRef{normal[i], color[i], curvature[i], edge[i]}; }
+        FaceRef at(size_t i) { return FaceRef{normal.at(i), color[i], curvature[i], edge[i]}; }
+        Face at(size_t i) const {
+            Face f;
+            f.normal = normal.at(i);
+            f.color = color[i];
+            f.curvature = curvature[i];
+            f.edge = edge[i];
+            return f;
+        }
+    };
+
+    //! What a OneRingIterator yields for each outgoing half edge of a vertex
+    enum class RingElement { Edge, Vertex, Face };
+
+    /*! \brief Circulates the outgoing half edges of a vertex in place
+     *
+     * Interior vertices are walked counter clockwise from the vertex edge, in
+     * the same order as FindNeighborVertices. Around a border vertex the walk
+     * goes from the vertex edge to the border, and then from the vertex edge
+     * the other way to the other border, so every neighbor is still visited
+     * exactly once. The mesh must not change while iterating.
+     */
+    template <RingElement Element>
+    class OneRingIterator {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef Index value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const Index* pointer;
+        typedef Index reference;
+
+        //! The end of every ring
+        OneRingIterator()
+            : mEdges(NULL), mFirst(EdgeState::Border), mEdge(EdgeState::Border), mReverse(false) {}
+
+        OneRingIterator(const HalfEdgeMesh* mesh, Index edge)
+            : mEdges(mesh->mEdges.data()), mFirst(edge), mEdge(edge), mReverse(false) {
+            if (edge >= EdgeState::Uninitialized) {
+                mEdge = EdgeState::Border;
+            } else if (Element == RingElement::Face) {
+                SkipBorder();
+            }
+        }
+
+        //! The outgoing half edge, the vertex it points to or its face
+        Index operator*() const {
+            if (Element == RingElement::Edge) return mEdge;
+            if (Element == RingElement::Vertex) return mEdges[mEdges[mEdge].pair].vert;
+            return mEdges[mEdge].face;
+        }
+
+        OneRingIterator& operator++() {
+            Step();
+            if (Element == RingElement::Face) SkipBorder();
+            return *this;
+        }
+        OneRingIterator operator++(int) {
+            OneRingIterator it = *this;
+            ++(*this);
+            return it;
+        }
+
+        bool operator==(const OneRingIterator& it) const { return mEdge == it.mEdge; }
+        bool operator!=(const OneRingIterator& it) const { return mEdge != it.mEdge; }
+
+    protected:
+        //! Moves to the next outgoing half edge, or to the end
+        void Step() {
+            if (!mReverse) {
+                const HalfEdge& edge = mEdges[mEdge];
+                if (edge.face < EdgeState::Uninitialized) {
+                    // The previous edge of the face ends at the vertex, its pair leaves it
+                    mEdge = mEdges[mEdges[edge.next].next].pair;
+                    if (mEdge == mFirst) mEdge = EdgeState::Border;
+                    return;
+                }
+                // Reached the border, continue clockwise from the first edge
+                mReverse = true;
+                mEdge = mFirst;
+            }
+            const HalfEdge& incoming = mEdges[mEdges[mEdge].pair];
+            mEdge = incoming.face < EdgeState::Uninitialized ? incoming.next : EdgeState::Border;
+        }
+
+        //! Skips the outgoing border edges, which have no face
+        void SkipBorder() {
+            while (mEdge != EdgeState::Border && mEdges[mEdge].face >= EdgeState::Uninitialized) {
+                Step();
+            }
+        }
+
+        const HalfEdge* mEdges;
+        Index mFirst;
+        Index mEdge;
+        bool mReverse;
+    };
+
+    //! A one-ring that can be used in range based for loops
+    template <RingElement Element>
+    struct OneRing {
+        OneRingIterator<Element> first;
+        OneRingIterator<Element> begin() const { return first; }
+        OneRingIterator<Element> end() const { return OneRingIterator<Element>(); }
     };
 
+    //! The outgoing half edges of a vertex
+    OneRing<RingElement::Edge> OutgoingEdges(size_t vertexIndex) const {
+        return {OneRingIterator<RingElement::Edge>(this, mVerts.edge[vertexIndex])};
+    }
+    //! The vertices connected to a vertex
+    OneRing<RingElement::Vertex> NeighborVertices(size_t vertexIndex) const {
+        return {OneRingIterator<RingElement::Vertex>(this, mVerts.edge[vertexIndex])};
+    }
+    //! The faces around a vertex
+    OneRing<RingElement::Face> NeighborFaces(size_t vertexIndex) const {
+        return {OneRingIterator<RingElement::Face>(this, mVerts.edge[vertexIndex])};
+    }
+    //! The vertices of a face, counter clockwise
+    std::array<Index, 3> FaceVertices(size_t faceIndex) const {
+        const HalfEdge& e1 = mEdges[mFaces.edge[faceIndex]];
+        const HalfEdge& e2 = mEdges[e1.next];
+        return {{e1.vert, e2.vert, mEdges[e2.next].vert}};
+    }
+
+    virtual bool GetRenderFace(size_t faceIndex, glm::uvec3& tri) const override {
+        const std::array<Index, 3> verts = FaceVertices(faceIndex);
+        tri = glm::uvec3(verts[0], verts[1], verts[2]);
+        return true;
+    }
+
     //! The edges of the mesh
     std::vector<HalfEdge> mEdges;
     //! The vertices in the mesh
-    std::vector<Vertex> mVerts;
+    VertexArrays mVerts;
     //! The faces in the mesh
-    std::vector<Face> mFaces;
+    FaceArrays mFaces;
 
     //! A utility data structure to speed up removal of redundant vertices
-    std::map<glm::vec3, size_t, glm_vec3_comparator<float>> mUniqueVerts;
-
-    struct OrderedPair {
-        size_t p1, p2;
-        OrderedPair(size_t i1, size_t i2) {
-            p1 = std::min(i1, i2);
-            p2 = std::max(i1, i2);
-        }
-        bool operator<(const OrderedPair& rhs) const {
-            if (this->p1 < rhs.p1) {
-                return true;
-            } else if (this->p1 == rhs.p1) {
-                if (this->p2 < rhs.p2) {
-                    return true;
-                }
-            }
-            return false;
-        }
+    VertexWelder mUniqueVerts;
+
+#ifdef MESH_INDEX_64BIT
+    //! Keeps both full vertex indices, which do not fit in one 64 bit key
+    typedef PairKey EdgePairKey;
+#else
+    typedef uint64_t EdgePairKey;
+#endif
+
+    static EdgePairKey MakeEdgePairKey(size_t v1, size_t v2) {
+#ifdef MESH_INDEX_64BIT
+        return PairKey(v1, v2);
+#else
+        return PackPairKey(v1, v2);
+#endif
+    }
+
+    //! A utility data structure to speed up removal of redundant edges,
+    //! maps the vertex pair to the index of the first half edge
+    HashMap<Index, EdgePairKey> mUniqueEdgePairs;
+
+    //! Set when normals and curvature were restored from a cache, so the next
+    //! Update() does not need to recompute them
+    bool mCachedDifferentials;
+
+    /*! \brief Compressed one-ring adjacency of all vertices
+     *
+     * The outgoing half edges of vertex i are stored in
+     * edges[offsets[i]] to edges[offsets[i + 1] - 1], in OutgoingEdges order.
+     */
+    struct OneRings {
+        std::vector<Index> offsets;
+        std::vector<Index> edges;
     };
-    //! A utility data structure to speed up removal of redundant edges
-    std::map<OrderedPair, size_t> mUniqueEdgePairs;
+
+    //! The one-rings used by Update(), rebuilt after the connectivity changes
+    OneRings mOneRings;
+    bool mOneRingsValid;
+
+    /*! Builds mOneRings if the connectivity changed since the last call
+     * \param[in] collapsedVerts vertices to leave with an empty ring, or NULL
+     */
+    void BuildOneRings(const std::vector<bool>* collapsedVerts = NULL);
+
+    /*! Recomputes normals and curvature in parallel from the one-rings,
+     * skipping the vertices and faces flagged in the optional masks
+     */
+    void UpdateDifferentials(const std::vector<bool>* collapsedVerts = NULL,
+                             const std::vector<bool>* collapsedFaces = NULL);
+
+    //! Averages the normals of the faces of the outgoing half edges of a vertex
+    template <typename EdgeRange>
+    glm::vec3 OneRingNormal(const EdgeRange& edges) const;
+
+    //! Computes the curvature at a vertex from the faces of its outgoing half edges
+    template <typename EdgeRange>
+    float OneRingCurvature(size_t vertexIndex, const EdgeRange& edges) const;
+
+    //! Copies the vertex normals and curvature from a cache, if present
+    bool RestoreCachedDifferentials(const MeshCache& cache);
+
+    //! Writes the given arrays as a mesh cache, see SaveCache()
+    static bool WriteCache(std::ostream& os, const VertexArrays& verts, const FaceArrays& faces,
+                           const std::vector<HalfEdge>& edges);
+
+    //! Rebuilds the vertex lookup table if it has been freed
+    void RebuildVertexLookup();
+    //! Rebuilds the edge lookup table if it has been freed
+    void RebuildEdgeLookup();
 
     //! Adds a vertex to the mesh
     virtual size_t AddVertex(const glm::vec3& v) override;
 
+    //! Adds a triangle between three existing vertices
+    void AddIndexedFace(size_t index1, size_t index2, size_t index3);
+
     //! Adds a half edge pair, from vertex 1 to vertex 2, to the mesh
     std::pair<size_t, size_t> AddHalfEdgePair(size_t v1, size_t v2);
 
@@ -184,11 +457,16 @@ protected:
     //! Return the edge at index i
     HalfEdge& e(size_t i) { return mEdges.at(i); }
     const HalfEdge& e(size_t i) const { return mEdges.at(i); }
-    //! Return the face at index i
-    Face& f(size_t i) { return mFaces.at(i); }
-    const Face& f(size_t i) const { return mFaces.at(i); }
-    //! Return the Vertex at index i
-    Vertex& v(size_t i) { return mVerts.at(i); }
+    //! Return the edge before edge i in its face, or the EdgeState of a border edge
+    Index Prev(size_t i) const {
+        const Index next = mEdges[i].next;
+        return next < EdgeState::Uninitialized ? mEdges[next].next : next;
+    }
+    //! Return a view of the face at index i
+    FaceRef f(size_t i) { return mFaces.at(i); }
+    const Face f(size_t i) const { return mFaces.at(i); }
+    //! Return a view of the Vertex at index i
+    VertexRef v(size_t i) { return mVerts.at(i); }
     const Vertex v(size_t i) const { return mVerts.at(i); }
     //! Return number of vertices
     size_t GetNumVerts() const { return mVerts.size(); }
@@ -202,21 +480,26 @@ protected:
     virtual void Smooth(float amount);
 
     virtual bool save(std::ostream& os) {
-        os << "# HalfEdgeMesh obj streamer\n# M&A 2008\n\n";
-        os << "# Vertices\n";
+        ObjWriter writer(os);
+        writer.Comment("HalfEdgeMesh obj streamer");
+        writer.Comment("M&A 2008");
         for (size_t i = 0; i < GetNumVerts(); i++) {
-            os << "v " << v(i).pos[0] << " " << v(i).pos[1] << " " << v(i).pos[2] << "\n";
+            writer.AddVertex(v(i).pos);
         }
-        os << "\n# Faces\n";
         for (size_t i = 0; i < GetNumFaces(); i++) {
             size_t ind = f(i).edge;
-            os << "f ";
-            os << e(ind).vert + 1 << " ";
+            const size_t v1 = e(ind).vert;
             ind = e(ind).next;
-            os << e(ind).vert + 1 << " ";
+            const size_t v2 = e(ind).vert;
             ind = e(ind).next;
-            os << e(ind).vert + 1 << "\n";
+            writer.AddFace(v1, v2, e(ind).vert);
         }
-        return os.good();
+        return writer.Flush();
     }
+
+    //! Writes positions, triangles, half edges, vertex normals and curvature
+    virtual bool SaveCache(std::ostream& os);
+
+    //! Restores the half edges directly if the cache has them
+    virtual bool LoadCache(const MeshCache& cache);
 };
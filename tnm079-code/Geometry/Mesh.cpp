@@ -13,11 +13,188 @@
  *
  *************************************************************************************************/
 #include <Geometry/Mesh.h>
+#include <GUI/MeshBuffers.h>
+#include <Util/MeshCache.h>
 #include <iostream>
+#include <limits>
 
 const Mesh::VisualizationMode Mesh::CurvatureVertex = NewVisualizationMode("Vertex curvature");
 const Mesh::VisualizationMode Mesh::CurvatureFace = NewVisualizationMode("Face curvature");
 
+Mesh::Mesh()
+    : mVisualizeNormals(false), mBuffers(NULL), mBufferedMode(std::numeric_limits<size_t>::max()) {
+    mVisualizationMode = CurvatureFace;
+}
+
+Mesh::Mesh(const Mesh& mesh)
+    : Geometry(mesh),
+      mVisualizeNormals(mesh.mVisualizeNormals),
+      mBuffers(NULL),
+      mBufferedMode(std::numeric_limits<size_t>::max()) {}
+
+Mesh& Mesh::operator=(const Mesh& mesh) {
+    if (this != &mesh) {
+        Geometry::operator=(mesh);
+        mVisualizeNormals = mesh.mVisualizeNormals;
+        InvalidateBuffers();
+    }
+    return *this;
+}
+
+Mesh::~Mesh() {
+    // Headless builds never create the buffers and do not link them
+#ifndef MOA_HEADLESS
+    delete mBuffers;
+#endif
+}
+
+void Mesh::InvalidateBuffers(unsigned int attributes) {
+    if (mBuffers != NULL) {
+        mBuffers->Invalidate(attributes);
+    }
+}
+
+bool Mesh::Build(const std::vector<glm::vec3>& verts, const std::vector<glm::uvec3>& tris) {
+    if (!ValidIndices(verts.size(), tris)) {
+        return false;
+    }
+
+    // Fallback for meshes without an indexed build path, appends to the current faces
+    Reserve(tris.size());
+    std::vector<glm::vec3> face(3);
+    for (const glm::uvec3& tri : tris) {
+        face[0] = verts[tri[0]];
+        face[1] = verts[tri[1]];
+        face[2] = verts[tri[2]];
+        AddFace(face);
+    }
+    return true;
+}
+
+bool Mesh::SaveCache(std::ostream& os) {
+    std::cerr << "Error: " << GetTypeName() << " can not be saved as a mesh cache" << std::endl;
+    return false;
+}
+
+bool Mesh::LoadCache(const MeshCache& cache) {
+    // Meshes without their own cache layout are built from the index buffer
+    const std::vector<glm::vec3> verts(cache.GetPositions(),
+                                       cache.GetPositions() + cache.GetNumVerts());
+    const std::vector<glm::uvec3> tris(cache.GetTris(), cache.GetTris() + cache.GetNumFaces());
+    return Build(verts, tris);
+}
+
+bool Mesh::ValidIndices(size_t numVerts, const std::vector<glm::uvec3>& tris) {
+    for (const glm::uvec3& tri : tris) {
+        if (tri[0] >= numVerts || tri[1] >= numVerts || tri[2] >= numVerts) {
+            std::cerr << "Error: triangle references a vertex out of range" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t Mesh::MapReferencedVertices(size_t numVerts, const std::vector<glm::uvec3>& tris,
+                                   std::vector<size_t>& map) {
+    const size_t unreferenced = std::numeric_limits<size_t>::max();
+    map.assign(numVerts, unreferenced);
+    for (const glm::uvec3& tri : tris) {
+        map[tri[0]] = map[tri[1]] = map[tri[2]] = 0;
+    }
+
+    // Keep the original order of the referenced vertices
+    size_t numReferenced = 0;
+    for (size_t& ind : map) {
+        if (ind != unreferenced) ind = numReferenced++;
+    }
+    return numReferenced;
+}
+
+void Mesh::DrawBuffers(const VertexArrays& verts, const FaceArrays& faces, float opacity) {
+#ifndef MOA_HEADLESS
+    if (mBuffers == NULL) {
+        mBuffers = new MeshBuffers();
+    }
+
+    // The two modes lay out the buffers differently
+    if (mBufferedMode != mVisualizationMode.GetID()) {
+        mBuffers->Invalidate();
+        mBufferedMode = mVisualizationMode.GetID();
+    }
+
+    if (mVisualizationMode == CurvatureVertex) {
+        if (mBuffers->IsDirty(MeshBuffers::Indices)) {
+            std::vector<uint32_t> indices;
+            indices.reserve(3 * faces.size());
+            glm::uvec3 tri;
+            for (size_t i = 0; i < faces.size(); i++) {
+                if (GetRenderFace(i, tri)) {
+                    indices.insert(indices.end(), {tri[0], tri[1], tri[2]});
+                }
+            }
+            // An empty index buffer would draw the vertices unindexed
+            if (indices.empty()) {
+                return;
+            }
+            mBuffers->Upload(indices);
+        }
+        if (mBuffers->IsDirty(MeshBuffers::Positions)) {
+            mBuffers->Upload(MeshBuffers::Positions, verts.pos);
+        }
+        if (mBuffers->IsDirty(MeshBuffers::Normals)) {
+            mBuffers->Upload(MeshBuffers::Normals, verts.normal);
+        }
+        if (mBuffers->IsDirty(MeshBuffers::Colors)) {
+            mBuffers->Upload(MeshBuffers::Colors, verts.color);
+        }
+    } else if (mBuffers->IsDirty(MeshBuffers::All)) {
+        // A changed face set changes the number of corners in every array
+        if (mBuffers->IsDirty(MeshBuffers::Indices)) {
+            mBuffers->Invalidate();
+            mBuffers->Upload(std::vector<uint32_t>());
+        }
+
+        std::vector<glm::uvec3> tris;
+        std::vector<size_t> faceIndices;
+        tris.reserve(faces.size());
+        faceIndices.reserve(faces.size());
+        glm::uvec3 tri;
+        for (size_t i = 0; i < faces.size(); i++) {
+            if (GetRenderFace(i, tri)) {
+                tris.push_back(tri);
+                faceIndices.push_back(i);
+            }
+        }
+
+        std::vector<glm::vec3> corners(3 * tris.size());
+        if (mBuffers->IsDirty(MeshBuffers::Positions)) {
+            for (size_t i = 0; i < tris.size(); i++) {
+                for (size_t c = 0; c < 3; c++) {
+                    corners[3 * i + c] = verts.pos[tris[i][c]];
+                }
+            }
+            mBuffers->Upload(MeshBuffers::Positions, corners);
+        }
+        if (mBuffers->IsDirty(MeshBuffers::Normals)) {
+            for (size_t i = 0; i < tris.size(); i++) {
+                corners[3 * i] = corners[3 * i + 1] = corners[3 * i + 2] =
+                    faces.normal[faceIndices[i]];
+            }
+            mBuffers->Upload(MeshBuffers::Normals, corners);
+        }
+        if (mBuffers->IsDirty(MeshBuffers::Colors)) {
+            for (size_t i = 0; i < tris.size(); i++) {
+                corners[3 * i] = corners[3 * i + 1] = corners[3 * i + 2] =
+                    faces.color[faceIndices[i]];
+            }
+            mBuffers->Upload(MeshBuffers::Colors, corners);
+        }
+    }
+
+    mBuffers->Draw(GL_TRIANGLES, opacity);
+#endif
+}
+
 float Mesh::Area() const {
     std::cerr << "Error: area() not implemented for this Mesh" << std::endl;
     return -1;
@@ -1,8 +1,13 @@
 #pragma once
 
+#include <cstdint>
+#include <limits>
 #include <vector>
 #include <Geometry/Geometry.h>
 
+class MeshBuffers;
+class MeshCache;
+
 class Mesh : public Geometry {
 public:
     static const VisualizationMode CurvatureVertex;
@@ -17,6 +22,12 @@ public:
 
     virtual bool save(std::ostream& os) = 0;
 
+    //! Writes the mesh in the binary MeshCache format
+    virtual bool SaveCache(std::ostream& os);
+
+    //! Replaces the mesh with the contents of a mapped MeshCache file
+    virtual bool LoadCache(const MeshCache& cache);
+
 protected:
     //! Adds a vertex to the mesh
     virtual size_t AddVertex(const glm::vec3& v) = 0;
@@ -41,9 +52,31 @@ protected:
     //! Compute and return the normal at vertex at vertexIndex
     virtual glm::vec3 VertexNormal(size_t vertexIndex) const = 0;
 
+    /*! Numbers the vertices referenced by an indexed face set consecutively, so
+     * unreferenced vertices can be dropped when building a mesh from it
+     * \param[in] numVerts the number of vertices in the face set
+     * \param[in] tris the triangles as indices into the vertices
+     * \param[out] map the new index of each vertex, or max() if unreferenced
+     * \return the number of referenced vertices
+     */
+    static size_t MapReferencedVertices(size_t numVerts, const std::vector<glm::uvec3>& tris,
+                                        std::vector<size_t>& map);
+
+    //! Checks that all triangles reference vertices in [0, numVerts)
+    static bool ValidIndices(size_t numVerts, const std::vector<glm::uvec3>& tris);
+
     bool mVisualizeNormals;
 
 public:
+#ifdef MESH_INDEX_64BIT
+    //! Index type of the mesh connectivity
+    typedef uint64_t Index;
+#else
+    //! Index type of the mesh connectivity, meshes are limited to 2^32 - 2 elements.
+    //! Define MESH_INDEX_64BIT for larger meshes.
+    typedef uint32_t Index;
+#endif
+
     //! Minimal requirements for all meshes, inherited
     struct Face {
         Face(const glm::vec3& n = glm::vec3(0.f, 0.f, 0.f),
@@ -65,12 +98,123 @@ public:
         float curvature;
     };
 
-    Mesh() : mVisualizeNormals(false) { mVisualizationMode = CurvatureFace; }
-    virtual ~Mesh() {}
+    /*! \brief Vertex attributes stored as one contiguous array per attribute
+     *
+     * Kernels that only need positions, like Area() and Volume(), then stream
+     * through 12 bytes per vertex instead of dragging the other attributes
+     * through the cache.
+     */
+    struct VertexArrays {
+        std::vector<glm::vec3> pos;
+        std::vector<glm::vec3> normal;
+        std::vector<glm::vec3> color;
+        std::vector<float> curvature;
+
+        size_t size() const { return pos.size(); }
+        bool empty() const { return pos.empty(); }
+        void reserve(size_t n) {
+            pos.reserve(n);
+            normal.reserve(n);
+            color.reserve(n);
+            curvature.reserve(n);
+        }
+        void resize(size_t n) {
+            const Vertex def;
+            pos.resize(n, def.pos);
+            normal.resize(n, def.normal);
+            color.resize(n, def.color);
+            curvature.resize(n, def.curvature);
+        }
+        void clear() {
+            pos.clear();
+            normal.clear();
+            color.clear();
+            curvature.clear();
+        }
+        void push_back(const Vertex& v) {
+            pos.push_back(v.pos);
+            normal.push_back(v.normal);
+            color.push_back(v.color);
+            curvature.push_back(v.curvature);
+        }
+    };
+
+    //! Face attributes stored as one contiguous array per attribute
+    struct FaceArrays {
+        std::vector<glm::vec3> normal;
+        std::vector<glm::vec3> color;
+        std::vector<float> curvature;
+
+        size_t size() const { return normal.size(); }
+        bool empty() const { return normal.empty(); }
+        void reserve(size_t n) {
+            normal.reserve(n);
+            color.reserve(n);
+            curvature.reserve(n);
+        }
+        void resize(size_t n) {
+            const Face def;
+            normal.resize(n, def.normal);
+            color.resize(n, def.color);
+            curvature.resize(n, def.curvature);
+        }
+        void clear() {
+            normal.clear();
+            color.clear();
+            curvature.clear();
+        }
+        void push_back(const Face& f) {
+            normal.push_back(f.normal);
+            color.push_back(f.color);
+            curvature.push_back(f.curvature);
+        }
+    };
+
+protected:
+    //! The mesh in GPU memory, created by the first DrawBuffers()
+    MeshBuffers* mBuffers;
+    //! Visualization mode the buffers were filled for
+    size_t mBufferedMode;
+
+    //! Marks MeshBuffers attributes that changed, all by default. Subclasses call it for
+    //! the attributes they modify.
+    void InvalidateBuffers(unsigned int attributes = ~0u);
+
+    //! Gets the vertices of a face, returns false for faces that should not be drawn
+    virtual bool GetRenderFace(size_t faceIndex, glm::uvec3& tri) const = 0;
+
+    /*! Uploads the attributes that changed since the last call and draws the
+     * triangles from the buffers. Vertex curvature mode shares vertices through an
+     * index buffer, face curvature mode needs the face attributes per corner.
+     */
+    void DrawBuffers(const VertexArrays& verts, const FaceArrays& faces, float opacity = 1.f);
+
+public:
+    Mesh();
+    //! Copies start without buffers, the GL buffers are never shared
+    Mesh(const Mesh& mesh);
+    Mesh& operator=(const Mesh& mesh);
+    virtual ~Mesh();
 
     //! Adds a face to the mesh.
     virtual bool AddFace(const std::vector<glm::vec3>& verts) = 0;
 
+    /*! Replaces the mesh with the triangles in an indexed face set. The vertices
+     * are used as is, no coordinate welding is performed. Meshes without their own
+     * indexed path fall back to appending the triangles with AddFace(), which keeps
+     * the faces already in the mesh and welds as AddFace() does.
+     */
+    virtual bool Build(const std::vector<glm::vec3>& verts, const std::vector<glm::uvec3>& tris);
+
+    //! Preallocates storage before adding numFaces faces
+    virtual void Reserve(size_t numFaces) {}
+
+    //! Sets the distance below which vertices are merged when adding faces
+    virtual void SetWeldTolerance(float tolerance) {}
+
+    //! Releases the lookup tables used while adding faces
+    virtual void FreeLookupTables() {}
+
     //! Compute area of mesh
     virtual float Area() const;
     //! Compute volume of mesh
@@ -13,12 +13,14 @@
  *
  *************************************************************************************************/
 #include <Geometry/SimpleMesh.h>
+#include <GUI/MeshBuffers.h>
 #include <Util/ColorMap.h>
+#include <Util/MeshCache.h>
 #include <glm.hpp>
 #include <gtc/type_ptr.hpp>
 
 //-----------------------------------------------------------------------------
-SimpleMesh::SimpleMesh() {}
+SimpleMesh::SimpleMesh() : mIncidenceValid(false) {}
 
 //-----------------------------------------------------------------------------
 SimpleMesh::~SimpleMesh() {}
@@ -31,22 +33,30 @@ bool SimpleMesh::AddFace(const std::vector<glm::vec3>& verts) {
 
     Face tri(ind1, ind2, ind3);
     mFaces.push_back(tri);
+    mIncidenceValid = false;
+    InvalidateBuffers();
     // Compute and assign a normal
-    mFaces.back().normal = FaceNormal(mFaces.size() - 1);
+    mFaces.normal.back() = FaceNormal(mFaces.size() - 1);
 
     return true;
 }
 
 //-----------------------------------------------------------------------------
 size_t SimpleMesh::AddVertex(const glm::vec3& v) {
-    std::map<glm::vec3, size_t>::iterator it = mUniqueVerts.find(v);
-    if (it != mUniqueVerts.end()) {
-        const auto indx = it->second;
-        return indx;
+    // Rebuild the lookup table if it has been freed
+    if (mUniqueVerts.size() == 0 && !mVerts.empty()) {
+        mUniqueVerts.reserve(mVerts.size());
+        for (size_t i = 0; i < mVerts.size(); i++) {
+            mUniqueVerts.insert(mVerts.pos[i], i);
+        }
     }
 
     const auto indx = mVerts.size();
-    mUniqueVerts[v] = indx;  // op. [ ] constructs a new entry in map
+    std::pair<size_t, bool> welded = mUniqueVerts.insert(v, indx);
+    if (!welded.second) {
+        return welded.first;
+    }
+
     Vertex vert;
     vert.pos = v;
     mVerts.push_back(vert);
@@ -54,11 +64,100 @@ size_t SimpleMesh::AddVertex(const glm::vec3& v) {
     return indx;
 }
 
+//-----------------------------------------------------------------------------
+bool SimpleMesh::Build(const std::vector<glm::vec3>& verts, const std::vector<glm::uvec3>& tris) {
+    if (!ValidIndices(verts.size(), tris)) {
+        return false;
+    }
+
+    // Drop unreferenced vertices, they have no neighborhood
+    std::vector<size_t> map;
+    const size_t numVerts = MapReferencedVertices(verts.size(), tris, map);
+
+    FreeLookupTables();
+    mVerts.clear();
+    mVerts.resize(numVerts);
+    for (size_t i = 0; i < verts.size(); i++) {
+        if (map[i] < numVerts) mVerts.pos[map[i]] = verts[i];
+    }
+
+    mFaces.clear();
+    mFaces.reserve(tris.size());
+    mIncidenceValid = false;
+    InvalidateBuffers();
+    for (const glm::uvec3& tri : tris) {
+        mFaces.push_back(Face(map[tri[0]], map[tri[1]], map[tri[2]]));
+        mFaces.normal.back() = FaceNormal(mFaces.size() - 1);
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+bool SimpleMesh::SaveCache(std::ostream& os) {
+    std::vector<glm::uvec3> tris(mFaces.size());
+    for (size_t i = 0; i < mFaces.size(); i++) {
+        const Triangle& tri = mFaces.verts[i];
+        tris[i] = glm::uvec3(tri.v1, tri.v2, tri.v3);
+    }
+
+    MeshCache::Data data;
+    data.numVerts = mVerts.size();
+    data.numFaces = mFaces.size();
+    data.positions = mVerts.pos.data();
+    data.tris = tris.data();
+    data.normals = mVerts.normal.data();
+    data.curvature = mVerts.curvature.data();
+    return MeshCache::Write(os, data);
+}
+
+//-----------------------------------------------------------------------------
+void SimpleMesh::Reserve(size_t numFaces) {
+    mFaces.reserve(numFaces);
+    mVerts.reserve(numFaces / 2 + 2);
+    mUniqueVerts.reserve(numFaces / 2 + 2);
+}
+
+//-----------------------------------------------------------------------------
+void SimpleMesh::SetWeldTolerance(float tolerance) { mUniqueVerts.SetTolerance(tolerance); }
+
+//-----------------------------------------------------------------------------
+void SimpleMesh::FreeLookupTables() { mUniqueVerts.clear(); }
+
+//-----------------------------------------------------------------------------
+void SimpleMesh::BuildIncidence() const {
+    if (mIncidenceValid && mIncidence.offsets.size() == mVerts.size() + 1) {
+        return;
+    }
+
+    // Count the faces of each vertex, then turn the counts into offsets
+    std::vector<Index>& offsets = mIncidence.offsets;
+    offsets.assign(mVerts.size() + 1, 0);
+    for (const Triangle& tri : mFaces.verts) {
+        offsets[tri.v1 + 1]++;
+        offsets[tri.v2 + 1]++;
+        offsets[tri.v3 + 1]++;
+    }
+    for (size_t i = 0; i < mVerts.size(); i++) {
+        offsets[i + 1] += offsets[i];
+    }
+
+    // Fill in face order, so every list ends up sorted
+    std::vector<Index> fill(offsets.begin(), offsets.end() - 1);
+    mIncidence.faces.resize(offsets.back());
+    for (size_t i = 0; i < mFaces.size(); i++) {
+        const Triangle& tri = mFaces.verts[i];
+        mIncidence.faces[fill[tri.v1]++] = i;
+        mIncidence.faces[fill[tri.v2]++] = i;
+        mIncidence.faces[fill[tri.v3]++] = i;
+    }
+    mIncidenceValid = true;
+}
+
 //-----------------------------------------------------------------------------
 glm::vec3 SimpleMesh::FaceNormal(size_t faceIndex) const {
-    const Face& tri = mFaces.at(faceIndex);
-    glm::vec3 e1 = mVerts.at(tri.v2).pos - mVerts.at(tri.v1).pos;
-    glm::vec3 e2 = mVerts.at(tri.v3).pos - mVerts.at(tri.v1).pos;
+    const Triangle& tri = mFaces.verts.at(faceIndex);
+    glm::vec3 e1 = mVerts.pos.at(tri.v2) - mVerts.pos.at(tri.v1);
+    glm::vec3 e2 = mVerts.pos.at(tri.v3) - mVerts.pos.at(tri.v1);
     return glm::normalize(glm::cross(e1, e2));
 }
 //-----------------------------------------------------------------------------
@@ -68,10 +167,8 @@ glm::vec3 SimpleMesh::VertexNormal(size_t vertexIndex) const {
     glm::vec3 n(0.f, 0.f, 0.f);
 
     for (size_t i = 0; i < neighborFaces.size(); i++) {
-        const Face& triangle = mFaces.at(neighborFaces.at(i));
-
         // NB Assumes face normals already calculated
-        n += triangle.normal;
+        n += mFaces.normal.at(neighborFaces.at(i));
     }
     n = glm::normalize(n);
     return n;
@@ -83,7 +180,7 @@ float SimpleMesh::VertexCurvature(size_t vertexIndex) const {
     assert(oneRing.size() != 0);
 
     size_t curr, next;
-    const glm::vec3& vi = mVerts.at(vertexIndex).pos;
+    const glm::vec3& vi = mVerts.pos.at(vertexIndex);
     float angleSum = 0.f;
     float area = 0.f;
     for (size_t i = 0; i < oneRing.size(); i++) {
@@ -97,8 +194,8 @@ float SimpleMesh::VertexCurvature(size_t vertexIndex) const {
 
         // find vertices in 1-ring according to figure 5 in lab text
         // next - beta
-        const glm::vec3& nextPos = mVerts.at(next).pos;
-        const glm::vec3& vj = mVerts.at(curr).pos;
+        const glm::vec3& nextPos = mVerts.pos.at(next);
+        const glm::vec3& vj = mVerts.pos.at(curr);
 
         // compute angle and area
         angleSum += acos(glm::dot(vj - vi, nextPos - vi) /
@@ -110,9 +207,9 @@ float SimpleMesh::VertexCurvature(size_t vertexIndex) const {
 
 float SimpleMesh::FaceCurvature(size_t faceIndex) const {
     // NB Assumes vertex curvature already computed
-    const Face& tri = mFaces.at(faceIndex);
-    return (mVerts.at(tri.v1).curvature + mVerts.at(tri.v2).curvature +
-            mVerts.at(tri.v3).curvature) /
+    const Triangle& tri = mFaces.verts.at(faceIndex);
+    return (mVerts.curvature.at(tri.v1) + mVerts.curvature.at(tri.v2) +
+            mVerts.curvature.at(tri.v3)) /
            3.f;
 }
 
@@ -126,25 +223,25 @@ std::vector<size_t> SimpleMesh::FindNeighborVertices(size_t vertexIndex) const {
     size_t currVert;
 
     // pick next counter clock wise vert
-    if (mFaces.at(neighborFaces.at(0)).v1 == vertexIndex) {
-        currVert = mFaces.at(neighborFaces.at(0)).v2;
+    if (mFaces.verts.at(neighborFaces.at(0)).v1 == vertexIndex) {
+        currVert = mFaces.verts.at(neighborFaces.at(0)).v2;
     }
-    if (mFaces.at(neighborFaces.at(0)).v2 == vertexIndex) {
-        currVert = mFaces.at(neighborFaces.at(0)).v3;
+    if (mFaces.verts.at(neighborFaces.at(0)).v2 == vertexIndex) {
+        currVert = mFaces.verts.at(neighborFaces.at(0)).v3;
     }
-    if (mFaces.at(neighborFaces.at(0)).v3 == vertexIndex) {
-        currVert = mFaces.at(neighborFaces.at(0)).v1;
+    if (mFaces.verts.at(neighborFaces.at(0)).v3 == vertexIndex) {
+        currVert = mFaces.verts.at(neighborFaces.at(0)).v1;
     }
     oneRing.push_back(currVert);
 
     // collect one ring vertices
     for (size_t i = 0; i < neighborFaces.size() - 1; i++) {
-        if (mFaces.at(neighborFaces.at(i)).v1 == currVert) {
-            currVert = mFaces.at(neighborFaces.at(i)).v2;
-        } else if (mFaces.at(neighborFaces.at(i)).v2 == currVert) {
-            currVert = mFaces.at(neighborFaces.at(i)).v3;
-        } else if (mFaces.at(neighborFaces.at(i)).v3 == currVert) {
-            currVert = mFaces.at(neighborFaces.at(i)).v1;
+        if (mFaces.verts.at(neighborFaces.at(i)).v1 == currVert) {
+            currVert = mFaces.verts.at(neighborFaces.at(i)).v2;
+        } else if (mFaces.verts.at(neighborFaces.at(i)).v2 == currVert) {
+            currVert = mFaces.verts.at(neighborFaces.at(i)).v3;
+        } else if (mFaces.verts.at(neighborFaces.at(i)).v3 == currVert) {
+            currVert = mFaces.verts.at(neighborFaces.at(i)).v1;
         }
         oneRing.push_back(currVert);
     }
@@ -156,21 +253,17 @@ std::vector<size_t> SimpleMesh::FindNeighborVertices(size_t vertexIndex) const {
  * \return a vector containing the indices to all the found faces.
  */
 std::vector<size_t> SimpleMesh::FindNeighborFaces(size_t vertexIndex) const {
-    std::vector<size_t> foundFaces;
-
     // Find other triangles that include this vertex
-    for (size_t i = 0; i < mFaces.size(); ++i) {
-        const Face& face = mFaces[i];
-        if (face.v1 == vertexIndex || face.v2 == vertexIndex || face.v3 == vertexIndex) {
-            foundFaces.push_back(i);
-        }
-    }
+    BuildIncidence();
+    const Index* incident = mIncidence.faces.data();
+    std::vector<size_t> foundFaces(incident + mIncidence.offsets.at(vertexIndex),
+                                   incident + mIncidence.offsets.at(vertexIndex + 1));
 
     // Pick prev vertex
     size_t currVertex = 0;
-    const size_t v1 = mFaces.at(foundFaces.at(0)).v1;
-    const size_t v2 = mFaces.at(foundFaces.at(0)).v2;
-    const size_t v3 = mFaces.at(foundFaces.at(0)).v3;
+    const size_t v1 = mFaces.verts.at(foundFaces.at(0)).v1;
+    const size_t v2 = mFaces.verts.at(foundFaces.at(0)).v2;
+    const size_t v3 = mFaces.verts.at(foundFaces.at(0)).v3;
     if (vertexIndex == v1)
         currVertex = v3;
     else if (vertexIndex == v2)
@@ -180,23 +273,23 @@ std::vector<size_t> SimpleMesh::FindNeighborFaces(size_t vertexIndex) const {
 
     for (size_t i = 1; i < foundFaces.size() - 1; i++) {
         for (size_t j = i; j < foundFaces.size(); j++) {
-            if (mFaces.at(foundFaces.at(j)).v1 == currVertex) {
+            if (mFaces.verts.at(foundFaces.at(j)).v1 == currVertex) {
                 // pick the next vert
-                currVertex = mFaces.at(foundFaces.at(j)).v2;
+                currVertex = mFaces.verts.at(foundFaces.at(j)).v2;
                 // and swap
                 std::swap(foundFaces.at(i), foundFaces.at(j));
                 break;
             }
-            if (mFaces.at(foundFaces.at(j)).v2 == currVertex) {
+            if (mFaces.verts.at(foundFaces.at(j)).v2 == currVertex) {
                 // pick the next vert
-                currVertex = mFaces.at(foundFaces.at(j)).v3;
+                currVertex = mFaces.verts.at(foundFaces.at(j)).v3;
                 // and swap
                 std::swap(foundFaces.at(i), foundFaces.at(j));
                 break;
             }
-            if (mFaces.at(foundFaces.at(j)).v3 == currVertex) {
+            if (mFaces.verts.at(foundFaces.at(j)).v3 == currVertex) {
                 // pick the next vert
-                currVertex = mFaces.at(foundFaces.at(j)).v1;
+                currVertex = mFaces.verts.at(foundFaces.at(j)).v1;
                 // and swap
                 std::swap(foundFaces.at(i), foundFaces.at(j));
                 break;
@@ -209,32 +302,38 @@ std::vector<size_t> SimpleMesh::FindNeighborFaces(size_t vertexIndex) const {
 
 //-----------------------------------------------------------------------------
 void SimpleMesh::Initialize() {
+    // The mesh is complete, so the lookup table is no longer needed
+    FreeLookupTables();
+    BuildIncidence();
+
     // Calculate and store all differentials and area
+    InvalidateBuffers(MeshBuffers::Normals);
 
     // First update all face normals and triangle areas
     for (size_t i = 0; i < mFaces.size(); i++) {
-        mFaces.at(i).normal = FaceNormal(i);
+        mFaces.normal[i] = FaceNormal(i);
     }
     // Then update all vertex normals and curvature
     for (size_t i = 0; i < mVerts.size(); i++) {
         // Vertex normals are just weighted averages
-        mVerts.at(i).normal = VertexNormal(i);
+        mVerts.normal[i] = VertexNormal(i);
     }
 
     // Then update vertex curvature
     for (size_t i = 0; i < mVerts.size(); i++) {
-        mVerts.at(i).curvature = VertexCurvature(i);
-        // std::cerr <<   mVerts.at(i).curvature << "\n";
+        mVerts.curvature[i] = VertexCurvature(i);
     }
 
     // Finally update face curvature
     for (size_t i = 0; i < mFaces.size(); i++) {
-        mFaces.at(i).curvature = FaceCurvature(i);
+        mFaces.curvature[i] = FaceCurvature(i);
     }
 }
 
 //-----------------------------------------------------------------------------
 void SimpleMesh::Update() {
+    // Normals may have been written through GetVerts(), so they are uploaded again as well
+    InvalidateBuffers(MeshBuffers::Normals | MeshBuffers::Colors);
     if (!mColorMap) { return; }
 
     // Update vertex and face colors
@@ -252,17 +351,17 @@ void SimpleMesh::Update() {
                       << mMaxCMap << "]" << std::endl;
         } else {
             // Compute range from vertices
-            for (auto& vert : mVerts) {
-                if (minCurvature > vert.curvature) minCurvature = vert.curvature;
-                if (maxCurvature < vert.curvature) maxCurvature = vert.curvature;
+            for (float curvature : mVerts.curvature) {
+                if (minCurvature > curvature) minCurvature = curvature;
+                if (maxCurvature < curvature) maxCurvature = curvature;
             }
             std::cerr << "Automatic mapping of color based on vertex curvature with range ["
                       << minCurvature << "," << maxCurvature << "]" << std::endl;
             mMinCMap = minCurvature;
             mMaxCMap = maxCurvature;
         }
-        for (auto& vert : mVerts) {
-            vert.color = mColorMap->Map(vert.curvature, minCurvature, maxCurvature);
+        for (size_t i = 0; i < mVerts.size(); i++) {
+            mVerts.color[i] = mColorMap->Map(mVerts.curvature[i], minCurvature, maxCurvature);
         }
     } else if (mVisualizationMode == CurvatureFace) {
         if (!mAutoMinMax) {
@@ -270,29 +369,37 @@ void SimpleMesh::Update() {
                       << mMaxCMap << "]" << std::endl;
         } else {
             // Compute range from faces
-            for (auto& face : mFaces) {
-                if (minCurvature > face.curvature) minCurvature = face.curvature;
-                if (maxCurvature < face.curvature) maxCurvature = face.curvature;
+            for (float curvature : mFaces.curvature) {
+                if (minCurvature > curvature) minCurvature = curvature;
+                if (maxCurvature < curvature) maxCurvature = curvature;
             }
             std::cerr << "Automatic mapping of color based on face curvature with range ["
                       << minCurvature << "," << maxCurvature << "]" << std::endl;
             mMinCMap = minCurvature;
             mMaxCMap = maxCurvature;
         }
-        for (auto& face : mFaces) {
-            face.color = mColorMap->Map(face.curvature, minCurvature, maxCurvature);
+        for (size_t i = 0; i < mFaces.size(); i++) {
+            mFaces.color[i] = mColorMap->Map(mFaces.curvature[i], minCurvature, maxCurvature);
         }
     }
 }
 
 size_t SimpleMesh::Genus() const {
-    std::set<MyEdge> uniqueEdges;
-    for (const Face& face : mFaces) {
-        uniqueEdges.insert(MyEdge(face.v1, face.v2));
-        uniqueEdges.insert(MyEdge(face.v1, face.v3));
-        uniqueEdges.insert(MyEdge(face.v2, face.v3));
+    // Count each edge once, at its lower vertex, from the faces around it
+    BuildIncidence();
+    size_t E = 0;
+    std::vector<Index> higher;
+    for (size_t v = 0; v < mVerts.size(); v++) {
+        higher.clear();
+        for (Index k = mIncidence.offsets[v]; k < mIncidence.offsets[v + 1]; k++) {
+            const Triangle& face = mFaces.verts[mIncidence.faces[k]];
+            if (face.v1 > v) higher.push_back(face.v1);
+            if (face.v2 > v) higher.push_back(face.v2);
+            if (face.v3 > v) higher.push_back(face.v3);
+        }
+        std::sort(higher.begin(), higher.end());
+        E += std::unique(higher.begin(), higher.end()) - higher.begin();
     }
-    size_t E = uniqueEdges.size();
     size_t V = mVerts.size();
     size_t F = mFaces.size();
 
@@ -301,30 +408,34 @@ size_t SimpleMesh::Genus() const {
 }
 
 void SimpleMesh::Dilate(float amount) {
-    for (Vertex& v : mVerts) {
-        v.pos += amount * v.normal;
+    for (size_t i = 0; i < mVerts.size(); i++) {
+        mVerts.pos[i] += amount * mVerts.normal[i];
     }
+    InvalidateBuffers(MeshBuffers::Positions);
     Initialize();
     Update();
 }
 
 void SimpleMesh::Erode(float amount) {
-    for (Vertex& v : mVerts) {
-        v.pos -= amount * v.normal;
+    for (size_t i = 0; i < mVerts.size(); i++) {
+        mVerts.pos[i] -= amount * mVerts.normal[i];
     }
+    InvalidateBuffers(MeshBuffers::Positions);
     Initialize();
     Update();
 }
 
 void SimpleMesh::Smooth(float amount) {
-    for (Vertex& v : mVerts) {
-        v.pos -= amount * v.normal * v.curvature;
+    for (size_t i = 0; i < mVerts.size(); i++) {
+        mVerts.pos[i] -= amount * mVerts.normal[i] * mVerts.curvature[i];
     }
+    InvalidateBuffers(MeshBuffers::Positions);
     Initialize();
     Update();
 }
 
 void SimpleMesh::Render() {
+#ifndef MOA_HEADLESS
     glEnable(GL_LIGHTING);
     glMatrixMode(GL_MODELVIEW);
 
@@ -343,62 +454,68 @@ void SimpleMesh::Render() {
     }
 
     // Draw geometry
-    glBegin(GL_TRIANGLES);
-    for (const Face& triangle : mFaces) {
-        const glm::vec3& p0 = mVerts[triangle.v1].pos;
-        const glm::vec3& p1 = mVerts[triangle.v2].pos;
-        const glm::vec3& p2 = mVerts[triangle.v3].pos;
-
-        if (mVisualizationMode == CurvatureVertex) {
-            const glm::vec3& c1 = mVerts.at(triangle.v1).color;
-            glColor4f(c1[0], c1[1], c1[2], mOpacity);
-            glNormal3fv(glm::value_ptr(mVerts.at(triangle.v1).normal));
-            glVertex3fv(glm::value_ptr(p0));
-
-            const glm::vec3& c2 = mVerts.at(triangle.v2).color;
-            glColor4f(c2[0], c2[1], c2[2], mOpacity);
-            glNormal3fv(glm::value_ptr(mVerts.at(triangle.v2).normal));
-            glVertex3fv(glm::value_ptr(p1));
-
-            const glm::vec3& c3 = mVerts.at(triangle.v3).color;
-            glColor4f(c3[0], c3[1], c3[2], mOpacity);
-            glNormal3fv(glm::value_ptr(mVerts.at(triangle.v3).normal));
-            glVertex3fv(glm::value_ptr(p2));
-        } else {
-            const glm::vec3& color = triangle.color;
-            glColor4f(color[0], color[1], color[2], mOpacity);
-            glNormal3fv(glm::value_ptr(triangle.normal));
-
-            glVertex3fv(glm::value_ptr(p0));
-            glVertex3fv(glm::value_ptr(p1));
-            glVertex3fv(glm::value_ptr(p2));
+    if (MeshBuffers::IsSupported()) {
+        DrawBuffers(mVerts, mFaces, mOpacity);
+    } else {
+        glBegin(GL_TRIANGLES);
+        for (size_t i = 0; i < mFaces.size(); i++) {
+            const Triangle& triangle = mFaces.verts[i];
+            const glm::vec3& p0 = mVerts.pos[triangle.v1];
+            const glm::vec3& p1 = mVerts.pos[triangle.v2];
+            const glm::vec3& p2 = mVerts.pos[triangle.v3];
+
+            if (mVisualizationMode == CurvatureVertex) {
+                const glm::vec3& c1 = mVerts.color[triangle.v1];
+                glColor4f(c1[0], c1[1], c1[2], mOpacity);
+                glNormal3fv(glm::value_ptr(mVerts.normal[triangle.v1]));
+                glVertex3fv(glm::value_ptr(p0));
+
+                const glm::vec3& c2 = mVerts.color[triangle.v2];
+                glColor4f(c2[0], c2[1], c2[2], mOpacity);
+                glNormal3fv(glm::value_ptr(mVerts.normal[triangle.v2]));
+                glVertex3fv(glm::value_ptr(p1));
+
+                const glm::vec3& c3 = mVerts.color[triangle.v3];
+                glColor4f(c3[0], c3[1], c3[2], mOpacity);
+                glNormal3fv(glm::value_ptr(mVerts.normal[triangle.v3]));
+                glVertex3fv(glm::value_ptr(p2));
+            } else {
+                const glm::vec3& color = mFaces.color[i];
+                glColor4f(color[0], color[1], color[2], mOpacity);
+                glNormal3fv(glm::value_ptr(mFaces.normal[i]));
+
+                glVertex3fv(glm::value_ptr(p0));
+                glVertex3fv(glm::value_ptr(p1));
+                glVertex3fv(glm::value_ptr(p2));
+            }
         }
+        glEnd();
     }
-    glEnd();
 
     // Mesh normals by courtesy of Richard Khoury
     if (mShowNormals) {
         glDisable(GL_LIGHTING);
         glBegin(GL_LINES);
-        for (const Face& face : mFaces) {
-            const Vertex& v1 = mVerts.at(face.v1);
-            const Vertex& v2 = mVerts.at(face.v2);
-            const Vertex& v3 = mVerts.at(face.v3);
+        for (size_t i = 0; i < mFaces.size(); i++) {
+            const Triangle& face = mFaces.verts[i];
+            const glm::vec3& p1 = mVerts.pos[face.v1];
+            const glm::vec3& p2 = mVerts.pos[face.v2];
+            const glm::vec3& p3 = mVerts.pos[face.v3];
 
-            glm::vec3 faceStart = (v1.pos + v2.pos + v3.pos) / 3.f;
-            glm::vec3 faceEnd = faceStart + face.normal * 0.1f;
+            glm::vec3 faceStart = (p1 + p2 + p3) / 3.f;
+            glm::vec3 faceEnd = faceStart + mFaces.normal[i] * 0.1f;
 
             glColor3f(1.f, 0.f, 0.f);  // Red for face normal
             glVertex3fv(glm::value_ptr(faceStart));
             glVertex3fv(glm::value_ptr(faceEnd));
 
             glColor3f(0.f, 1.f, 0.f);  // Vertex normals in Green
-            glVertex3fv(glm::value_ptr(v1.pos));
-            glVertex3fv(glm::value_ptr(v1.pos + v1.normal * 0.1f));
-            glVertex3fv(glm::value_ptr(v2.pos));
-            glVertex3fv(glm::value_ptr(v2.pos + v2.normal * 0.1f));
-            glVertex3fv(glm::value_ptr(v3.pos));
-            glVertex3fv(glm::value_ptr(v3.pos + v3.normal * 0.1f));
+            glVertex3fv(glm::value_ptr(p1));
+            glVertex3fv(glm::value_ptr(p1 + mVerts.normal[face.v1] * 0.1f));
+            glVertex3fv(glm::value_ptr(p2));
+            glVertex3fv(glm::value_ptr(p2 + mVerts.normal[face.v2] * 0.1f));
+            glVertex3fv(glm::value_ptr(p3));
+            glVertex3fv(glm::value_ptr(p3 + mVerts.normal[face.v3] * 0.1f));
         }
         glEnd();
         glEnable(GL_LIGHTING);
@@ -412,4 +529,5 @@ void SimpleMesh::Render() {
     glPopMatrix();
 
     GLObject::Render();
+#endif
 }
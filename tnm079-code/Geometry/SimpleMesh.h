@@ -16,10 +16,13 @@
 #define __simplemesh_h__
 
 #include <Geometry/Mesh.h>
+#include <Util/ObjIO.h>
 #include <Util/Util.h>
+#include <Util/VertexWelder.h>
 #include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <cstdint>
 #include <limits>
 #include <map>
 #include <set>
@@ -41,15 +44,42 @@ struct MyEdge {
 
 class SimpleMesh : public Mesh {
 public:
+    //! The vertices of a face
+    struct Triangle {
+        Index v1, v2, v3;
+    };
+
     struct Face : public Mesh::Face {
         Face(size_t v1, size_t v2, size_t v3) : Mesh::Face(), v1(v1), v2(v2), v3(v3) {}
-        size_t v1, v2, v3;
+        Index v1, v2, v3;
     };
 
     struct Vertex : public Mesh::Vertex {
         Vertex() : Mesh::Vertex() {}
     };
 
+    //! Face attributes and the vertices of each face
+    struct FaceArrays : public Mesh::FaceArrays {
+        std::vector<Triangle> verts;
+
+        void reserve(size_t n) {
+            Mesh::FaceArrays::reserve(n);
+            verts.reserve(n);
+        }
+        void resize(size_t n) {
+            Mesh::FaceArrays::resize(n);
+            verts.resize(n);
+        }
+        void clear() {
+            Mesh::FaceArrays::clear();
+            verts.clear();
+        }
+        void push_back(const Face& f) {
+            Mesh::FaceArrays::push_back(f);
+            verts.push_back(Triangle{f.v1, f.v2, f.v3});
+        }
+    };
+
 protected:
     //! Computes a facenormal for a given face
     glm::vec3 FaceNormal(size_t faceindx) const;
@@ -57,10 +87,34 @@ protected:
     //! Computes a facenormal for a given face
     glm::vec3 VertexNormal(size_t vertexindx) const;
 
-    std::vector<Vertex> mVerts;
-    std::vector<Face> mFaces;
+    VertexArrays mVerts;
+    FaceArrays mFaces;
+
+    //! A utility data structure to speed up removal of redundant vertices
+    VertexWelder mUniqueVerts;
 
-    std::map<glm::vec3, size_t, glm_vec3_comparator<float>> mUniqueVerts;
+    /*! \brief Compressed vertex to face incidence
+     *
+     * The faces using vertex i are faces[offsets[i]] to
+     * faces[offsets[i + 1] - 1], in increasing order.
+     */
+    struct Incidence {
+        std::vector<Index> offsets;
+        std::vector<Index> faces;
+    };
+
+    //! Built on first use by the neighborhood queries, invalidated by AddFace
+    mutable Incidence mIncidence;
+    mutable bool mIncidenceValid;
+
+    //! Builds mIncidence if faces were added since it was last built
+    void BuildIncidence() const;
+
+    virtual bool GetRenderFace(size_t faceIndex, glm::uvec3& tri) const override {
+        const Triangle& face = mFaces.verts[faceIndex];
+        tri = glm::uvec3(face.v1, face.v2, face.v3);
+        return true;
+    }
 
     //! Adds a vertex to the mesh
     virtual size_t AddVertex(const glm::vec3& v) override;
@@ -88,11 +142,23 @@ public:
     //! Adds a triangle to the mesh.
     virtual bool AddFace(const std::vector<glm::vec3>& verts);
 
+    //! Replaces the mesh with an indexed face set, without welding vertices
+    virtual bool Build(const std::vector<glm::vec3>& verts, const std::vector<glm::uvec3>& tris);
+
+    //! Preallocates the mesh arrays and lookup table for numFaces triangles
+    virtual void Reserve(size_t numFaces);
+
+    //! Sets the distance below which vertices are merged in AddFace
+    virtual void SetWeldTolerance(float tolerance);
+
+    //! Releases the vertex lookup table, it is rebuilt on demand
+    virtual void FreeLookupTables();
+
     //! Access to internal vertex data
-    const std::vector<Vertex>& GetVerts() const { return mVerts; }
-    const std::vector<Face>& GetFaces() const { return mFaces; }
-    std::vector<Vertex>& GetVerts() { return mVerts; }
-    std::vector<Face>& GetFaces() { return mFaces; }
+    const VertexArrays& GetVerts() const { return mVerts; }
+    const FaceArrays& GetFaces() const { return mFaces; }
+    VertexArrays& GetVerts() { return mVerts; }
+    FaceArrays& GetFaces() { return mFaces; }
 
     virtual void Dilate(float amount);
     virtual void Erode(float amount);
@@ -103,19 +169,19 @@ public:
     virtual void Render();
 
     virtual bool save(std::ostream& os) {
-        os << "# SimpleMesh obj streamer\n# M&A 2008\n\n";
-        os << "# Vertices\n";
-        for (size_t i = 0; i < mVerts.size(); i++) {
-            os << "v " << mVerts.at(i).pos[0] << " " << mVerts.at(i).pos[1] << " "
-               << mVerts.at(i).pos[2] << "\n";
+        ObjWriter writer(os);
+        writer.Comment("SimpleMesh obj streamer");
+        writer.Comment("M&A 2008");
+        for (const glm::vec3& pos : mVerts.pos) {
+            writer.AddVertex(pos);
         }
-        os << "\n# Faces\n";
-        for (size_t i = 0; i < mFaces.size(); i++) {
-            os << "f " << mFaces.at(i).v1 + 1 << " " << mFaces.at(i).v2 + 1 << " "
-               << mFaces.at(i).v3 + 1 << "\n";
+        for (const Triangle& tri : mFaces.verts) {
+            writer.AddFace(tri.v1, tri.v2, tri.v3);
         }
-        return os.good();
+        return writer.Flush();
     }
+
+    virtual bool SaveCache(std::ostream& os);
 };
 
 #endif
@@ -11,23 +11,106 @@
  *************************************************************************************************/
 
 #include "Subdivision/AdaptiveLoopSubdivisionMesh.h"
+#include "GUI/GLCamera.h"
+#include "Util/Parallel.h"
+#include <algorithm>
+
+namespace {
+
+//! The corners of a face in world coordinates
+std::array<glm::vec3, 3> WorldCorners(const AdaptiveLoopSubdivisionMesh& mesh, size_t faceIndex) {
+    std::array<glm::vec3, 3> corners = mesh.GetFaceCorners(faceIndex);
+    for (glm::vec3& corner : corners) {
+        corner = glm::vec3(mesh.GetTransform() * glm::vec4(corner, 1.f));
+    }
+    return corners;
+}
+
+float LongestEdge(const std::array<glm::vec3, 3>& corners) {
+    return std::max(std::max(glm::length(corners[1] - corners[0]),
+                             glm::length(corners[2] - corners[1])),
+                    glm::length(corners[0] - corners[2]));
+}
+
+}  // namespace
+
+float AdaptiveLoopSubdivisionMesh::CurvatureCriterion::Priority(
+    const AdaptiveLoopSubdivisionMesh& mesh, size_t faceIndex) const {
+    // Curvature times length approximates the angle the face spans, which unlike the
+    // curvature alone goes down as the face is refined
+    const float curvature = std::abs(mesh.FaceCurvature(faceIndex));
+    return curvature * LongestEdge(mesh.GetFaceCorners(faceIndex)) / mTolerance;
+}
+
+AdaptiveLoopSubdivisionMesh::ScreenSpaceCriterion::ScreenSpaceCriterion(const GLCamera& camera,
+                                                                        float maxPixels)
+    : mCamera(camera)
+    , mMaxPixels(maxPixels)
+    , mPixelsPerUnit(0.f)
+    , mLastPosition(camera.GetScenePosition()) {
+    mPixelsPerUnit = currentPixelsPerUnit();
+}
+
+float AdaptiveLoopSubdivisionMesh::ScreenSpaceCriterion::Priority(
+    const AdaptiveLoopSubdivisionMesh& mesh, size_t faceIndex) const {
+    const std::array<glm::vec3, 3> corners = WorldCorners(mesh, faceIndex);
+    const glm::vec3 centroid = (corners[0] + corners[1] + corners[2]) / 3.f;
+    // Faces at the camera are as large as at the near plane of the viewer
+    const float distance = std::max(glm::length(centroid - mLastPosition), 0.1f);
+    return LongestEdge(corners) / distance * mPixelsPerUnit / mMaxPixels;
+}
+
+bool AdaptiveLoopSubdivisionMesh::ScreenSpaceCriterion::Changed() {
+    const glm::vec3 position = mCamera.GetScenePosition();
+    const float pixelsPerUnit = currentPixelsPerUnit();
+    if (position == mLastPosition && pixelsPerUnit == mPixelsPerUnit) return false;
+    mLastPosition = position;
+    mPixelsPerUnit = pixelsPerUnit;
+    return true;
+}
+
+/*! The projection scales y by cot(fovy / 2) to the range -1 to 1, which covers the
+ * height of the viewport
+ */
+float AdaptiveLoopSubdivisionMesh::ScreenSpaceCriterion::currentPixelsPerUnit() const {
+    GLint viewport[4] = {0, 0, 0, 0};
+    GLfloat projection[16] = {0.f};
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glGetFloatv(GL_PROJECTION_MATRIX, projection);
+    // Without a context there is no viewport
+    if (viewport[3] <= 0 || !(projection[5] > 0.f)) return mPixelsPerUnit;
+    return 0.5f * viewport[3] * projection[5];
+}
+
+void AdaptiveLoopSubdivisionMesh::RegionCriterion::SetRegion(const glm::vec3& center,
+                                                             float radius) {
+    mCenter = center;
+    mRadius = radius;
+    mChanged = true;
+}
+
+float AdaptiveLoopSubdivisionMesh::RegionCriterion::Priority(
+    const AdaptiveLoopSubdivisionMesh& mesh, size_t faceIndex) const {
+    const std::array<glm::vec3, 3> corners = WorldCorners(mesh, faceIndex);
+    const float longest = LongestEdge(corners);
+    // Every point of the face is within the longest edge of its first corner
+    if (glm::length(corners[0] - mCenter) > mRadius + longest) return 0.f;
+    return longest / mMaxEdge;
+}
+
+bool AdaptiveLoopSubdivisionMesh::RegionCriterion::Changed() {
+    const bool changed = mChanged;
+    mChanged = false;
+    return changed;
+}
 
 /*! Subdivides the mesh one step, depending on subdividability
  */
 void AdaptiveLoopSubdivisionMesh::Subdivide() {
-    // Create new mesh and copy all the attributes
-    HalfEdgeMesh subDivMesh;
-    subDivMesh.SetTransform(GetTransform());
-    subDivMesh.SetName(GetName());
-    subDivMesh.SetColorMap(GetColorMap());
-    subDivMesh.SetWireframe(GetWireframe());
-    subDivMesh.SetShowNormals(GetShowNormals());
-    subDivMesh.SetOpacity(GetOpacity());
-    if (IsHovering()) subDivMesh.Hover();
-    if (IsSelected()) subDivMesh.Select();
-    subDivMesh.mMinCMap = mMinCMap;
-    subDivMesh.mMaxCMap = mMaxCMap;
-    subDivMesh.mAutoMinMax = mAutoMinMax;
+    mMarks = MarkFaces();
+
+    // The new mesh is built in a mesh of this type, to move its arrays in place after
+    AdaptiveLoopSubdivisionMesh subDivMesh;
 
     // loop over each face and create new ones
     for (size_t i = 0; i < GetNumFaces(); i++) {
@@ -73,11 +156,136 @@ void AdaptiveLoopSubdivisionMesh::Subdivide() {
         }
     }
 
-    // Assign the new mesh
-    *this = AdaptiveLoopSubdivisionMesh(subDivMesh, ++mNumSubDivs);
+    // Keep the old mesh as a level, and move the new one in place
+    Level level;
+    level.edges = std::move(mEdges);
+    level.verts = std::move(mVerts);
+    level.faces = std::move(mFaces);
+    level.marks = std::move(mMarks);
+    mLevels.push_back(std::move(level));
+    mMarks.clear();
+
+    mEdges = std::move(subDivMesh.mEdges);
+    mVerts = std::move(subDivMesh.mVerts);
+    mFaces = std::move(subDivMesh.mFaces);
+    FreeLookupTables();
+    mOneRingsValid = false;
+    InvalidateBuffers();
+
+    mNumSubDivs++;
     Update();
 }
 
+/*! Re-evaluates the criterion on every level, from the coarsest, and rebuilds the
+ * levels above the first one where the marked faces changed
+ */
+bool AdaptiveLoopSubdivisionMesh::Refine() {
+    mRefinePending = false;
+    const bool keep = !mMarksStale;
+    mMarksStale = false;
+    const size_t numLevels = mLevels.size();
+    for (size_t l = 0; l < numLevels; l++) {
+        SwapLevel(mLevels[l]);
+        const std::vector<bool> marks = MarkFaces(keep ? mLevels[l].marks : std::vector<bool>());
+        SwapLevel(mLevels[l]);
+        if (marks == mLevels[l].marks) continue;
+
+        // Start over from level l, the levels above it are rebuilt
+        mEdges = std::move(mLevels[l].edges);
+        mVerts = std::move(mLevels[l].verts);
+        mFaces = std::move(mLevels[l].faces);
+        mLevels.resize(l);
+        mNumSubDivs -= numLevels - l;
+        for (size_t k = l; k < numLevels; k++) {
+            Subdivide();
+        }
+        return true;
+    }
+    return false;
+}
+
+void AdaptiveLoopSubdivisionMesh::SetCriterion(Criterion* criterion) {
+    mCriterion = criterion;
+    mRefinePending = mMarksStale = true;
+}
+
+void AdaptiveLoopSubdivisionMesh::SetTriangleBudget(size_t triangles) {
+    mTriangleBudget = triangles;
+    mRefinePending = mMarksStale = true;
+}
+
+std::array<glm::vec3, 3> AdaptiveLoopSubdivisionMesh::GetFaceCorners(size_t faceIndex) const {
+    const std::array<Index, 3> verts = FaceVertices(faceIndex);
+    return {{mVerts.pos[verts[0]], mVerts.pos[verts[1]], mVerts.pos[verts[2]]}};
+}
+
+/*! Refining rebuilds levels by welding their faces, which is too slow for every
+ * frame of a moving camera, so the changes of the criterion are collected in between.
+ * Waiting as long as the last refinement took leaves at least half of the time to
+ * drawing.
+ */
+void AdaptiveLoopSubdivisionMesh::Render() {
+    // Asked on every frame, so that the criterion forgets its changes
+    if (mCriterion != NULL && mCriterion->Changed()) {
+        mRefinePending = true;
+    }
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const double elapsed = std::chrono::duration<double>(start - mRefineTime).count();
+    if (mRefinePending && (!mRefined || elapsed >= std::max(mRefineInterval, mRefineSeconds))) {
+        Refine();
+        mRefineTime = std::chrono::steady_clock::now();
+        mRefineSeconds = std::chrono::duration<double>(mRefineTime - start).count();
+        mRefined = true;
+    }
+    LoopSubdivisionMesh::Render();
+}
+
+/*! Marking a face splits its edges to marked neighbors, and its border edges. Each
+ * split edge adds a triangle on either side, which is counted against the budget.
+ */
+std::vector<bool> AdaptiveLoopSubdivisionMesh::MarkFaces(const std::vector<bool>& previous) const {
+    const size_t numFaces = GetNumFaces();
+    std::vector<float> priorities(numFaces, 2.f);
+    if (mCriterion != NULL) {
+        ParallelFor(numFaces, [&](size_t i) { priorities[i] = mCriterion->Priority(*this, i); },
+                    256);
+    }
+
+    std::vector<Index> order;
+    const bool keep = previous.size() == numFaces;
+    for (size_t i = 0; i < numFaces; i++) {
+        const float threshold = !keep ? 1.f : previous[i] ? 1.f / Hysteresis : Hysteresis;
+        if (priorities[i] > threshold) order.push_back(i);
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [&](Index a, Index b) { return priorities[a] > priorities[b]; });
+
+    std::vector<bool> marks(numFaces, false);
+    size_t numTriangles = numFaces;
+    for (Index face : order) {
+        size_t added = 0;
+        for (Index edge : {mFaces.edge[face], mEdges[mFaces.edge[face]].next,
+                           Prev(mFaces.edge[face])}) {
+            const Index neighbor = mEdges[mEdges[edge].pair].face;
+            if (neighbor >= EdgeState::Uninitialized) {
+                added += 1;
+            } else if (marks[neighbor]) {
+                added += 2;
+            }
+        }
+        if (numTriangles + added > mTriangleBudget) continue;
+        marks[face] = true;
+        numTriangles += added;
+    }
+    return marks;
+}
+
+void AdaptiveLoopSubdivisionMesh::SwapLevel(Level& level) {
+    std::swap(mEdges, level.edges);
+    std::swap(mVerts, level.verts);
+    std::swap(mFaces, level.faces);
+}
+
 /*! Computes a new vertex, replacing a vertex in the old mesh
   If any of the neighboring faces have subdividability == false
   then we should not move this vertex, else use the rules from loop subdivision
@@ -86,11 +294,9 @@ glm::vec3 AdaptiveLoopSubdivisionMesh::VertexRule(size_t vertexIndex) {
     // Get the current vertex
     glm::vec3 vtx = v(vertexIndex).pos;
 
-    // Get face neighborhood
-    std::vector<size_t> nb = FindNeighborFaces(vertexIndex);
-
-    for (size_t i = 0; i < nb.size(); i++) {
-        if (Subdividable(nb.at(i)) == false) {
+    // Check the face neighborhood
+    for (Index face : NeighborFaces(vertexIndex)) {
+        if (Subdividable(face) == false) {
             // don't move position
             return vtx;
         }
@@ -13,22 +13,158 @@
 #define _A_LOOP_SUBDIVISION_MESH_
 
 #include "Subdivision/LoopSubdivisionMesh.h"
+#include <array>
+#include <chrono>
+#include <limits>
 
-/*! \brief Abstract base class for Adaptive Subdivision that implements the Loop
- * scheme
+class GLCamera;
+
+/*! \brief Adaptive Subdivision that implements the Loop scheme
+ *
+ * Each step marks the faces that a Criterion asks to refine, highest priority
+ * first, as long as the refined mesh stays within the triangle budget. An edge is
+ * split where both its faces are marked, so the faces along a transition are split
+ * by Subdivide1() and Subdivide2() and the mesh has no cracks. Without a criterion
+ * every face is marked, which is uniform subdivision.
+ *
+ * The mesh of every level is kept, so Refine() re-evaluates the criterion and only
+ * rebuilds from the first level where the marks changed. A marked face is only
+ * unmarked, and an unmarked one marked, once its priority is clearly past the
+ * threshold, so that small changes of the criterion rebuild nothing. Render()
+ * refines when the criterion changed, e.g. as the camera moved, but at most once per
+ * refine interval or per time the last refinement took, whichever is longer; changes
+ * in between are refined by a later Render().
  */
 class AdaptiveLoopSubdivisionMesh : public LoopSubdivisionMesh {
 public:
-    AdaptiveLoopSubdivisionMesh(const HalfEdgeMesh& m, size_t s) : LoopSubdivisionMesh(m, s) {}
-    AdaptiveLoopSubdivisionMesh() {}
+    /*! \brief Decides which faces need more detail
+     *
+     * Priority() is called in parallel and must not change the criterion.
+     */
+    class Criterion {
+    public:
+        virtual ~Criterion() {}
+
+        //! Faces above 1 are refined, higher priorities first
+        virtual float Priority(const AdaptiveLoopSubdivisionMesh& mesh,
+                               size_t faceIndex) const = 0;
+
+        //! Returns true once if the priorities may have changed since the last call
+        virtual bool Changed() { return false; }
+    };
+
+    //! Refines where the curvature times the longest edge is above a tolerance
+    class CurvatureCriterion : public Criterion {
+    public:
+        CurvatureCriterion(float tolerance) : mTolerance(tolerance) {}
+
+        virtual float Priority(const AdaptiveLoopSubdivisionMesh& mesh, size_t faceIndex) const;
+
+    protected:
+        float mTolerance;
+    };
+
+    /*! \brief Refines faces whose longest edge covers more than a number of pixels on screen
+     *
+     * The viewport and the projection are read from the current OpenGL state, so
+     * Changed() must be called with the context of the viewer current, as Render() does.
+     */
+    class ScreenSpaceCriterion : public Criterion {
+    public:
+        //! \param[in] camera the camera of the viewer, followed as it moves
+        ScreenSpaceCriterion(const GLCamera& camera, float maxPixels);
+
+        virtual float Priority(const AdaptiveLoopSubdivisionMesh& mesh, size_t faceIndex) const;
+        //! Also true when the viewport was resized or the field of view changed
+        virtual bool Changed();
+
+    protected:
+        //! The pixels per unit of the current viewport and projection, or the last ones
+        float currentPixelsPerUnit() const;
+
+        const GLCamera& mCamera;
+        float mMaxPixels;
+        //! Pixels covered by a unit length at unit distance
+        float mPixelsPerUnit;
+        glm::vec3 mLastPosition;
+    };
+
+    //! Refines faces near a point whose longest edge is longer than a length
+    class RegionCriterion : public Criterion {
+    public:
+        RegionCriterion(const glm::vec3& center, float radius, float maxEdge)
+            : mCenter(center), mRadius(radius), mMaxEdge(maxEdge), mChanged(false) {}
+
+        //! Moves the region of interest
+        void SetRegion(const glm::vec3& center, float radius);
+
+        virtual float Priority(const AdaptiveLoopSubdivisionMesh& mesh, size_t faceIndex) const;
+        virtual bool Changed();
+
+    protected:
+        glm::vec3 mCenter;
+        float mRadius;
+        float mMaxEdge;
+        bool mChanged;
+    };
+
+    AdaptiveLoopSubdivisionMesh(const HalfEdgeMesh& m, size_t s)
+        : LoopSubdivisionMesh(m, s), mCriterion(NULL), mTriangleBudget(NoBudget),
+          mRefinePending(false), mMarksStale(false), mRefineInterval(0.1),
+          mRefineSeconds(0), mRefined(false) {}
+    AdaptiveLoopSubdivisionMesh()
+        : mCriterion(NULL), mTriangleBudget(NoBudget), mRefinePending(false), mMarksStale(false),
+          mRefineInterval(0.1), mRefineSeconds(0), mRefined(false) {}
 
     virtual ~AdaptiveLoopSubdivisionMesh() {}
 
-    //! Subdivides the mesh uniformly one step
+    //! Subdivides the mesh adaptively one step
     virtual void Subdivide();
 
+    /*! Re-evaluates the criterion on every level and rebuilds the levels above the
+     * first one where the marked faces changed
+     * \return true if the mesh changed
+     */
+    bool Refine();
+
+    //! Sets the criterion, which is not owned by the mesh, or NULL to refine everywhere
+    void SetCriterion(Criterion* criterion);
+    //! Limits the number of triangles of every level
+    void SetTriangleBudget(size_t triangles);
+    //! The least time in seconds between two refinements by Render(), 0.1 by default
+    void SetRefineInterval(double seconds) { mRefineInterval = seconds; }
+
+    //! The corners of a face, in object coordinates
+    std::array<glm::vec3, 3> GetFaceCorners(size_t faceIndex) const;
+
+    //! Refines first if the criterion changed and the refine interval has passed
+    virtual void Render() override;
+
 protected:
-    virtual bool Subdividable(size_t faceIndex) { return true; }
+    static constexpr size_t NoBudget = std::numeric_limits<size_t>::max();
+    //! A face changes its mark when its priority is this factor past the threshold of 1
+    static constexpr float Hysteresis = 1.25f;
+
+    //! A level below the current mesh, and the faces marked to refine it
+    struct Level {
+        std::vector<HalfEdge> edges;
+        VertexArrays verts;
+        FaceArrays faces;
+        std::vector<bool> marks;
+    };
+
+    virtual bool Subdividable(size_t faceIndex) {
+        return faceIndex >= mMarks.size() || mMarks[faceIndex];
+    }
+
+    /*! Marks the faces to refine by priority within the triangle budget
+     * \param[in] previous the marks of the last refinement, which are kept near the
+     * threshold, or empty
+     */
+    std::vector<bool> MarkFaces(const std::vector<bool>& previous = std::vector<bool>()) const;
+
+    //! Exchanges the current mesh with a stored level
+    void SwapLevel(Level& level);
 
     //! Subdivides the face at faceIndex given 1 not subdividable neighbor
     virtual std::vector<std::vector<glm::vec3>> Subdivide1(size_t faceIndex);
@@ -42,6 +178,23 @@ protected:
 
     //! Computes a new vertex, replacing a vertex in the old mesh
     virtual glm::vec3 VertexRule(size_t vertexIndex);
+
+    Criterion* mCriterion;
+    size_t mTriangleBudget;
+    //! Set when the criterion or budget changed, so that the next Render() refines
+    bool mRefinePending;
+    //! Set when the criterion or budget changed, so that Refine() does not keep old marks
+    bool mMarksStale;
+    double mRefineInterval;
+    //! When Render() last refined, if it did, and how long that took
+    std::chrono::steady_clock::time_point mRefineTime;
+    double mRefineSeconds;
+    bool mRefined;
+
+    //! The levels from the first subdivision up to the current mesh
+    std::vector<Level> mLevels;
+    //! The faces to refine during Subdivide()
+    std::vector<bool> mMarks;
 };
 
 #endif
@@ -11,41 +11,290 @@
  *************************************************************************************************/
 
 #include "LoopSubdivisionMesh.h"
+#include "GUI/MeshBuffers.h"
+#include "Util/Parallel.h"
 #include <cassert>
+#include <cmath>
 
-/*! Subdivides the mesh uniformly one step
+namespace {
+
+//! Subdivision depth after which the limit is interpolated in a face that is still irregular
+const size_t MaxLimitDepth = 16;
+//! Radius of the patches subdivided by EvaluateLimit(), enough to keep the control
+//! vertices of the next level exact
+const size_t PatchRadius = 2;
+
+//! The exponents of (1 - u - v, u, v) in the quartic Bernstein polynomials
+const int BezierExponents[15][3] = {
+    {4, 0, 0},
+    {3, 1, 0},
+    {3, 0, 1},
+    {2, 2, 0},
+    {2, 1, 1},
+    {2, 0, 2},
+    {1, 3, 0},
+    {1, 2, 1},
+    {1, 1, 2},
+    {1, 0, 3},
+    {0, 4, 0},
+    {0, 3, 1},
+    {0, 2, 2},
+    {0, 1, 3},
+    {0, 0, 4},
+};
+
+/*! A regular Loop patch is a quartic box spline. These are its Bezier points in 24ths
+ * of the 12 control vertices: the corners v0, v1 and v2 of the face, followed by the
+ * three vertices after v(c + 1) and v(c + 2) counter clockwise around each corner vc.
+ */
+const float RegularPatch[15][12] = {
+    {12.f, 2.f, 2.f, 2.f, 2.f, 2.f, 2.f, 0.f, 0.f, 0.f, 0.f, 0.f},
+    {12.f, 4.f, 3.f, 1.f, 0.f, 1.f, 3.f, 0.f, 0.f, 0.f, 0.f, 0.f},
+    {12.f, 3.f, 4.f, 3.f, 1.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 0.f},
+    {8.f, 8.f, 4.f, 0.f, 0.f, 0.f, 4.f, 0.f, 0.f, 0.f, 0.f, 0.f},
+    {10.f, 6.f, 6.f, 1.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 0.f},
+    {8.f, 4.f, 8.f, 4.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f},
+    {4.f, 12.f, 3.f, 0.f, 0.f, 0.f, 3.f, 1.f, 0.f, 1.f, 0.f, 0.f},
+    {6.f, 10.f, 6.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 1.f, 0.f, 0.f},
+    {6.f, 6.f, 10.f, 1.f, 0.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f},
+    {4.f, 3.f, 12.f, 3.f, 0.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 1.f},
+    {2.f, 12.f, 2.f, 0.f, 0.f, 0.f, 2.f, 2.f, 2.f, 2.f, 0.f, 0.f},
+    {3.f, 12.f, 4.f, 0.f, 0.f, 0.f, 1.f, 0.f, 1.f, 3.f, 0.f, 0.f},
+    {4.f, 8.f, 8.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 4.f, 0.f, 0.f},
+    {3.f, 4.f, 12.f, 1.f, 0.f, 0.f, 0.f, 0.f, 0.f, 3.f, 1.f, 0.f},
+    {2.f, 2.f, 12.f, 2.f, 0.f, 0.f, 0.f, 0.f, 0.f, 2.f, 2.f, 2.f},
+};
+
+float Power(float x, int n) {
+    float p = 1.f;
+    for (int i = 0; i < n; i++) {
+        p *= x;
+    }
+    return p;
+}
+
+//! Evaluates a regular patch and its normal at barycentric coordinates (u, v)
+void EvaluateRegularPatch(const std::array<glm::vec3, 12>& control, float u, float v,
+                          glm::vec3& position, glm::vec3& normal) {
+    const float l[3] = {1.f - u - v, u, v};
+    const float factorial[5] = {1.f, 1.f, 2.f, 6.f, 24.f};
+    glm::vec3 derivative[3] = {glm::vec3(0.f), glm::vec3(0.f), glm::vec3(0.f)};
+    position = glm::vec3(0.f, 0.f, 0.f);
+    for (size_t b = 0; b < 15; b++) {
+        glm::vec3 point(0.f, 0.f, 0.f);
+        for (size_t c = 0; c < 12; c++) {
+            point += RegularPatch[b][c] * control[c];
+        }
+        const int* e = BezierExponents[b];
+        // The 24ths cancel the 4! of the multinomial coefficient of the Bernstein polynomial
+        point /= factorial[e[0]] * factorial[e[1]] * factorial[e[2]];
+        position += point * (Power(l[0], e[0]) * Power(l[1], e[1]) * Power(l[2], e[2]));
+        // The partial derivatives in the three barycentric coordinates
+        for (int k = 0; k < 3; k++) {
+            if (e[k] == 0) continue;
+            float monomial = float(e[k]);
+            for (int m = 0; m < 3; m++) {
+                monomial *= Power(l[m], m == k ? e[m] - 1 : e[m]);
+            }
+            derivative[k] += point * monomial;
+        }
+    }
+    const glm::vec3 du = derivative[1] - derivative[0];
+    const glm::vec3 dv = derivative[2] - derivative[0];
+    normal = glm::normalize(glm::cross(du, dv));
+}
+
+}  // namespace
+
+/*! Subdivides the mesh uniformly one step. The old vertex i keeps index i and
+ * the edge vertex of the half edge pair (2k, 2k + 1) gets index V + k, so the
+ * refined half edge arrays are written directly by index. Each rule is
+ * evaluated once, and no vertices are welded by position.
  */
 void LoopSubdivisionMesh::Subdivide() {
-    // Create new mesh and copy all the attributes
-    HalfEdgeMesh subDivMesh;
-    subDivMesh.SetTransform(GetTransform());
-    subDivMesh.SetName(GetName());
-    subDivMesh.SetColorMap(GetColorMap());
-    subDivMesh.SetWireframe(GetWireframe());
-    subDivMesh.SetShowNormals(GetShowNormals());
-    subDivMesh.SetOpacity(GetOpacity());
-    if (IsHovering()) subDivMesh.Hover();
-    if (IsSelected()) subDivMesh.Select();
-    subDivMesh.mMinCMap = mMinCMap;
-    subDivMesh.mMaxCMap = mMaxCMap;
-    subDivMesh.mAutoMinMax = mAutoMinMax;
-
-    // loop over each face and create 4 new ones
-    for (size_t i = 0; i < mFaces.size(); i++) {
-        // subdivide face
-        std::vector<std::vector<glm::vec3>> faces = Subdivide(i);
-
-        // add new faces to subDivMesh
-        for (size_t j = 0; j < faces.size(); j++) {
-            subDivMesh.AddFace(faces.at(j));
-        }
-    }
-
-    // Assigns the new mesh
-    *this = LoopSubdivisionMesh(subDivMesh, ++mNumSubDivs);
+    RefineTopology(RefinedPositions());
+    mNumSubDivs++;
     Update();
 }
 
+/*! The new positions, all computed from the old mesh
+ */
+std::vector<glm::vec3> LoopSubdivisionMesh::RefinedPositions() {
+    const size_t numVerts = GetNumVerts();
+    const size_t numEdges = GetNumEdges();
+    std::vector<glm::vec3> positions(numVerts + numEdges / 2);
+    ParallelFor(numVerts, [&](size_t i) { positions[i] = VertexRule(i); });
+    ParallelFor(numEdges / 2, [&](size_t k) { positions[numVerts + k] = EdgeRule(2 * k); });
+    return positions;
+}
+
+/*! Splits every face in four, see Subdivide() for the numbering of the new vertices
+ */
+void LoopSubdivisionMesh::RefineTopology(std::vector<glm::vec3> positions) {
+    const size_t numVerts = GetNumVerts();
+    const size_t numEdges = GetNumEdges();
+    const size_t numFaces = GetNumFaces();
+
+    VertexArrays verts;
+    verts.resize(numVerts + numEdges / 2);
+    verts.pos = std::move(positions);
+
+    // Half edge h is split at its edge vertex into firstHalf(h), which leaves the origin
+    // of h, and secondHalf(h). The halves of the pair (2k, 2k + 1) form the pairs
+    // (4k, 4k + 1) and (4k + 2, 4k + 3).
+    auto firstHalf = [](size_t h) { return h % 2 == 0 ? 2 * h : 2 * h + 1; };
+    auto secondHalf = [](size_t h) { return h % 2 == 0 ? 2 * h + 2 : 2 * h - 1; };
+
+    // The split half edges come first, then three inner pairs per face
+    const size_t firstInner = 2 * numEdges;
+    std::vector<HalfEdge> edges(firstInner + 6 * numFaces);
+    ParallelFor(numEdges, [&](size_t h) {
+        const HalfEdge& old = mEdges[h];
+        HalfEdge& first = edges[firstHalf(h)];
+        HalfEdge& second = edges[secondHalf(h)];
+        first.vert = old.vert;
+        first.pair = secondHalf(old.pair);
+        second.vert = numVerts + h / 2;
+        second.pair = firstHalf(old.pair);
+        // Border edges stay outside of any face, the others are linked per face below
+        if (old.face >= EdgeState::Uninitialized) {
+            first.face = second.face = old.face;
+            first.next = second.next = old.next;
+        }
+    });
+
+    // Face f becomes the corner triangles 4f + c at the origin of its half edge c, and the
+    // center triangle 4f + 3. Inner pair c runs from the edge vertex of half edge c to that
+    // of half edge c - 1 in corner c, and back in the center.
+    FaceArrays faces;
+    faces.resize(4 * numFaces);
+    ParallelFor(numFaces, [&](size_t f) {
+        Index h[3];
+        h[0] = mFaces.edge[f];
+        h[1] = mEdges[h[0]].next;
+        h[2] = mEdges[h[1]].next;
+        const size_t inner = firstInner + 6 * f;
+        for (size_t c = 0; c < 3; c++) {
+            const size_t prev = (c + 2) % 3;
+            const size_t corner = 4 * f + c;
+            const Index e0 = firstHalf(h[c]), e1 = inner + 2 * c, e2 = secondHalf(h[prev]);
+            edges[e0].next = e1;
+            edges[e1].next = e2;
+            edges[e2].next = e0;
+            edges[e0].face = edges[e1].face = edges[e2].face = corner;
+            edges[e1].vert = numVerts + h[c] / 2;
+            edges[e1].pair = e1 + 1;
+            faces.edge[corner] = e0;
+
+            HalfEdge& center = edges[e1 + 1];
+            center.vert = numVerts + h[prev] / 2;
+            center.face = 4 * f + 3;
+            center.next = inner + 2 * ((c + 1) % 3) + 1;
+            center.pair = e1;
+        }
+        faces.edge[4 * f + 3] = inner + 1;
+    });
+
+    // Every vertex leaves along a half of its old edge, or of its split edge
+    ParallelFor(numVerts, [&](size_t i) {
+        if (mVerts.edge[i] < EdgeState::Uninitialized) verts.edge[i] = firstHalf(mVerts.edge[i]);
+    });
+    ParallelFor(numEdges / 2, [&](size_t k) { verts.edge[numVerts + k] = secondHalf(2 * k); });
+
+    // Move the refined arrays into place, the attributes of the mesh are kept as they are
+    mEdges = std::move(edges);
+    mVerts = std::move(verts);
+    mFaces = std::move(faces);
+    FreeLookupTables();
+    mOneRingsValid = false;
+    InvalidateBuffers();
+}
+
+/*! Subdivides the mesh uniformly levels steps, and returns the stencils of the
+ * refined vertices in the vertices before the first step
+ */
+StencilTable LoopSubdivisionMesh::BuildStencilTable(size_t levels) {
+    StencilTable stencils = StencilTable::Identity(GetNumVerts());
+    for (size_t level = 0; level < levels; level++) {
+        const StencilTable step = StencilTable(GetNumVerts(), LoopStencils());
+        stencils = step.Compose(stencils);
+
+        std::vector<glm::vec3> positions;
+        step.Apply(mVerts.pos, positions);
+        RefineTopology(std::move(positions));
+        mNumSubDivs++;
+    }
+    Update();
+    return stencils;
+}
+
+/*! Moves the refined vertices to the stencils of the given control positions
+ */
+bool LoopSubdivisionMesh::ApplyStencilTable(const StencilTable& stencils,
+                                            const std::vector<glm::vec3>& control) {
+    if (stencils.GetNumVerts() != GetNumVerts() ||
+        stencils.GetNumControlVerts() != control.size()) {
+        std::cerr << "Stencil table of " << stencils.GetNumControlVerts() << " to "
+                  << stencils.GetNumVerts() << " vertices does not match " << control.size()
+                  << " control vertices and " << GetNumVerts() << " mesh vertices" << std::endl;
+        return false;
+    }
+    stencils.Apply(control, mVerts.pos);
+    InvalidateBuffers(MeshBuffers::Positions);
+    Update();
+    return true;
+}
+
+/*! The weights of VertexRule() and EdgeRule() for one step, in the numbering of
+ * Subdivide()
+ */
+std::vector<StencilTable::Stencil> LoopSubdivisionMesh::LoopStencils() const {
+    const size_t numVerts = GetNumVerts();
+    const size_t numEdges = GetNumEdges();
+    auto isBorder = [this](const HalfEdge& edge) {
+        return edge.face >= EdgeState::Uninitialized ||
+               mEdges[edge.pair].face >= EdgeState::Uninitialized;
+    };
+
+    std::vector<StencilTable::Stencil> stencils(numVerts + numEdges / 2);
+    ParallelFor(numVerts, [&](size_t i) {
+        StencilTable::Stencil& stencil = stencils[i];
+        StencilTable::Stencil border;
+        for (Index edge : OutgoingEdges(i)) {
+            const Index neighbor = mEdges[mEdges[edge].pair].vert;
+            stencil.push_back(StencilTable::Entry(neighbor, 0.f));
+            if (isBorder(mEdges[edge])) border.push_back(StencilTable::Entry(neighbor, 1.f / 8.f));
+        }
+
+        const size_t k = stencil.size();
+        if (border.size() == 2) {
+            stencil = border;
+            stencil.push_back(StencilTable::Entry(i, 3.f / 4.f));
+        } else if (k > 0) {
+            for (StencilTable::Entry& entry : stencil) {
+                entry.second = Beta(k);
+            }
+            stencil.push_back(StencilTable::Entry(i, 1 - k * Beta(k)));
+        } else {
+            stencil.push_back(StencilTable::Entry(i, 1.f));
+        }
+    });
+    ParallelFor(numEdges / 2, [&](size_t k) {
+        StencilTable::Stencil& stencil = stencils[numVerts + k];
+        const HalfEdge& e0 = mEdges[2 * k];
+        const HalfEdge& e1 = mEdges[2 * k + 1];
+        if (isBorder(e0)) {
+            stencil = {StencilTable::Entry(e0.vert, 0.5f), StencilTable::Entry(e1.vert, 0.5f)};
+        } else {
+            stencil = {StencilTable::Entry(e0.vert, 3.f / 8.f),
+                       StencilTable::Entry(e1.vert, 3.f / 8.f),
+                       StencilTable::Entry(mEdges[Prev(2 * k)].vert, 1.f / 8.f),
+                       StencilTable::Entry(mEdges[Prev(2 * k + 1)].vert, 1.f / 8.f)};
+        }
+    });
+    return stencils;
+}
+
 /*! Subdivides the face at faceindex into a vector of faces
  */
 std::vector<std::vector<glm::vec3>> LoopSubdivisionMesh::Subdivide(size_t faceIndex) {
@@ -103,34 +352,331 @@ std::vector<std::vector<glm::vec3>> LoopSubdivisionMesh::Subdivide(size_t faceIn
 /*! Computes a new vertex, replacing a vertex in the old mesh
  */
 glm::vec3 LoopSubdivisionMesh::VertexRule(size_t vertexIndex) {
-    // Get one-ring
-    std::vector<size_t> oneRing = FindNeighborVertices(vertexIndex);
-    size_t k = oneRing.size();
-
-    glm::vec3 vtx = v(vertexIndex).pos * (1 - k * Beta(k));
-
-    for (size_t vert : oneRing) {
-        vtx += v(vert).pos * Beta(k);
+    // Sum the one-ring, the weights depend on the valence k
+    glm::vec3 sum(0.0f, 0.0f, 0.0f);
+    glm::vec3 borderSum(0.0f, 0.0f, 0.0f);
+    size_t k = 0;
+    size_t numBorder = 0;
+    for (Index edge : OutgoingEdges(vertexIndex)) {
+        const HalfEdge& outgoing = mEdges[edge];
+        const HalfEdge& incoming = mEdges[outgoing.pair];
+        const glm::vec3& neighbor = mVerts.pos[incoming.vert];
+        sum += neighbor;
+        k++;
+        const bool border = outgoing.face >= EdgeState::Uninitialized ||
+                            incoming.face >= EdgeState::Uninitialized;
+        if (border) {
+            borderSum += neighbor;
+            numBorder++;
+        }
     }
 
-    return vtx;
+    // A border vertex only follows its two neighbors along the border
+    if (numBorder == 2) {
+        return mVerts.pos[vertexIndex] * (3.0f / 4.0f) + borderSum * (1.0f / 8.0f);
+    }
+    return mVerts.pos[vertexIndex] * (1 - k * Beta(k)) + sum * Beta(k);
 }
 
 /*! Computes a new vertex, placed along an edge in the old mesh
  */
 glm::vec3 LoopSubdivisionMesh::EdgeRule(size_t edgeIndex) {
-    // Place the edge vertex halfway along the edge
     HalfEdge& e0 = e(edgeIndex);
     HalfEdge& e1 = e(e0.pair);
-    HalfEdge& e2 = e(e0.prev);
-    HalfEdge& e3 = e(e1.prev);
     glm::vec3& v0 = v(e0.vert).pos;
     glm::vec3& v1 = v(e1.vert).pos;
+
+    // A border edge has no opposite vertices, the edge vertex is its midpoint
+    if (e0.face >= EdgeState::Uninitialized || e1.face >= EdgeState::Uninitialized) {
+        return 0.5f * (v0 + v1);
+    }
+
+    // Weigh in the vertices opposite to the edge in both faces
+    HalfEdge& e2 = e(Prev(edgeIndex));
+    HalfEdge& e3 = e(Prev(e0.pair));
     glm::vec3& v2 = v(e2.vert).pos;
     glm::vec3& v3 = v(e3.vert).pos;
     return ((3.0f / 8.0f) * (v0 + v1) + (1.0f / 8.0f) * (v2 + v3));
 }
 
+/*! Applies the limit mask of Loop, from the dominant left eigenvector of the
+ * subdivision matrix
+ */
+glm::vec3 LoopSubdivisionMesh::LimitPosition(size_t vertexIndex) const {
+    glm::vec3 sum(0.0f, 0.0f, 0.0f);
+    glm::vec3 borderSum(0.0f, 0.0f, 0.0f);
+    size_t k = 0;
+    size_t numBorder = 0;
+    for (Index edge : OutgoingEdges(vertexIndex)) {
+        const HalfEdge& outgoing = mEdges[edge];
+        const HalfEdge& incoming = mEdges[outgoing.pair];
+        const glm::vec3& neighbor = mVerts.pos[incoming.vert];
+        sum += neighbor;
+        k++;
+        const bool border = outgoing.face >= EdgeState::Uninitialized ||
+                            incoming.face >= EdgeState::Uninitialized;
+        if (border) {
+            borderSum += neighbor;
+            numBorder++;
+        }
+    }
+
+    const glm::vec3& p = mVerts.pos[vertexIndex];
+    // A border vertex converges to the cubic B-spline of the border
+    if (numBorder == 2) {
+        return p * (2.0f / 3.0f) + borderSum * (1.0f / 6.0f);
+    }
+    if (k == 0) {
+        return p;
+    }
+    const float omega = 1.0f / (3.0f / (8.0f * Beta(k)) + k);
+    return p * (1 - k * omega) + sum * omega;
+}
+
+/*! Crosses the two tangents from the tangent masks of Loop, the eigenvectors of the
+ * subdivision matrix for its second largest eigenvalue
+ */
+glm::vec3 LoopSubdivisionMesh::LimitNormal(size_t vertexIndex) const {
+    // Walk clockwise to the border, if there is one
+    Index start = mVerts.edge[vertexIndex];
+    if (mEdges[start].face >= EdgeState::Uninitialized) {
+        start = mEdges[mEdges[start].pair].next;
+    }
+    Index first = start;
+    while (mEdges[mEdges[first].pair].face < EdgeState::Uninitialized) {
+        first = mEdges[mEdges[first].pair].next;
+        if (first == start) break;
+    }
+    const bool border = mEdges[mEdges[first].pair].face >= EdgeState::Uninitialized;
+
+    // Then gather the neighbors counter clockwise
+    std::vector<glm::vec3> ring;
+    Index edge = first;
+    do {
+        ring.push_back(mVerts.pos[mEdges[mEdges[edge].pair].vert]);
+        if (mEdges[edge].face >= EdgeState::Uninitialized) break;
+        edge = mEdges[Prev(edge)].pair;
+    } while (edge != first);
+
+    const size_t k = ring.size();
+    const glm::vec3& p = mVerts.pos[vertexIndex];
+    glm::vec3 along(0.0f, 0.0f, 0.0f);
+    glm::vec3 across(0.0f, 0.0f, 0.0f);
+    if (!border) {
+        for (size_t i = 0; i < k; i++) {
+            const float angle = 2.0f * float(M_PI) * i / k;
+            along += std::cos(angle) * ring[i];
+            across += std::sin(angle) * ring[i];
+        }
+        return glm::normalize(glm::cross(along, across));
+    }
+
+    // Along the border the tangent is the difference of the border neighbors. Across it
+    // the tangent is the eigenvector of the subdivision matrix of the border ring, which
+    // weights the interior neighbors by sin(i * theta)
+    along = ring.front() - ring.back();
+    if (k == 2) {
+        across = ring[0] + ring[1] - 2.0f * p;
+    } else {
+        const float theta = float(M_PI) / (k - 1);
+        const float interiorSum = 1.0f / std::tan(theta / 2);
+        const float borderWeight = (std::sin(theta) - interiorSum) / (1 + 2 * std::cos(theta));
+        across = borderWeight * (ring.front() + ring.back()) -
+                 (2 * borderWeight + interiorSum) * p;
+        for (size_t i = 1; i + 1 < k; i++) {
+            across += std::sin(i * theta) * ring[i];
+        }
+    }
+    // Orient the normal like the faces around the vertex
+    glm::vec3 normal = glm::cross(along, across);
+    glm::vec3 fan(0.0f, 0.0f, 0.0f);
+    for (size_t i = 0; i + 1 < k; i++) {
+        fan += glm::cross(ring[i] - p, ring[i + 1] - p);
+    }
+    if (glm::dot(normal, fan) < 0) normal = -normal;
+    return glm::normalize(normal);
+}
+
+/*! Regular faces are evaluated as box splines. Stam's method reaches the regular
+ * faces around an extraordinary vertex through the eigenvectors of the subdivision
+ * matrix; here a small patch around the face is subdivided instead, one level for
+ * each halving of the distance to the vertex, which gives the same surface.
+ */
+void LoopSubdivisionMesh::EvaluateLimit(size_t faceIndex, float u, float v, glm::vec3& position,
+                                        glm::vec3& normal) const {
+    std::array<glm::vec3, 12> control;
+    if (GetRegularPatch(faceIndex, control)) {
+        EvaluateRegularPatch(control, u, v, position, normal);
+        return;
+    }
+
+    // The patches shrink with every level, so they are kept centered on face 0 where
+    // floats are the most precise; subdivision commutes with the translation
+    LoopSubdivisionMesh patches[2];
+    LoopSubdivisionMesh* patch = &patches[0];
+    LoopSubdivisionMesh* refined = &patches[1];
+    glm::vec3 origin(0.0f, 0.0f, 0.0f);
+    auto center = [&]() {
+        const glm::vec3 offset = patch->mVerts.pos[patch->mEdges[patch->mFaces.edge[0]].vert];
+        for (glm::vec3& pos : patch->mVerts.pos) {
+            pos -= offset;
+        }
+        origin += offset;
+    };
+    ExtractPatch(faceIndex, PatchRadius, *patch);
+    center();
+    for (size_t depth = 0;; depth++) {
+        const float w = 1.0f - u - v;
+        // The limit masks are exact at the corners, and near an extraordinary or border
+        // vertex the face never becomes regular, so interpolate there in the end
+        if (w == 1 || u == 1 || v == 1 || depth == MaxLimitDepth) {
+            const std::array<Index, 3> corners = patch->FaceVertices(0);
+            const float weights[3] = {w, u, v};
+            position = glm::vec3(0.0f, 0.0f, 0.0f);
+            normal = glm::vec3(0.0f, 0.0f, 0.0f);
+            for (size_t c = 0; c < 3; c++) {
+                if (weights[c] == 0) continue;
+                position += weights[c] * patch->LimitPosition(corners[c]);
+                normal += weights[c] * patch->LimitNormal(corners[c]);
+            }
+            position += origin;
+            normal = glm::normalize(normal);
+            return;
+        }
+
+        // Face 0 becomes the corner faces 0 to 2 and the center face 3, continue in the
+        // one that contains the point
+        patch->RefineTopology(patch->RefinedPositions());
+        size_t child;
+        float childU, childV;
+        if (w >= 0.5f) {
+            child = 0, childU = 2 * u, childV = 2 * v;
+        } else if (u >= 0.5f) {
+            child = 1, childU = 2 * v, childV = 2 * w;
+        } else if (v >= 0.5f) {
+            child = 2, childU = 2 * w, childV = 2 * u;
+        } else {
+            child = 3, childU = 1 - 2 * v, childV = 1 - 2 * w;
+        }
+        u = childU;
+        v = childV;
+        patch->ExtractPatch(child, PatchRadius, *refined);
+        std::swap(patch, refined);
+        center();
+
+        if (patch->GetRegularPatch(0, control)) {
+            EvaluateRegularPatch(control, u, v, position, normal);
+            position += origin;
+            return;
+        }
+    }
+}
+
+void LoopSubdivisionMesh::ExtractPatch(size_t faceIndex, size_t radius,
+                                       LoopSubdivisionMesh& patch) const {
+    // The vertices within radius edges of the corners, breadth first
+    HashMap<Index> vertMap;
+    std::vector<Index> verts;
+    auto mapVertex = [&](Index vert) {
+        const auto inserted = vertMap.insert(vert, verts.size());
+        if (inserted.second) verts.push_back(vert);
+        return *inserted.first;
+    };
+    for (Index vert : FaceVertices(faceIndex)) {
+        mapVertex(vert);
+    }
+    size_t begin = 0;
+    for (size_t r = 0; r < radius; r++) {
+        const size_t end = verts.size();
+        for (size_t i = begin; i < end; i++) {
+            for (Index neighbor : NeighborVertices(verts[i])) {
+                mapVertex(neighbor);
+            }
+        }
+        begin = end;
+    }
+
+    // All faces around them, starting with the face itself
+    HashMap<Index> faceMap;
+    std::vector<Index> faces;
+    faceMap.insert(faceIndex, 0);
+    faces.push_back(faceIndex);
+    const size_t numInner = verts.size();
+    for (size_t i = 0; i < numInner; i++) {
+        for (Index face : NeighborFaces(verts[i])) {
+            if (faceMap.insert(face, faces.size()).second) faces.push_back(face);
+        }
+    }
+
+    // The half edge pairs of the faces, halves outside of the patch become border edges
+    HashMap<Index> pairMap;
+    patch.mEdges.clear();
+    auto mapEdge = [&](Index edge) {
+        const auto inserted = pairMap.insert(edge / 2, patch.mEdges.size() / 2);
+        const Index pair = *inserted.first;
+        if (inserted.second) {
+            patch.mEdges.resize(patch.mEdges.size() + 2);
+            for (Index half = 0; half < 2; half++) {
+                patch.mEdges[2 * pair + half].vert = mapVertex(mEdges[2 * (edge / 2) + half].vert);
+                patch.mEdges[2 * pair + half].pair = 2 * pair + (1 - half);
+            }
+        }
+        return 2 * pair + edge % 2;
+    };
+    patch.mFaces.clear();
+    patch.mFaces.resize(faces.size());
+    for (size_t i = 0; i < faces.size(); i++) {
+        const Index e0 = mFaces.edge[faces[i]];
+        const Index e1 = mEdges[e0].next;
+        const Index e2 = mEdges[e1].next;
+        const Index n0 = mapEdge(e0), n1 = mapEdge(e1), n2 = mapEdge(e2);
+        patch.mEdges[n0].next = n1;
+        patch.mEdges[n1].next = n2;
+        patch.mEdges[n2].next = n0;
+        patch.mEdges[n0].face = patch.mEdges[n1].face = patch.mEdges[n2].face = i;
+        patch.mFaces.edge[i] = n0;
+    }
+
+    patch.mVerts.clear();
+    patch.mVerts.resize(verts.size());
+    for (size_t i = 0; i < verts.size(); i++) {
+        patch.mVerts.pos[i] = mVerts.pos[verts[i]];
+    }
+    for (size_t i = 0; i < patch.mEdges.size(); i++) {
+        Index& edge = patch.mVerts.edge[patch.mEdges[i].vert];
+        if (edge == EdgeState::Uninitialized) edge = i;
+    }
+    patch.FreeLookupTables();
+    patch.mOneRingsValid = false;
+}
+
+bool LoopSubdivisionMesh::GetRegularPatch(size_t faceIndex,
+                                          std::array<glm::vec3, 12>& control) const {
+    Index corners[3];
+    corners[0] = mFaces.edge[faceIndex];
+    corners[1] = mEdges[corners[0]].next;
+    corners[2] = mEdges[corners[1]].next;
+    for (size_t c = 0; c < 3; c++) {
+        control[c] = mVerts.pos[mEdges[corners[c]].vert];
+    }
+
+    // Circulate each corner counter clockwise from the next corner, the corner is regular
+    // if it comes back after six interior faces
+    for (size_t c = 0; c < 3; c++) {
+        Index edge = corners[c];
+        for (size_t i = 0; i < 6; i++) {
+            if (mEdges[edge].face >= EdgeState::Uninitialized) return false;
+            if (i >= 2 && i <= 4) {
+                control[3 + 3 * c + i - 2] = mVerts.pos[mEdges[mEdges[edge].pair].vert];
+            }
+            edge = mEdges[Prev(edge)].pair;
+            if (edge == corners[c] && i < 5) return false;
+        }
+        if (edge != corners[c]) return false;
+    }
+    return true;
+}
+
 //! Return weights for interior verts
 float LoopSubdivisionMesh::Beta(size_t valence) {
     if (valence == 6) {
@@ -14,6 +14,7 @@
 
 #include "Geometry/HalfEdgeMesh.h"
 #include "Subdivision.h"
+#include "StencilTable.h"
 
 /*! \brief Subdivision mesh that implements the Loop scheme
  */
@@ -24,11 +25,38 @@ public:
 
     virtual ~LoopSubdivisionMesh() {}
 
-    //! Subdivides the mesh uniformly one step
+    //! Subdivides the mesh uniformly one step, building the refined mesh by index
     virtual void Subdivide();
 
     virtual const char* GetTypeName() { return typeid(LoopSubdivisionMesh).name(); }
 
+    /*! Subdivides the mesh uniformly levels steps, and precomputes how the refined
+     * vertices follow the current ones. The current vertices become the control
+     * vertices, and the connectivity is only built once.
+     * \return the stencils from the control vertices to the refined vertices
+     */
+    StencilTable BuildStencilTable(size_t levels);
+
+    /*! Moves the vertices to the refinement of new control positions, for example
+     * of a deformed control mesh
+     * \param[in] stencils the table from BuildStencilTable()
+     * \return false if the table does not belong to the mesh or the control positions
+     */
+    bool ApplyStencilTable(const StencilTable& stencils, const std::vector<glm::vec3>& control);
+
+    //! The position of a vertex on the limit surface
+    glm::vec3 LimitPosition(size_t vertexIndex) const;
+
+    //! The normal of the limit surface at a vertex
+    glm::vec3 LimitNormal(size_t vertexIndex) const;
+
+    /*! Evaluates the limit surface in a face, without subdividing the mesh
+     * \param[in] u, v the barycentric coordinates of the second and third vertex of
+     * FaceVertices(), with 0 <= u, v and u + v <= 1
+     */
+    void EvaluateLimit(size_t faceIndex, float u, float v, glm::vec3& position,
+                       glm::vec3& normal) const;
+
     //! Return weights for interior verts
     static float Beta(size_t valence);
 
@@ -36,7 +64,8 @@ protected:
     //! The number of accumulated subdivisions
     size_t mNumSubDivs;
 
-    //! Subdivides the face at faceIndex and returns a vector of faces
+    //! Subdivides the face at faceIndex and returns a vector of faces, for
+    //! subclasses that build the refined mesh face by face
     virtual std::vector<std::vector<glm::vec3>> Subdivide(size_t faceIndex);
 
     //! Computes a new vertex, replacing a vertex in the old mesh
@@ -44,6 +73,26 @@ protected:
 
     //! Computes a new vertex, placed along an edge in the old mesh
     virtual glm::vec3 EdgeRule(size_t edgeIndex);
+
+    //! The positions of the vertices after one uniform step, from VertexRule() and EdgeRule()
+    std::vector<glm::vec3> RefinedPositions();
+
+    //! Splits every face in four and places the new vertices at positions
+    void RefineTopology(std::vector<glm::vec3> positions);
+
+    //! The stencils of the vertices of one uniform step in the current vertices
+    std::vector<StencilTable::Stencil> LoopStencils() const;
+
+    /*! Copies the faces around the vertices within radius edges of a face to patch,
+     * the face becomes face 0 of the patch
+     */
+    void ExtractPatch(size_t faceIndex, size_t radius, LoopSubdivisionMesh& patch) const;
+
+    /*! Gathers the 12 control vertices of a face whose corners are interior with valence 6,
+     * in the order of the regular patch in the .cpp
+     * \return false if the face is not regular
+     */
+    bool GetRegularPatch(size_t faceIndex, std::array<glm::vec3, 12>& control) const;
 };
 
 #endif
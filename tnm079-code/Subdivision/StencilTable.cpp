@@ -0,0 +1,87 @@
+#include <Subdivision/StencilTable.h>
+#include <Util/Parallel.h>
+#include <algorithm>
+
+namespace {
+
+//! Sorts a stencil by control vertex and sums the weights of repeated ones
+void Merge(StencilTable::Stencil& stencil) {
+    std::sort(stencil.begin(), stencil.end(),
+              [](const StencilTable::Entry& a, const StencilTable::Entry& b) {
+                  return a.first < b.first;
+              });
+    size_t n = 0;
+    for (size_t i = 0; i < stencil.size(); i++) {
+        if (n > 0 && stencil[n - 1].first == stencil[i].first) {
+            stencil[n - 1].second += stencil[i].second;
+        } else {
+            stencil[n++] = stencil[i];
+        }
+    }
+    stencil.resize(n);
+}
+
+}  // namespace
+
+StencilTable::StencilTable(size_t numControlVerts, std::vector<Stencil> stencils)
+    : mNumControlVerts(numControlVerts) {
+    // Merge every stencil in parallel, then lay them out one after another
+    ParallelFor(stencils.size(), [&](size_t i) { Merge(stencils[i]); }, 256);
+
+    mOffsets.resize(stencils.size() + 1);
+    mOffsets[0] = 0;
+    for (size_t i = 0; i < stencils.size(); i++) {
+        mOffsets[i + 1] = mOffsets[i] + stencils[i].size();
+    }
+    mIndices.resize(mOffsets.back());
+    mWeights.resize(mOffsets.back());
+    ParallelFor(stencils.size(), [&](size_t i) {
+        size_t k = mOffsets[i];
+        for (const Entry& entry : stencils[i]) {
+            mIndices[k] = entry.first;
+            mWeights[k] = entry.second;
+            k++;
+        }
+    });
+}
+
+StencilTable StencilTable::Identity(size_t numVerts) {
+    StencilTable table;
+    table.mNumControlVerts = numVerts;
+    table.mOffsets.resize(numVerts + 1);
+    table.mIndices.resize(numVerts);
+    table.mWeights.assign(numVerts, 1.f);
+    for (size_t i = 0; i < numVerts; i++) {
+        table.mOffsets[i] = i;
+        table.mIndices[i] = i;
+    }
+    table.mOffsets[numVerts] = numVerts;
+    return table;
+}
+
+StencilTable StencilTable::Compose(const StencilTable& control) const {
+    // Each stencil of this table sums the scaled stencils of the intermediate vertices
+    std::vector<Stencil> stencils(GetNumVerts());
+    ParallelFor(stencils.size(), [&](size_t i) {
+        Stencil& stencil = stencils[i];
+        for (size_t k = mOffsets[i]; k < mOffsets[i + 1]; k++) {
+            const Index j = mIndices[k];
+            for (size_t l = control.mOffsets[j]; l < control.mOffsets[j + 1]; l++) {
+                stencil.push_back(Entry(control.mIndices[l], mWeights[k] * control.mWeights[l]));
+            }
+        }
+    }, 256);
+    return StencilTable(control.mNumControlVerts, std::move(stencils));
+}
+
+void StencilTable::Apply(const std::vector<glm::vec3>& control,
+                         std::vector<glm::vec3>& refined) const {
+    refined.resize(GetNumVerts());
+    ParallelFor(refined.size(), [&](size_t i) {
+        glm::vec3 sum(0.f, 0.f, 0.f);
+        for (size_t k = mOffsets[i]; k < mOffsets[i + 1]; k++) {
+            sum += mWeights[k] * control[mIndices[k]];
+        }
+        refined[i] = sum;
+    });
+}
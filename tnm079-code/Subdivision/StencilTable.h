@@ -0,0 +1,52 @@
+#pragma once
+
+#include <Geometry/Mesh.h>
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include <glm.hpp>
+
+/*! \brief Sparse weights that express refined vertices in control vertices
+ *
+ * The stencil of refined vertex i is the weighted sum of control vertices stored
+ * in mIndices and mWeights, from mOffsets[i] to mOffsets[i + 1], sorted by control
+ * vertex. Once built for a control mesh, new control positions are refined by a
+ * parallel sparse matrix-vector product, without touching the connectivity, in the
+ * manner of the CPU stencil tables of OpenSubdiv.
+ */
+class StencilTable {
+public:
+    typedef Mesh::Index Index;
+    //! A control vertex and its weight
+    typedef std::pair<Index, float> Entry;
+    //! The entries of one stencil, in any order and possibly repeated
+    typedef std::vector<Entry> Stencil;
+
+    StencilTable() : mNumControlVerts(0) {}
+
+    //! Builds the table from one stencil per refined vertex, repeated control vertices are summed
+    StencilTable(size_t numControlVerts, std::vector<Stencil> stencils);
+
+    //! The table that maps every vertex to itself
+    static StencilTable Identity(size_t numVerts);
+
+    size_t GetNumControlVerts() const { return mNumControlVerts; }
+    size_t GetNumVerts() const { return mOffsets.empty() ? 0 : mOffsets.size() - 1; }
+    size_t GetNumWeights() const { return mWeights.size(); }
+
+    /*! Chains two refinements. This table maps the vertices of some level to the next,
+     * control maps the control vertices to that level.
+     * \return the stencils of this table in the control vertices of control
+     */
+    StencilTable Compose(const StencilTable& control) const;
+
+    //! Computes the refined positions from the control positions
+    void Apply(const std::vector<glm::vec3>& control, std::vector<glm::vec3>& refined) const;
+
+protected:
+    size_t mNumControlVerts;
+
+    std::vector<size_t> mOffsets;
+    std::vector<Index> mIndices;
+    std::vector<float> mWeights;
+};
@@ -1,13 +1,42 @@
 #include <Subdivision/UniformCubicSpline.h>
+#include <Util/Parallel.h>
+#include <algorithm>
 #include <glm.hpp>
 #include <gtc/type_ptr.hpp>
 
+namespace {
+
+//! The uniform cubic B-spline basis matrix, from four coefficients to the powers of f
+const float BasisMatrix[4][4] = {
+    {1.f / 6.f, 4.f / 6.f, 1.f / 6.f, 0.f},
+    {-3.f / 6.f, 0.f, 3.f / 6.f, 0.f},
+    {3.f / 6.f, -6.f / 6.f, 3.f / 6.f, 0.f},
+    {-1.f / 6.f, 3.f / 6.f, -3.f / 6.f, 1.f / 6.f},
+};
+
+}  // namespace
+
 UniformCubicSpline::UniformCubicSpline(const std::vector<glm::vec3>& joints, glm::vec3 lineColor,
                                        float lineWidth, float segmentLength)
     : mCoefficients(joints), mControlPolygon(joints) {
     this->mLineColor = lineColor;
     this->mLineWidth = lineWidth;
     this->mDt = segmentLength;
+    this->mBSplineEvaluations = 0;
+
+    // Only the four B-splines of the coefficients s to s + 3 are non-zero in a segment
+    if (mCoefficients.size() >= 4) {
+        mSegments.resize(mCoefficients.size() - 3);
+        for (size_t s = 0; s < mSegments.size(); s++) {
+            for (size_t k = 0; k < 4; k++) {
+                glm::vec3 sum(0.f, 0.f, 0.f);
+                for (size_t j = 0; j < 4; j++) {
+                    sum += BasisMatrix[k][j] * mCoefficients[s + j];
+                }
+                mSegments[s][k] = sum;
+            }
+        }
+    }
 }
 
 /*! The BSpline value is calculated from one of the four cardinal BSpline
@@ -41,18 +70,37 @@ float UniformCubicSpline::GetBSplineValue(size_t i, float t) {
     return 0.f;
 }
 
-/*! Evaluate the spline as the sum of the coefficients times the bsplines */
+/*! Evaluate the spline as the sum of the coefficients times the bsplines. Only
+ * the bsplines from floor(t) - 1 to floor(t) + 2 are non-zero at t
+ */
 glm::vec3 UniformCubicSpline::GetValue(float t) {
-    glm::vec3 val;
-    float sum = 0;
-    for (size_t i = 0; i < mCoefficients.size(); i++) {
-        float bval = GetBSplineValue(i, t);
-        val += mCoefficients.at(i) * bval;
-        sum += bval;
+    glm::vec3 val(0.f, 0.f, 0.f);
+    const long first = std::max(0L, long(std::floor(t)) - 1);
+    const long last = std::min(long(mCoefficients.size()) - 1, long(std::floor(t)) + 2);
+    for (long i = first; i <= last; i++) {
+        val += mCoefficients[i] * GetBSplineValue(i, t);
     }
     return val;
 }
 
+glm::vec3 UniformCubicSpline::Evaluate(float t) const {
+    if (mSegments.empty()) return glm::vec3(0.f, 0.f, 0.f);
+    // The end of the last segment belongs to it
+    const float first = 1.f;
+    const float last = float(mSegments.size()) + 1.f;
+    t = std::min(std::max(t, first), last);
+    const size_t s = std::min(size_t(t - first), mSegments.size() - 1);
+    const float f = t - first - float(s);
+    const std::array<glm::vec3, 4>& c = mSegments[s];
+    return c[0] + f * (c[1] + f * (c[2] + f * c[3]));
+}
+
+void UniformCubicSpline::Evaluate(const std::vector<float>& ts,
+                                  std::vector<glm::vec3>& values) const {
+    values.resize(ts.size());
+    ParallelFor(ts.size(), [&](size_t i) { values[i] = Evaluate(ts[i]); });
+}
+
 void UniformCubicSpline::Render() {
     // Apply transform
     glPushMatrix();  // Push modelview matrix onto stack
@@ -66,21 +114,24 @@ void UniformCubicSpline::Render() {
     // save line point and color states
     glPushAttrib(GL_POINT_BIT | GL_LINE_BIT | GL_CURRENT_BIT);
 
+    // We only have full BSpline support from spline at index 1, thus we begin
+    // evaluating at 1.0
+    std::vector<float> ts;
+    for (float i = 1; i < mCoefficients.size() - 2; i += mDt) {
+        ts.push_back(i);
+    }
+    std::vector<glm::vec3> points;
+    Evaluate(ts, points);
+
     // draw segments
     glLineWidth(mLineWidth);
     glColor3fv(glm::value_ptr(mLineColor));
     glBegin(GL_LINE_STRIP);
-
-    // We only have full BSpline support from spline at index 1, thus we begin
-    // evaluating at 1.0
-    mBSplineEvaluations = 0;
-    for (float i = 1; i < mCoefficients.size() - 2; i += mDt) {
-        glVertex3fv(glm::value_ptr(this->GetValue(i)));
+    for (const glm::vec3& point : points) {
+        glVertex3fv(glm::value_ptr(point));
     }
     glEnd();
 
-    std::cout << "Number of B-spline evaluations " << mBSplineEvaluations << std::endl;
-
     // restore attribs
     glPopAttrib();
 
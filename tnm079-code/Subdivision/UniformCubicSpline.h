@@ -14,6 +14,7 @@
 
 #include <Geometry/Geometry.h>
 #include <Geometry/LineStrip.h>
+#include <array>
 #include <cmath>
 #include <iostream>
 #include <vector>
@@ -32,6 +33,14 @@ public:
     /*! Evaluate the spline as the sum of the coefficients times the bsplines */
     glm::vec3 GetValue(float t);
 
+    /*! Evaluates the spline from the four coefficients of the segment containing t,
+     * t is clamped to the parameter range [1, n - 2] of full support
+     */
+    glm::vec3 Evaluate(float t) const;
+
+    //! Evaluates the spline at every parameter in ts, in parallel
+    void Evaluate(const std::vector<float>& ts, std::vector<glm::vec3>& values) const;
+
     virtual void Update() {}
     virtual void Initialize() {}
 
@@ -44,6 +53,10 @@ protected:
     std::vector<glm::vec3> mCoefficients;
     //! The control polygon is simply a LineStrip
     LineStrip mControlPolygon;
+    /*! The power basis coefficients of each segment of full support, segment s covers
+     * t in [s + 1, s + 2] and is a + b f + c f^2 + d f^3 with f = t - (s + 1)
+     */
+    std::vector<std::array<glm::vec3, 4>> mSegments;
 
     //! Decides the length of the linear approximating segments used when drawing
     float mDt;
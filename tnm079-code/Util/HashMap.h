@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+//! Mixes the bits of a 64 bit key (finalizer from MurmurHash3)
+inline uint64_t HashKey(uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return key;
+}
+
+//! Packs an unordered pair of 32 bit indices into a single 64 bit key
+inline uint64_t PackPairKey(size_t i1, size_t i2) {
+    const uint64_t lo = static_cast<uint64_t>(i1 < i2 ? i1 : i2);
+    const uint64_t hi = static_cast<uint64_t>(i1 < i2 ? i2 : i1);
+    return (lo << 32) | (hi & 0xffffffffULL);
+}
+
+//! An unordered pair of 64 bit indices, for indices that do not fit PackPairKey()
+struct PairKey {
+    PairKey() : lo(0), hi(0) {}
+    PairKey(uint64_t i1, uint64_t i2) : lo(i1 < i2 ? i1 : i2), hi(i1 < i2 ? i2 : i1) {}
+    bool operator==(const PairKey& key) const { return lo == key.lo && hi == key.hi; }
+
+    uint64_t lo, hi;
+};
+
+inline uint64_t HashKey(const PairKey& key) { return HashKey(key.lo ^ HashKey(key.hi)); }
+
+/*! \brief Open addressing hash map from 64 bit keys, or PairKeys, to values
+ *
+ * Keys and values are stored contiguously and collisions are resolved with
+ * linear probing in a power of two sized table. Entries can not be erased,
+ * which is all we need when building meshes.
+ */
+template <typename Value, typename Key = uint64_t>
+class HashMap {
+public:
+    HashMap() : mSize(0) {}
+
+    //! Makes room for n entries without rehashing
+    void reserve(size_t n) {
+        size_t capacity = 16;
+        while (capacity < 2 * n) {
+            capacity *= 2;
+        }
+        if (capacity > mSlots.size()) {
+            rehash(capacity);
+        }
+    }
+
+    //! Returns a pointer to the value stored at key, or NULL if not found
+    Value* find(const Key& key) {
+        if (mSlots.empty()) {
+            return NULL;
+        }
+        const size_t mask = mSlots.size() - 1;
+        for (size_t i = HashKey(key) & mask;; i = (i + 1) & mask) {
+            Slot& slot = mSlots[i];
+            if (!slot.used) return NULL;
+            if (slot.key == key) return &slot.value;
+        }
+    }
+    const Value* find(const Key& key) const { return const_cast<HashMap*>(this)->find(key); }
+
+    /*! Inserts value at key unless the key is already present
+     * \return a pointer to the stored value and true if it was inserted
+     */
+    std::pair<Value*, bool> insert(const Key& key, const Value& value) {
+        if (2 * (mSize + 1) > mSlots.size()) {
+            rehash(mSlots.empty() ? 16 : 2 * mSlots.size());
+        }
+        const size_t mask = mSlots.size() - 1;
+        for (size_t i = HashKey(key) & mask;; i = (i + 1) & mask) {
+            Slot& slot = mSlots[i];
+            if (!slot.used) {
+                slot.used = true;
+                slot.key = key;
+                slot.value = value;
+                mSize++;
+                return {&slot.value, true};
+            }
+            if (slot.key == key) return {&slot.value, false};
+        }
+    }
+
+    inline size_t size() const { return mSize; }
+    inline bool isEmpty() const { return mSize == 0; }
+    //! Bytes allocated for the table
+    inline size_t memory() const { return mSlots.capacity() * sizeof(Slot); }
+
+    //! Removes all entries and releases the memory
+    void clear() {
+        std::vector<Slot>().swap(mSlots);
+        mSize = 0;
+    }
+
+protected:
+    struct Slot {
+        Slot() : key(), value(), used(false) {}
+        Key key;
+        Value value;
+        bool used;
+    };
+
+    void rehash(size_t capacity) {
+        std::vector<Slot> old(capacity);
+        old.swap(mSlots);
+        mSize = 0;
+        for (const Slot& slot : old) {
+            if (slot.used) insert(slot.key, slot.value);
+        }
+    }
+
+    std::vector<Slot> mSlots;
+    size_t mSize;
+};
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <limits>
+#include <ostream>
+#include <vector>
+
+/*! \brief Binary min heap of the ids 0 to n - 1, keyed on a float cost
+ *
+ * Each node stores the cost next to its id, so comparisons stay inside one
+ * contiguous array instead of following a pointer per node as Heap does. A
+ * position table maps every id to its node for update() and remove(). The
+ * percolation is the same as in Heap, so equal costs leave the heap in the
+ * same order.
+ */
+template <typename Id>
+class IndexedHeap {
+public:
+    //! Number of calls of each operation since the last reset(), for profiling
+    struct Counts {
+        size_t push = 0;
+        size_t pop = 0;
+        size_t update = 0;
+        size_t remove = 0;
+    };
+
+    IndexedHeap() { reset(0); }
+
+    //! Empties the heap and makes room for the ids 0 to n - 1
+    void reset(size_t n) {
+        // Keep a sentinel (dummy node) at the root for convenience
+        mNodes.assign(1, Node{-(std::numeric_limits<float>::max)(), NotInHeap});
+        mNodes.reserve(n + 1);
+        mPositions.assign(n, NotInHeap);
+        mCounts = Counts();
+    }
+
+    void push(Id id, float cost) {
+        assert(!contains(id));
+        mCounts.push++;
+        mNodes.push_back(Node{cost, id});
+        percolateUp(mNodes.size() - 1);
+    }
+
+    //! The id with the lowest cost, the heap must not be empty
+    Id peek() const { return mNodes[1].id; }
+
+    //! Removes and returns the id with the lowest cost, the heap must not be empty
+    Id pop() {
+        const Id id = mNodes[1].id;
+        mCounts.pop++;
+        erase(id);
+        return id;
+    }
+
+    void remove(Id id) {
+        mCounts.remove++;
+        erase(id);
+    }
+
+    //! Changes the cost of an id in the heap
+    void update(Id id, float cost) {
+        assert(contains(id));
+        mCounts.update++;
+
+        const size_t hole = mPositions[id];
+        mNodes[hole].cost = cost;
+        if (cost < mNodes[parent(hole)].cost) {
+            percolateUp(hole);
+        } else {
+            percolateDown(hole);
+        }
+    }
+
+    //! False for ids that are not in the heap, including ids outside 0 to n - 1
+    bool contains(Id id) const { return id < mPositions.size() && mPositions[id] != NotInHeap; }
+
+    size_t size() const { return mNodes.size() - 1; }
+    bool isEmpty() const { return size() == 0; }
+    const Counts& counts() const { return mCounts; }
+
+    void print(std::ostream& os) const {
+        for (size_t i = 1; i < mNodes.size(); i++) {
+            os << mNodes[i].cost << "(" << mNodes[i].id << ") ";
+        }
+        os << std::endl;
+    }
+
+protected:
+    static constexpr Id NotInHeap = (std::numeric_limits<Id>::max)();
+
+    struct Node {
+        float cost;
+        Id id;
+    };
+
+    static size_t parent(size_t i) { return i / 2; }
+    static size_t leftChild(size_t i) { return 2 * i; }
+    static size_t rightChild(size_t i) { return 2 * i + 1; }
+
+    void erase(Id id) {
+        assert(contains(id));
+
+        const size_t hole = mPositions[id];
+        const float cost = mNodes[hole].cost;
+        mNodes[hole] = mNodes.back();
+        mNodes.pop_back();
+        mPositions[id] = NotInHeap;
+
+        if (hole == mNodes.size()) {
+            return;
+        }
+
+        if (mNodes[hole].cost < cost) {
+            percolateUp(hole);
+        } else {
+            percolateDown(hole);
+        }
+    }
+
+    void percolateUp(size_t hole) {
+        const Node start = mNodes[hole];
+        while (start.cost < mNodes[parent(hole)].cost) {
+            mNodes[hole] = mNodes[parent(hole)];
+            mPositions[mNodes[hole].id] = static_cast<Id>(hole);
+            hole = parent(hole);
+        }
+        mNodes[hole] = start;
+        mPositions[start.id] = static_cast<Id>(hole);
+    }
+
+    void percolateDown(size_t hole) {
+        const Node start = mNodes[hole];
+        const size_t currentSize = mNodes.size();
+
+        while (leftChild(hole) < currentSize) {
+            const size_t left = leftChild(hole);
+            const size_t right = rightChild(hole);
+            size_t child = left;
+            if (right < currentSize && mNodes[right].cost < mNodes[left].cost) {
+                child = right;
+            }
+
+            if (mNodes[child].cost < start.cost) {
+                mNodes[hole] = mNodes[child];
+                mPositions[mNodes[hole].id] = static_cast<Id>(hole);
+            } else {
+                break;
+            }
+
+            hole = child;
+        }
+        mNodes[hole] = start;
+        mPositions[start.id] = static_cast<Id>(hole);
+    }
+
+    std::vector<Node> mNodes;
+    //! The node of each id, or NotInHeap
+    std::vector<Id> mPositions;
+    Counts mCounts;
+};
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*! \brief Read only memory mapping of a file
+ *
+ * The contents are paged in by the OS on demand, so parsers can work directly
+ * on the file data without copying it into stream buffers first.
+ */
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& filename) : mData(NULL), mSize(0), mOpen(false) {
+#ifdef _WIN32
+        mFile = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        mMapping = NULL;
+        if (mFile == INVALID_HANDLE_VALUE) return;
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(mFile, &size)) return;
+        mSize = static_cast<size_t>(size.QuadPart);
+        mOpen = true;
+        if (mSize == 0) return;
+        mMapping = CreateFileMappingA(mFile, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mMapping == NULL) {
+            mOpen = false;
+            return;
+        }
+        mData = static_cast<const char*>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+        mOpen = (mData != NULL);
+#else
+        mFile = open(filename.c_str(), O_RDONLY);
+        if (mFile < 0) return;
+        struct stat st;
+        if (fstat(mFile, &st) != 0) return;
+        mSize = static_cast<size_t>(st.st_size);
+        mOpen = true;
+        if (mSize == 0) return;
+        void* data = mmap(NULL, mSize, PROT_READ, MAP_PRIVATE, mFile, 0);
+        if (data == MAP_FAILED) {
+            mOpen = false;
+            return;
+        }
+        madvise(data, mSize, MADV_SEQUENTIAL);
+        mData = static_cast<const char*>(data);
+#endif
+    }
+
+    ~MappedFile() {
+#ifdef _WIN32
+        if (mData != NULL) UnmapViewOfFile(mData);
+        if (mMapping != NULL) CloseHandle(mMapping);
+        if (mFile != INVALID_HANDLE_VALUE) CloseHandle(mFile);
+#else
+        if (mData != NULL) munmap(const_cast<char*>(mData), mSize);
+        if (mFile >= 0) close(mFile);
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    inline bool IsOpen() const { return mOpen; }
+    inline const char* GetData() const { return mData; }
+    inline size_t GetSize() const { return mSize; }
+
+protected:
+    const char* mData;
+    size_t mSize;
+    bool mOpen;
+
+#ifdef _WIN32
+    HANDLE mFile;
+    HANDLE mMapping;
+#else
+    int mFile;
+#endif
+};
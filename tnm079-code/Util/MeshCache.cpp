@@ -0,0 +1,159 @@
+#include <Util/MeshCache.h>
+#include <Geometry/Mesh.h>
+#include <cstring>
+#include <fstream>
+
+namespace {
+
+//! Returns true if the host stores integers little endian, as the file does
+inline bool LittleEndian() {
+    const uint32_t one = 1;
+    unsigned char first;
+    std::memcpy(&first, &one, 1);
+    return first == 1;
+}
+
+template <typename T>
+inline void WriteArray(std::ostream& os, const T* data, size_t count) {
+    os.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(sizeof(T) * count));
+}
+
+}  // namespace
+
+MeshCache::Data::Data()
+    : numVerts(0)
+    , numFaces(0)
+    , numEdges(0)
+    , positions(NULL)
+    , tris(NULL)
+    , edges(NULL)
+    , vertEdges(NULL)
+    , faceEdges(NULL)
+    , normals(NULL)
+    , curvature(NULL) {}
+
+bool MeshCache::Write(std::ostream& os, const Data& data) {
+    if (!LittleEndian()) {
+        std::cerr << "Error: mesh cache files can only be written on little endian hosts"
+                  << std::endl;
+        return false;
+    }
+    if (data.positions == NULL || data.tris == NULL) {
+        std::cerr << "Error: mesh cache needs positions and triangles" << std::endl;
+        return false;
+    }
+
+    const bool halfEdges = data.edges != NULL && data.vertEdges != NULL && data.faceEdges != NULL;
+
+    Header header;
+    header.magic = Magic;
+    header.version = Version;
+    header.flags = (halfEdges ? HalfEdges : 0) | (data.normals != NULL ? VertexNormals : 0) |
+                   (data.curvature != NULL ? VertexCurvature : 0);
+    header.reserved = 0;
+    header.numVerts = data.numVerts;
+    header.numFaces = data.numFaces;
+    header.numEdges = halfEdges ? data.numEdges : 0;
+
+    WriteArray(os, &header, 1);
+    WriteArray(os, data.positions, data.numVerts);
+    WriteArray(os, data.tris, data.numFaces);
+    if (halfEdges) {
+        WriteArray(os, data.edges, data.numEdges);
+        WriteArray(os, data.vertEdges, data.numVerts);
+        WriteArray(os, data.faceEdges, data.numFaces);
+    }
+    if (data.normals != NULL) WriteArray(os, data.normals, data.numVerts);
+    if (data.curvature != NULL) WriteArray(os, data.curvature, data.numVerts);
+    return os.good();
+}
+
+bool MeshCache::Load(Mesh* mesh, const std::string& filename) {
+    MeshCache cache(filename);
+    if (!cache.IsValid()) {
+        return false;
+    }
+    return mesh->LoadCache(cache);
+}
+
+bool MeshCache::Save(Mesh* mesh, const std::string& filename) {
+    std::ofstream os(filename.c_str(), std::ios::binary);
+    if (!os) {
+        std::cerr << "Error: could not open '" << filename << "' for writing" << std::endl;
+        return false;
+    }
+    return mesh->SaveCache(os);
+}
+
+MeshCache::MeshCache(const std::string& filename)
+    : mFile(filename)
+    , mValid(false)
+    , mPositions(NULL)
+    , mTris(NULL)
+    , mEdges(NULL)
+    , mVertEdges(NULL)
+    , mFaceEdges(NULL)
+    , mNormals(NULL)
+    , mCurvature(NULL) {
+    std::memset(&mHeader, 0, sizeof(Header));
+    if (!mFile.IsOpen()) {
+        std::cerr << "Error: could not open '" << filename << "'" << std::endl;
+        return;
+    }
+    if (mFile.GetSize() < sizeof(Header)) {
+        std::cerr << "Error: '" << filename << "' is not a mesh cache file" << std::endl;
+        return;
+    }
+    std::memcpy(&mHeader, mFile.GetData(), sizeof(Header));
+    if (mHeader.magic != Magic || !LittleEndian()) {
+        std::cerr << "Error: '" << filename << "' is not a mesh cache file" << std::endl;
+        return;
+    }
+    if (mHeader.version != Version) {
+        std::cerr << "Error: '" << filename << "' has mesh cache version " << mHeader.version
+                  << ", expected " << Version << std::endl;
+        return;
+    }
+
+    // Every section is a multiple of 4 bytes after the 8 byte aligned header,
+    // so the arrays can be used in place
+    const uint64_t nv = mHeader.numVerts, nf = mHeader.numFaces, ne = mHeader.numEdges;
+    // Counts that do not fit in the file could wrap the expected size around to it.
+    // Within these bounds every term is at most the file size and the sum can not wrap.
+    const uint64_t size = mFile.GetSize();
+    if (nv > size / sizeof(glm::vec3) || nf > size / sizeof(glm::uvec3) ||
+        ne > size / sizeof(HalfEdge)) {
+        std::cerr << "Error: '" << filename << "' is truncated or corrupt" << std::endl;
+        return;
+    }
+    uint64_t expected = sizeof(Header) + nv * sizeof(glm::vec3) + nf * sizeof(glm::uvec3);
+    if (Has(HalfEdges)) expected += ne * sizeof(HalfEdge) + (nv + nf) * sizeof(uint32_t);
+    if (Has(VertexNormals)) expected += nv * sizeof(glm::vec3);
+    if (Has(VertexCurvature)) expected += nv * sizeof(float);
+    if (expected != size) {
+        std::cerr << "Error: '" << filename << "' is truncated or corrupt" << std::endl;
+        return;
+    }
+
+    const char* p = mFile.GetData() + sizeof(Header);
+    mPositions = reinterpret_cast<const glm::vec3*>(p);
+    p += nv * sizeof(glm::vec3);
+    mTris = reinterpret_cast<const glm::uvec3*>(p);
+    p += nf * sizeof(glm::uvec3);
+    if (Has(HalfEdges)) {
+        mEdges = reinterpret_cast<const HalfEdge*>(p);
+        p += ne * sizeof(HalfEdge);
+        mVertEdges = reinterpret_cast<const uint32_t*>(p);
+        p += nv * sizeof(uint32_t);
+        mFaceEdges = reinterpret_cast<const uint32_t*>(p);
+        p += nf * sizeof(uint32_t);
+    }
+    if (Has(VertexNormals)) {
+        mNormals = reinterpret_cast<const glm::vec3*>(p);
+        p += nv * sizeof(glm::vec3);
+    }
+    if (Has(VertexCurvature)) {
+        mCurvature = reinterpret_cast<const float*>(p);
+    }
+    mValid = true;
+}
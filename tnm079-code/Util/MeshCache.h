@@ -0,0 +1,107 @@
+#pragma once
+
+#include <Util/MappedFile.h>
+#include <cstdint>
+#include <glm.hpp>
+#include <iostream>
+#include <limits>
+#include <string>
+
+class Mesh;
+
+/*! \brief Versioned binary mesh format that can be loaded without parsing
+ *
+ * The file is a fixed size header followed by tightly packed little endian
+ * arrays, in this order:
+ *  - positions, 3 floats per vertex
+ *  - triangles, 3 uint32 vertex indices per face
+ *  - (HalfEdges) half edges as vert, face, next and pair uint32 indices,
+ *    followed by one uint32 edge index per vertex and one per face
+ *  - (VertexNormals) normals, 3 floats per vertex
+ *  - (VertexCurvature) curvature, 1 float per vertex
+ *
+ * Loading maps the file and reads the arrays in place, so reopening a mesh
+ * that already has its connectivity computed costs little more than a copy.
+ */
+class MeshCache {
+public:
+    static const uint32_t Magic = 0x43416f4d;  // "MoAC"
+    //! Version 1 also stored the previous half edge, which is derived from next
+    static const uint32_t Version = 2;
+
+    //! Optional sections present in the file
+    enum Flags : uint32_t { HalfEdges = 1, VertexNormals = 2, VertexCurvature = 4 };
+
+    //! Index used for border and uninitialized half edge links
+    static const uint32_t Invalid = std::numeric_limits<uint32_t>::max();
+
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t flags;
+        uint32_t reserved;
+        uint64_t numVerts;
+        uint64_t numFaces;
+        uint64_t numEdges;
+    };
+
+    //! Half edge as stored in the file
+    struct HalfEdge {
+        uint32_t vert, face, next, pair;
+    };
+
+    //! Arrays to write, the optional ones are skipped when NULL
+    struct Data {
+        Data();
+        size_t numVerts;
+        size_t numFaces;
+        size_t numEdges;
+        const glm::vec3* positions;
+        const glm::uvec3* tris;
+        const HalfEdge* edges;
+        const uint32_t* vertEdges;
+        const uint32_t* faceEdges;
+        const glm::vec3* normals;
+        const float* curvature;
+    };
+
+    //! Writes a mesh cache, the stream should be opened in binary mode
+    static bool Write(std::ostream& os, const Data& data);
+
+    //! Fills the mesh with the contents of a cache file
+    static bool Load(Mesh* mesh, const std::string& filename);
+    //! Writes the mesh to a cache file
+    static bool Save(Mesh* mesh, const std::string& filename);
+
+    //! Maps a cache file, check IsValid() before reading from it
+    explicit MeshCache(const std::string& filename);
+
+    bool IsValid() const { return mValid; }
+
+    size_t GetNumVerts() const { return static_cast<size_t>(mHeader.numVerts); }
+    size_t GetNumFaces() const { return static_cast<size_t>(mHeader.numFaces); }
+    size_t GetNumEdges() const { return static_cast<size_t>(mHeader.numEdges); }
+    bool Has(Flags flag) const { return (mHeader.flags & flag) != 0; }
+
+    //! The arrays in the mapped file, NULL if not present
+    const glm::vec3* GetPositions() const { return mPositions; }
+    const glm::uvec3* GetTris() const { return mTris; }
+    const HalfEdge* GetEdges() const { return mEdges; }
+    const uint32_t* GetVertEdges() const { return mVertEdges; }
+    const uint32_t* GetFaceEdges() const { return mFaceEdges; }
+    const glm::vec3* GetNormals() const { return mNormals; }
+    const float* GetCurvature() const { return mCurvature; }
+
+protected:
+    MappedFile mFile;
+    Header mHeader;
+    bool mValid;
+
+    const glm::vec3* mPositions;
+    const glm::uvec3* mTris;
+    const HalfEdge* mEdges;
+    const uint32_t* mVertEdges;
+    const uint32_t* mFaceEdges;
+    const glm::vec3* mNormals;
+    const float* mCurvature;
+};
@@ -10,113 +10,327 @@
  *
  *************************************************************************************************/
 #include "ObjIO.h"
-#include "Geometry/HalfEdgeMesh.h"
-#include <cassert>
-#include <iostream>
-#include <sstream>
-#include <string>
-#include <vector>
-#include <Util/Util.h>
+#include <Util/MappedFile.h>
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <thread>
+
+namespace {
+
+//! Files smaller than this are not worth splitting between threads
+const size_t MinChunkSize = 1 << 20;
+
+inline bool IsSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+inline const char* SkipSpace(const char* p, const char* end) {
+    while (p < end && IsSpace(*p)) {
+        p++;
+    }
+    return p;
+}
+
+inline const char* FindLineEnd(const char* p, const char* end) {
+    const char* nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+    return nl != NULL ? nl : end;
+}
+
+//! Parses a float at p, returns NULL on failure
+inline const char* ParseFloat(const char* p, const char* end, float& value) {
+    if (p < end && *p == '+') p++;
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+    std::from_chars_result res = std::from_chars(p, end, value);
+    return res.ec == std::errc() ? res.ptr : NULL;
+#else
+    // strtof needs a terminated string, the mapped file may not have one
+    char buf[64];
+    size_t len = 0;
+    while (p + len < end && len < sizeof(buf) - 1 && !IsSpace(p[len]) && p[len] != '\n') {
+        buf[len] = p[len];
+        len++;
+    }
+    buf[len] = '\0';
+    char* last;
+    value = std::strtof(buf, &last);
+    return last != buf ? p + (last - buf) : NULL;
+#endif
+}
+
+//! Longest text written for a single number
+const size_t MaxNumberLength = 32;
+
+//! Buffered bytes handed to the stream at a time
+const size_t WriteBufferSize = 1 << 16;
+
+//! Parses an integer at p, returns NULL on failure
+inline const char* ParseInt(const char* p, const char* end, long& value) {
+    if (p < end && *p == '+') p++;
+    std::from_chars_result res = std::from_chars(p, end, value);
+    return res.ec == std::errc() ? res.ptr : NULL;
+}
+
+}  // namespace
+
+ObjIO::ObjIO() : mNumThreads(std::thread::hardware_concurrency()) {
+    if (mNumThreads == 0) mNumThreads = 1;
+}
 
 bool ObjIO::Load(Mesh* mesh, std::istream& is) {
-    // std::cerr << "Reading obj file.\nOutputting any skipped line(s) for
-    // reference.\n";
-    bool success = ReadHeader(is);
-    if (!success) {
+    if (!Read(is)) {
+        return false;
+    }
+
+    // Build mesh directly from the index buffer
+    return mesh->Build(loadData.verts, loadData.tris);
+}
+
+bool ObjIO::Load(Mesh* mesh, const std::string& filename) {
+    if (!Read(filename)) {
         return false;
     }
+    return mesh->Build(loadData.verts, loadData.tris);
+}
+
+bool ObjIO::Read(std::istream& is) {
+    // Streams can not be mapped, so read everything in one go
+    std::string data((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+    return ReadData(data.data(), data.data() + data.size());
+}
 
-    success = ReadData(is);
-    if (!success) {
+bool ObjIO::Read(const std::string& filename) {
+    MappedFile file(filename);
+    if (!file.IsOpen()) {
+        std::cerr << "Error: could not open '" << filename << "'" << std::endl;
         return false;
     }
+    return ReadData(file.GetData(), file.GetData() + file.GetSize());
+}
+
+bool ObjIO::ReadData(const char* begin, const char* end) {
+    loadData.verts.clear();
+    loadData.tris.clear();
+
+    // Split the data into chunks at line boundaries
+    const size_t size = end - begin;
+    size_t numChunks = std::max<size_t>(1, std::min(mNumThreads, size / MinChunkSize));
+    std::vector<const char*> bounds(1, begin);
+    for (size_t i = 1; i < numChunks; i++) {
+        const char* p = std::max(bounds.back(), begin + i * (size / numChunks));
+        p = FindLineEnd(p, end);
+        bounds.push_back(p < end ? p + 1 : end);
+    }
+    bounds.push_back(end);
+    numChunks = bounds.size() - 1;
+
+    // Parse the chunks, the first one in this thread
+    std::vector<Chunk> chunks(numChunks);
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < numChunks; i++) {
+        threads.push_back(std::thread(ParseChunk, bounds[i], bounds[i + 1], std::ref(chunks[i])));
+    }
+    ParseChunk(bounds[0], bounds[1], chunks[0]);
+    for (std::thread& t : threads) {
+        t.join();
+    }
 
-    // Build mesh
-    const size_t numTris = loadData.tris.size();
-    for (size_t t = 0; t < numTris; t++) {
-        glm::uvec3& triangle = loadData.tris[t];
-        std::vector<glm::vec3> verts;
-        verts.push_back(loadData.verts[triangle[0]]);
-        verts.push_back(loadData.verts[triangle[1]]);
-        verts.push_back(loadData.verts[triangle[2]]);
+    size_t numVerts = 0, numTris = 0;
+    for (const Chunk& chunk : chunks) {
+        if (chunk.error) {
+            return false;
+        }
+        numVerts += chunk.verts.size();
+        numTris += chunk.tris.size();
+    }
 
-        mesh->AddFace(verts);
+    // Concatenate the chunks, resolving relative (negative) indices
+    loadData.verts.reserve(numVerts);
+    loadData.tris.reserve(numTris);
+    for (Chunk& chunk : chunks) {
+        const unsigned int offset = static_cast<unsigned int>(loadData.verts.size());
+        for (size_t ind : chunk.relative) {
+            chunk.tris[ind / 3][ind % 3] += offset;
+        }
+        loadData.verts.insert(loadData.verts.end(), chunk.verts.begin(), chunk.verts.end());
+        loadData.tris.insert(loadData.tris.end(), chunk.tris.begin(), chunk.tris.end());
     }
     return true;
 }
 
-bool ObjIO::ReadHeader(std::istream& is) {
-    std::string buf;
-    // just read to the first line starting with a 'v'
-    while (!is.eof() && is.peek() != 'v') {
-        getline(is, buf);
-        // std::cerr << "\"" << buf << "\"\n";
+bool ObjIO::Stream(const std::string& filename, size_t blockSize,
+                   const BlockCallback& callback) {
+    MappedFile file(filename);
+    if (!file.IsOpen()) {
+        std::cerr << "Error: could not open '" << filename << "'" << std::endl;
+        return false;
     }
-    return is.good();
+
+    const char* p = file.GetData();
+    const char* end = p + file.GetSize();
+    size_t numVerts = 0;
+    Chunk chunk;
+    while (p < end) {
+        const char* blockEnd = p + std::min<size_t>(std::max<size_t>(blockSize, 1), end - p);
+        if (blockEnd < end) {
+            blockEnd = FindLineEnd(blockEnd, end);
+            blockEnd = blockEnd < end ? blockEnd + 1 : end;
+        }
+
+        // The vectors keep their capacity from block to block
+        chunk.verts.clear();
+        chunk.tris.clear();
+        chunk.relative.clear();
+        ParseChunk(p, blockEnd, chunk);
+        if (chunk.error) {
+            return false;
+        }
+        for (size_t ind : chunk.relative) {
+            chunk.tris[ind / 3][ind % 3] += static_cast<unsigned int>(numVerts);
+        }
+        numVerts += chunk.verts.size();
+        if (!callback(chunk.verts, chunk.tris)) {
+            return false;
+        }
+        p = blockEnd;
+    }
+    return true;
 }
 
-bool ObjIO::ReadData(std::istream& is) {
-    std::string lineBuf;
-    int c;
-    int i = 0;
-    while (!is.eof()) {
-        c = is.peek();
-        switch (c) {
+void ObjIO::ParseChunk(const char* begin, const char* end, Chunk& chunk) {
+    std::vector<long> polygon;
+    std::vector<bool> relative;
+    const char* p = begin;
+    while (p < end) {
+        p = SkipSpace(p, end);
+        const char* lineEnd = FindLineEnd(p, end);
+        if (lineEnd - p < 2 || !IsSpace(p[1])) {
+            // otherwise just skip the row (comments, vt, vn, groups, ...)
+            p = lineEnd + 1;
+            continue;
+        }
+        // A comment may follow the data of a line
+        const char* dataEnd = std::find(p, lineEnd, '#');
+
+        switch (p[0]) {
             case 'V':
             case 'v': {
-                std::string startBuf;
-                is >> startBuf;        // get the start of the line
-                getline(is, lineBuf);  // get the rest of the line
-                if (startBuf == "v") {
-                    loadData.verts.push_back(vec3<float>(lineBuf));
+                glm::vec3 v;
+                const char* q = p + 2;
+                for (int i = 0; i < 3 && q != NULL; i++) {
+                    q = ParseFloat(SkipSpace(q, dataEnd), dataEnd, v[i]);
+                }
+                if (q == NULL) {
+                    std::cerr << "Error: malformed vertex '" << std::string(p, lineEnd) << "'\n";
+                    chunk.error = true;
+                    return;
                 }
+                chunk.verts.push_back(v);
             } break;
             case 'F':
             case 'f': {
-                std::stringstream buf;
-                is.get(*buf.rdbuf(), '\n');  // read a line into buf
-                is.get();                    // read the not extracted \n
-                buf << "\n";                 // and add it to the string stream
-
-                std::string tmp;
-                buf >> tmp;  // get the first f or F (+ whitespace)
-
-                // count the number of faces, delimited by whitespace
-                int count = 0;
-                while (buf >> tmp) {
-                    count++;
+                // Read the vertex index of each v, v/vt, v//vn or v/vt/vn token
+                polygon.clear();
+                const char* q = SkipSpace(p + 2, dataEnd);
+                while (q < dataEnd) {
+                    long ind;
+                    q = ParseInt(q, dataEnd, ind);
+                    if (q == NULL || ind == 0) {
+                        break;
+                    }
+                    polygon.push_back(ind);
+                    while (q < dataEnd && !IsSpace(*q)) {
+                        q++;
+                    }
+                    q = SkipSpace(q, dataEnd);
                 }
-                // reset stream
-                buf.clear();
-                buf.seekg(0, std::ios::beg);
-
-                // Determine wheter we have a triangle or a quad
-                if (count == 3) {
-                    loadData.tris.push_back(ReadTri(buf));
-                } else {
-                    std::cerr << "Encountered polygon with " << count << " faces. Bailing out.\n";
-                    return false;
+                if (q == NULL || polygon.size() < 3 || q < dataEnd) {
+                    std::cerr << "Error: malformed face '" << std::string(p, lineEnd) << "'\n";
+                    chunk.error = true;
+                    return;
+                }
+
+                // obj file format is 1-based, negative indices count backwards
+                // from the last vertex read and are fixed up once the number of
+                // vertices in the preceding chunks is known
+                relative.assign(polygon.size(), false);
+                for (size_t i = 0; i < polygon.size(); i++) {
+                    if (polygon[i] > 0) {
+                        polygon[i] -= 1;
+                    } else {
+                        polygon[i] += static_cast<long>(chunk.verts.size());
+                        relative[i] = true;
+                    }
+                }
+
+                // Fan triangulate polygons
+                for (size_t i = 1; i + 1 < polygon.size(); i++) {
+                    const size_t corners[3] = {0, i, i + 1};
+                    glm::uvec3 tri;
+                    for (size_t c = 0; c < 3; c++) {
+                        tri[c] = static_cast<unsigned int>(polygon[corners[c]]);
+                        if (relative[corners[c]]) {
+                            chunk.relative.push_back(3 * chunk.tris.size() + c);
+                        }
+                    }
+                    chunk.tris.push_back(tri);
                 }
             } break;
             default:
-                // otherwise just skip the row
-                getline(is, lineBuf);
-                // output it so we see what we miss :)
-                // std::cerr << "\"" << lineBuf << "\"\n";
                 break;
         }
-        i++;
+        p = lineEnd + 1;
     }
-    return true;
 }
 
-glm::uvec3 ObjIO::ReadTri(std::istream& is) {
-    //  This is a simplified version of an obj reader that can't read normal and
-    //  texture indices
-    std::string buf, v;
-    is >> buf;
-    assert(buf == "f" || buf == "F");
+ObjWriter::ObjWriter(std::ostream& os) : mStream(os), mBuffer(WriteBufferSize), mSize(0) {}
+
+void ObjWriter::Comment(const std::string& text) {
+    Flush();
+    mStream << "# " << text << "\n";
+}
+
+void ObjWriter::AddVertex(const glm::vec3& v) {
+    if (mSize + 4 * MaxNumberLength > mBuffer.size()) Flush();
+    mBuffer[mSize++] = 'v';
+    for (int i = 0; i < 3; i++) {
+        mBuffer[mSize++] = ' ';
+        Put(v[i]);
+    }
+    mBuffer[mSize++] = '\n';
+}
+
+void ObjWriter::AddFace(size_t v1, size_t v2, size_t v3) {
+    if (mSize + 4 * MaxNumberLength > mBuffer.size()) Flush();
+    mBuffer[mSize++] = 'f';
+    const size_t inds[3] = {v1, v2, v3};
+    for (size_t ind : inds) {
+        mBuffer[mSize++] = ' ';
+        Put(ind + 1);
+    }
+    mBuffer[mSize++] = '\n';
+}
+
+bool ObjWriter::Flush() {
+    if (mSize > 0) {
+        mStream.write(mBuffer.data(), mSize);
+        mSize = 0;
+    }
+    return mStream.good();
+}
+
+void ObjWriter::Put(float value) {
+    char* p = mBuffer.data() + mSize;
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+    // Shortest representation that reads back to the same float
+    mSize += std::to_chars(p, p + MaxNumberLength, value).ptr - p;
+#else
+    mSize += std::snprintf(p, MaxNumberLength, "%.9g", value);
+#endif
+}
 
-    getline(is, v);                                      // read indices
-    return vec3<unsigned int>(v) - glm::uvec3(1, 1, 1);  // obj file format is 1-based
+void ObjWriter::Put(size_t value) {
+    char* p = mBuffer.data() + mSize;
+    mSize += std::to_chars(p, p + MaxNumberLength, value).ptr - p;
 }
@@ -15,21 +15,63 @@
 #include "Geometry/Mesh.h"
 #include <algorithm>
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <string>
+#include <vector>
 #include <glm.hpp>
 
+/*! \brief Loader for Wavefront OBJ files
+ *
+ * The file is memory mapped and parsed in place, in parallel chunks for large
+ * files. Faces may use the v, v/vt, v//vn and v/vt/vn syntax and polygons are
+ * fan triangulated. Texture coordinates and normals are skipped.
+ */
 class ObjIO {
 public:
-    ObjIO() {}
+    ObjIO();
 
     bool Load(Mesh*, std::istream& is);  // false return on error
+    bool Load(Mesh*, const std::string& filename);
+
+    //! Parses the data without building a mesh
+    bool Read(std::istream& is);
+    bool Read(const std::string& filename);
+
+    //! Receives the vertices and triangles of one block of a streamed file
+    typedef std::function<bool(const std::vector<glm::vec3>& verts,
+                               const std::vector<glm::uvec3>& tris)>
+        BlockCallback;
+
+    /*! Parses the file a block at a time without keeping the whole mesh. Triangle
+     * indices refer to all vertices of the file, in the order the blocks are handed out.
+     * \param[in] blockSize number of bytes parsed at a time, rounded up to whole lines
+     * \return false on parse errors, or if the callback returned false
+     */
+    bool Stream(const std::string& filename, size_t blockSize, const BlockCallback& callback);
+
+    //! Sets the maximum number of threads used for parsing
+    void SetNumThreads(size_t numThreads) { mNumThreads = numThreads > 0 ? numThreads : 1; }
+
+    const std::vector<glm::vec3>& GetVerts() const { return loadData.verts; }
+    const std::vector<glm::uvec3>& GetTris() const { return loadData.tris; }
 
 protected:
-    bool ReadHeader(std::istream& is);
-    bool ReadData(std::istream& is);
+    bool ReadData(const char* begin, const char* end);
+
+    //! The parsed contents of one chunk of the file
+    struct Chunk {
+        Chunk() : error(false) {}
+        std::vector<glm::vec3> verts;
+        std::vector<glm::uvec3> tris;
+        //! Positions in tris holding indices relative to the chunk's first vertex
+        std::vector<size_t> relative;
+        bool error;
+    };
+
+    static void ParseChunk(const char* begin, const char* end, Chunk& chunk);
 
-    static glm::uvec3 ReadTri(std::istream& is);
+    size_t mNumThreads;
 
     struct LoadData {
         std::vector<glm::vec3> verts;
@@ -37,4 +79,32 @@ protected:
     } loadData;
 };
 
+/*! \brief Buffered writer for Wavefront OBJ files
+ *
+ * Numbers are formatted directly into a memory buffer that is handed to the
+ * stream in large blocks, instead of going through operator<< per value.
+ */
+class ObjWriter {
+public:
+    explicit ObjWriter(std::ostream& os);
+    ~ObjWriter() { Flush(); }
+
+    //! Writes a '#' comment line
+    void Comment(const std::string& text);
+    void AddVertex(const glm::vec3& v);
+    //! Writes a triangle, the indices are zero based
+    void AddFace(size_t v1, size_t v2, size_t v3);
+
+    //! Writes the buffered data to the stream, returns false on stream errors
+    bool Flush();
+
+protected:
+    void Put(float value);
+    void Put(size_t value);
+
+    std::ostream& mStream;
+    std::vector<char> mBuffer;
+    size_t mSize;
+};
+
 #endif
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+/*! \brief Calls function(i) for every i in [0, count) using all hardware threads
+ *
+ * The range is split in one contiguous block per thread, the first block runs
+ * on the calling thread. Ranges shorter than minBlock per thread are not worth
+ * the thread startup and run serially. The function must not throw and may
+ * only write to data owned by index i.
+ */
+template <typename Function>
+void ParallelFor(size_t count, Function function, size_t minBlock = 2048) {
+    const size_t hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+    const size_t numThreads = std::min(hardwareThreads, count / std::max<size_t>(minBlock, 1));
+    if (numThreads <= 1) {
+        for (size_t i = 0; i < count; i++) {
+            function(i);
+        }
+        return;
+    }
+
+    auto block = [count, numThreads, &function](size_t t) {
+        const size_t end = count * (t + 1) / numThreads;
+        for (size_t i = count * t / numThreads; i < end; i++) {
+            function(i);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(numThreads - 1);
+    for (size_t t = 1; t < numThreads; t++) {
+        threads.push_back(std::thread(block, t));
+    }
+    block(0);
+    for (std::thread& t : threads) {
+        t.join();
+    }
+}
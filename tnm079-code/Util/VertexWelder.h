@@ -0,0 +1,160 @@
+#pragma once
+
+#include <Util/HashMap.h>
+#include <cmath>
+#include <cstring>
+#include <glm.hpp>
+#include <limits>
+
+/*! \brief Hash table used to merge coincident vertices while building a mesh
+ *
+ * With a zero tolerance only bitwise equal positions are merged, which is the
+ * same behaviour as the std::map previously used by the meshes. With a
+ * positive tolerance the positions are quantized into cells of twice the
+ * tolerance, so any vertex closer than the tolerance is found among the 8 cells
+ * closest to the query.
+ */
+class VertexWelder {
+public:
+    static constexpr size_t NotFound = std::numeric_limits<size_t>::max();
+
+    explicit VertexWelder(float tolerance = 0.f) : mTolerance(tolerance), mSize(0) {}
+
+    //! Sets the welding tolerance, clears the table
+    void SetTolerance(float tolerance) {
+        clear();
+        mTolerance = tolerance;
+    }
+    float GetTolerance() const { return mTolerance; }
+
+    //! Makes room for n vertices without rehashing
+    void reserve(size_t n) {
+        size_t capacity = 16;
+        while (capacity < 2 * n) {
+            capacity *= 2;
+        }
+        if (capacity > mSlots.size()) {
+            rehash(capacity);
+        }
+    }
+
+    //! Returns the index of a vertex close to p, or VertexWelder::NotFound
+    size_t find(const glm::vec3& p) const {
+        if (mSlots.empty()) {
+            return NotFound;
+        }
+        if (mTolerance <= 0.f) {
+            return findInCell(p, ExactKey(p));
+        }
+
+        // Search the 2x2x2 block of cells closest to p
+        const glm::vec3 q = p / (2.f * mTolerance);
+        int64_t cell[3], side[3];
+        for (int i = 0; i < 3; i++) {
+            const float c = std::floor(q[i]);
+            cell[i] = static_cast<int64_t>(c);
+            side[i] = (q[i] - c < 0.5f) ? -1 : 1;
+        }
+        for (int n = 0; n < 8; n++) {
+            const size_t ind = findInCell(p, CellKey(cell[0] + ((n & 1) ? side[0] : 0),
+                                                     cell[1] + ((n & 2) ? side[1] : 0),
+                                                     cell[2] + ((n & 4) ? side[2] : 0)));
+            if (ind != NotFound) return ind;
+        }
+        return NotFound;
+    }
+
+    /*! Looks up p and stores it with the given index if no close vertex exists
+     * \return the index of the merged vertex and true if p was inserted
+     */
+    std::pair<size_t, bool> insert(const glm::vec3& p, size_t index) {
+        const size_t found = find(p);
+        if (found != NotFound) {
+            return {found, false};
+        }
+        if (2 * (mSize + 1) > mSlots.size()) {
+            rehash(mSlots.empty() ? 16 : 2 * mSlots.size());
+        }
+        store(p, Key(p), index);
+        return {index, true};
+    }
+
+    inline size_t size() const { return mSize; }
+
+    //! Removes all vertices and releases the memory
+    void clear() {
+        std::vector<Slot>().swap(mSlots);
+        mSize = 0;
+    }
+
+protected:
+    struct Slot {
+        Slot() : key(0), index(NotFound) {}
+        glm::vec3 pos;
+        uint64_t key;
+        size_t index;
+    };
+
+    static uint64_t ExactKey(const glm::vec3& p) {
+        uint32_t bits[3];
+        for (int i = 0; i < 3; i++) {
+            // Make sure -0 and +0 end up in the same bucket
+            const float f = (p[i] == 0.f) ? 0.f : p[i];
+            std::memcpy(&bits[i], &f, sizeof(float));
+        }
+        return HashKey((static_cast<uint64_t>(bits[0]) << 32) | bits[1]) ^ bits[2];
+    }
+
+    static uint64_t CellKey(int64_t x, int64_t y, int64_t z) {
+        const uint64_t mask = (1ULL << 21) - 1;
+        return ((static_cast<uint64_t>(x) & mask) << 42) |
+               ((static_cast<uint64_t>(y) & mask) << 21) | (static_cast<uint64_t>(z) & mask);
+    }
+
+    uint64_t Key(const glm::vec3& p) const {
+        if (mTolerance <= 0.f) {
+            return ExactKey(p);
+        }
+        const glm::vec3 q = glm::floor(p / (2.f * mTolerance));
+        return CellKey(static_cast<int64_t>(q[0]), static_cast<int64_t>(q[1]),
+                       static_cast<int64_t>(q[2]));
+    }
+
+    size_t findInCell(const glm::vec3& p, uint64_t key) const {
+        const size_t mask = mSlots.size() - 1;
+        const float tol2 = mTolerance * mTolerance;
+        for (size_t i = HashKey(key) & mask;; i = (i + 1) & mask) {
+            const Slot& slot = mSlots[i];
+            if (slot.index == NotFound) return NotFound;
+            if (slot.key != key) continue;
+            if (mTolerance <= 0.f ? slot.pos == p : glm::dot(slot.pos - p, slot.pos - p) <= tol2) {
+                return slot.index;
+            }
+        }
+    }
+
+    void store(const glm::vec3& p, uint64_t key, size_t index) {
+        const size_t mask = mSlots.size() - 1;
+        size_t i = HashKey(key) & mask;
+        while (mSlots[i].index != NotFound) {
+            i = (i + 1) & mask;
+        }
+        mSlots[i].pos = p;
+        mSlots[i].key = key;
+        mSlots[i].index = index;
+        mSize++;
+    }
+
+    void rehash(size_t capacity) {
+        std::vector<Slot> old(capacity);
+        old.swap(mSlots);
+        mSize = 0;
+        for (const Slot& slot : old) {
+            if (slot.index != NotFound) store(slot.pos, slot.key, slot.index);
+        }
+    }
+
+    float mTolerance;
+    std::vector<Slot> mSlots;
+    size_t mSize;
+};